@@ -0,0 +1,109 @@
+#include "boot.h"
+#include "diag/stats.h"
+#include "transports/transport_ble_midi.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(boot, LOG_LEVEL_INF);
+
+#define BOOT_WQ_STACK_SIZE 2048
+/* Below the pedal reader and transports: never delays a sample */
+#define BOOT_WQ_PRIORITY 8
+
+static K_THREAD_STACK_DEFINE(boot_wq_stack, BOOT_WQ_STACK_SIZE);
+static struct k_work_q boot_wq;
+
+/* Microseconds since boot at which each phase completed, 0 = not yet */
+static atomic_t phase_us[BOOT_PHASE_COUNT];
+
+static const char *const phase_names[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_USB] = "usb",
+    [BOOT_PHASE_USB_READY] = "usb-ready",
+    [BOOT_PHASE_BLE] = "ble",
+    [BOOT_PHASE_ADC_SETTLED] = "adc-settled",
+    [BOOT_PHASE_PEDALS] = "pedals",
+    [BOOT_PHASE_FIRST_EVENT] = "first-event",
+};
+
+static void boot_report_work(struct k_work *work) {
+  ARG_UNUSED(work);
+
+  for (size_t p = 0; p < BOOT_PHASE_COUNT; p++) {
+    uint32_t us = (uint32_t)atomic_get(&phase_us[p]);
+    if (us == 0U) {
+      LOG_INF("Boot %-11s: pending", phase_names[p]);
+    } else {
+      LOG_INF("Boot %-11s: %u.%03u ms", phase_names[p], us / 1000U,
+              us % 1000U);
+    }
+  }
+}
+
+static K_WORK_DEFINE(s_report_work, boot_report_work);
+
+#if IS_ENABLED(CONFIG_MIDAL_BLE_TRANSPORT)
+/* bt_enable() blocks for the controller bring-up */
+static void boot_ble_work(struct k_work *work) {
+  ARG_UNUSED(work);
+
+  int ret = transport_ble_midi_init();
+  if (ret != 0) {
+    LOG_WRN("BLE MIDI transport init failed: %d", ret);
+    return;
+  }
+  boot_mark(BOOT_PHASE_BLE);
+}
+
+static K_WORK_DEFINE(s_ble_work, boot_ble_work);
+#endif
+
+int boot_start_background(void) {
+  const struct k_work_queue_config cfg = {.name = "boot"};
+
+  k_work_queue_start(&boot_wq, boot_wq_stack,
+                     K_THREAD_STACK_SIZEOF(boot_wq_stack), BOOT_WQ_PRIORITY,
+                     &cfg);
+
+#if IS_ENABLED(CONFIG_MIDAL_BLE_TRANSPORT)
+  int ret = k_work_submit_to_queue(&boot_wq, &s_ble_work);
+  if (ret < 0) {
+    LOG_ERR("Failed to queue BLE bring-up: %d", ret);
+    return ret;
+  }
+#endif
+
+  return 0;
+}
+
+void boot_mark(boot_phase_t phase) {
+  if (phase >= BOOT_PHASE_COUNT) {
+    return;
+  }
+
+  /* 0 means unset, so a phase done at t=0 reads as 1 us */
+  uint32_t now = MAX(k_ticks_to_us_floor32(k_uptime_ticks()), 1U);
+  if (!atomic_cas(&phase_us[phase], 0, (atomic_val_t)now)) {
+    return;
+  }
+
+  if (phase == BOOT_PHASE_FIRST_EVENT) {
+    /* Log from the system work queue, not the publishing thread */
+    (void)k_work_submit(&s_report_work);
+  }
+}
+
+void boot_get_stats(struct boot_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  stats->usb_ready_us = (uint32_t)atomic_get(&phase_us[BOOT_PHASE_USB_READY]);
+  stats->ble_us = (uint32_t)atomic_get(&phase_us[BOOT_PHASE_BLE]);
+  stats->adc_settled_us =
+      (uint32_t)atomic_get(&phase_us[BOOT_PHASE_ADC_SETTLED]);
+  stats->first_event_us =
+      (uint32_t)atomic_get(&phase_us[BOOT_PHASE_FIRST_EVENT]);
+}
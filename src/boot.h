@@ -0,0 +1,41 @@
+#pragma once
+
+#include <zephyr/kernel.h>
+
+/**
+ * @file boot.h
+ * @brief Boot orchestration and boot phase timestamps
+ *
+ * Slow, independent bring-up steps (BLE controller enable) run on a
+ * dedicated work queue so they overlap USB enumeration and ADC settling in
+ * main(). Each phase records the time it completed; the report is logged
+ * once the first MIDI event has been published.
+ */
+
+struct boot_stats;
+
+typedef enum {
+  BOOT_PHASE_USB,         /* USB device stack enabled */
+  BOOT_PHASE_USB_READY,   /* Host configured the USB MIDI interface */
+  BOOT_PHASE_BLE,         /* BLE MIDI transport up and advertising */
+  BOOT_PHASE_ADC_SETTLED, /* Pedal readings stopped drifting */
+  BOOT_PHASE_PEDALS,      /* Pedal sampling started */
+  BOOT_PHASE_FIRST_EVENT, /* First MIDI event published */
+  BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/*
+ * Start the boot work queue and submit the background bring-up steps.
+ * Call once from main() after the stats system is up.
+ */
+int boot_start_background(void);
+
+/* Record that @p phase completed now. Only the first call counts. */
+void boot_mark(boot_phase_t phase);
+
+/**
+ * @brief Get boot phase timestamps
+ *
+ * @param stats Pointer to structure to fill with statistics
+ */
+void boot_get_stats(struct boot_stats *stats);
@@ -0,0 +1,165 @@
+#include "bus_bench.h"
+#include "midal_conf.h"
+#include "midi/midi_cc_stage.h"
+#include "midi/midi_types.h"
+#include "pedal/pedal_frame.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+LOG_MODULE_REGISTER(bus_bench, LOG_LEVEL_INF);
+
+#define BUS_BENCH_SCANS 1024U
+
+/*
+ * Same topology as the live channel: two transport message subscribers and
+ * the synchronous stats listener, once per message layout.
+ */
+static uint32_t s_listener_events;
+
+static void bench_event_listener_cb(const struct zbus_channel *chan) {
+  ARG_UNUSED(chan);
+  s_listener_events++;
+}
+
+static void bench_frame_listener_cb(const struct zbus_channel *chan) {
+  const pedal_frame_t *frame = zbus_chan_const_msg(chan);
+  s_listener_events += (uint32_t)__builtin_popcount(frame->changed);
+}
+
+ZBUS_MSG_SUBSCRIBER_DEFINE(bench_event_sub_usb);
+ZBUS_MSG_SUBSCRIBER_DEFINE(bench_event_sub_ble);
+ZBUS_LISTENER_DEFINE(bench_event_listener, bench_event_listener_cb);
+ZBUS_MSG_SUBSCRIBER_DEFINE(bench_frame_sub_usb);
+ZBUS_MSG_SUBSCRIBER_DEFINE(bench_frame_sub_ble);
+ZBUS_LISTENER_DEFINE(bench_frame_listener, bench_frame_listener_cb);
+
+ZBUS_CHAN_DEFINE(bench_event_chan, midi_event_t, NULL, NULL,
+                 ZBUS_OBSERVERS(bench_event_sub_usb, bench_event_sub_ble,
+                                bench_event_listener),
+                 ZBUS_MSG_INIT(0));
+ZBUS_CHAN_DEFINE(bench_frame_chan, pedal_frame_t, NULL, NULL,
+                 ZBUS_OBSERVERS(bench_frame_sub_usb, bench_frame_sub_ble,
+                                bench_frame_listener),
+                 ZBUS_MSG_INIT(0));
+
+typedef struct {
+  uint64_t pub_cycles;   /* Sampler side: publish incl. listener */
+  uint64_t drain_cycles; /* Transport side: receive and stage */
+  uint32_t publishes;
+  uint32_t messages; /* Subscriber deliveries */
+  uint32_t events;   /* Pedal updates seen by the stats listener */
+} bus_result_t;
+
+/* Scan idx with the pedals in mask moving */
+static void bench_frame(uint32_t idx, uint8_t mask, pedal_frame_t *frame) {
+  frame->timestamp_us = idx * 1000U;
+  frame->changed = mask;
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    frame->values[i] = (uint16_t)((idx * 16U + i) & 0x3FFFU);
+  }
+}
+
+static void drain_events(const struct zbus_observer *sub, midi_cc_stage_t *st,
+                         bus_result_t *res) {
+  const struct zbus_channel *chan;
+  midi_event_t ev;
+
+  while (zbus_sub_wait_msg(sub, &chan, &ev, K_NO_WAIT) == 0) {
+    midi_cc_stage_put(st, &ev);
+    res->messages++;
+  }
+}
+
+static void drain_frames(const struct zbus_observer *sub, midi_cc_stage_t *st,
+                         bus_result_t *res) {
+  const struct zbus_channel *chan;
+  pedal_frame_t frame;
+
+  while (zbus_sub_wait_msg(sub, &chan, &frame, K_NO_WAIT) == 0) {
+    midi_cc_stage_put_frame(st, &frame);
+    res->messages++;
+  }
+}
+
+static void bench_pass(bool per_frame, uint8_t mask, bus_result_t *res) {
+  midi_cc_stage_t stage[2];
+
+  *res = (bus_result_t){0};
+  s_listener_events = 0U;
+  midi_cc_stage_init(&stage[0], 0U);
+  midi_cc_stage_init(&stage[1], 0U);
+
+  for (uint32_t idx = 0; idx < BUS_BENCH_SCANS; idx++) {
+    pedal_frame_t frame;
+    bench_frame(idx, mask, &frame);
+
+    uint32_t t0 = k_cycle_get_32();
+    if (per_frame) {
+      (void)zbus_chan_pub(&bench_frame_chan, &frame, K_NO_WAIT);
+      res->publishes++;
+    } else {
+      for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+        if ((frame.changed & BIT(i)) != 0U) {
+          midi_event_t ev;
+          pedal_frame_event(&frame, i, &ev);
+          (void)zbus_chan_pub(&bench_event_chan, &ev, K_NO_WAIT);
+          res->publishes++;
+        }
+      }
+    }
+    uint32_t t1 = k_cycle_get_32();
+
+    if (per_frame) {
+      drain_frames(&bench_frame_sub_usb, &stage[0], res);
+      drain_frames(&bench_frame_sub_ble, &stage[1], res);
+    } else {
+      drain_events(&bench_event_sub_usb, &stage[0], res);
+      drain_events(&bench_event_sub_ble, &stage[1], res);
+    }
+    uint32_t t2 = k_cycle_get_32();
+
+    res->pub_cycles += t1 - t0;
+    res->drain_cycles += t2 - t1;
+
+    /* The transports would have sent by the next scan */
+    while (midi_cc_stage_next(&stage[0], 0U) != NULL) {
+      midi_cc_stage_sent(&stage[0]);
+    }
+    while (midi_cc_stage_next(&stage[1], 0U) != NULL) {
+      midi_cc_stage_sent(&stage[1]);
+    }
+  }
+
+  res->events = s_listener_events;
+}
+
+static void bench_log(const char *name, uint8_t mask, const bus_result_t *r) {
+  const uint32_t pub = (uint32_t)(r->pub_cycles / BUS_BENCH_SCANS);
+  const uint32_t drain = (uint32_t)(r->drain_cycles / BUS_BENCH_SCANS);
+
+  LOG_INF("[bus %s, %d changed] pub %u cyc (%u ns), drain %u cyc (%u ns) "
+          "per scan; %u pub, %u msg, %u events",
+          name, __builtin_popcount(mask), pub,
+          (uint32_t)k_cyc_to_ns_floor64(pub), drain,
+          (uint32_t)k_cyc_to_ns_floor64(drain), r->publishes, r->messages,
+          r->events);
+}
+
+void bus_bench_run(void) {
+  const uint8_t masks[] = {BIT(0), BIT_MASK(MIDAL_NUM_PEDALS)};
+
+  LOG_INF("=== Bus bench start (%u scans) ===", BUS_BENCH_SCANS);
+  for (size_t m = 0; m < ARRAY_SIZE(masks); m++) {
+    bus_result_t ev_res;
+    bus_result_t frame_res;
+
+    bench_pass(false, masks[m], &ev_res);
+    bench_pass(true, masks[m], &frame_res);
+    bench_log("event", masks[m], &ev_res);
+    bench_log("frame", masks[m], &frame_res);
+  }
+  LOG_INF("=== Bus bench done ===");
+}
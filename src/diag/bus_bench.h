@@ -0,0 +1,9 @@
+#pragma once
+
+/*
+ * Publish the same synthetic pedal scans once per changed pedal (the old
+ * midi_event_t path) and once per scan (pedal_frame_t) through private
+ * channels wired like pedal_frame_chan, and log the bus cost of each.
+ * Runs before the pedal pipeline is started.
+ */
+void bus_bench_run(void);
@@ -0,0 +1,144 @@
+#include "codec_bench.h"
+#include "midal_conf.h"
+#include "midi/midi_codec.h"
+#include "midi/midi_types.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(codec_bench, LOG_LEVEL_INF);
+
+#define CODEC_BENCH_EVENTS 1024U
+
+static const uint8_t bench_ccs[] = {64U, 66U, 67U, 1U, 11U};
+
+static midi_event_t s_events[CODEC_BENCH_EVENTS];
+
+/* Pedal-like events: round-robin controllers, 14-bit sweep, 1 ms apart */
+static void bench_events(void) {
+  for (uint32_t i = 0; i < CODEC_BENCH_EVENTS; i++) {
+    midi_event_t *ev = &s_events[i];
+
+    ev->type = MIDI_EV_CC;
+    ev->cc.ch = 0U;
+    ev->cc.cc = bench_ccs[i % ARRAY_SIZE(bench_ccs)];
+    ev->cc.value = (uint16_t)((i * 97U) & 0x3FFFU);
+    ev->timestamp_us = i * 1000U;
+  }
+}
+
+/* The encodings the transports ask for */
+typedef enum {
+  BENCH_FMT_MIDI1, /* DIN: running status across messages */
+  BENCH_FMT_BLE,   /* BLE: whole messages for the module to frame */
+  BENCH_FMT_UMP1,
+  BENCH_FMT_UMP2,
+  BENCH_FMT_COUNT,
+} bench_fmt_t;
+
+static const char *const fmt_names[BENCH_FMT_COUNT] = {
+    "midi1",
+    "ble",
+    "ump1",
+    "ump2",
+};
+
+typedef struct {
+  uint64_t cycles;
+  uint32_t units; /* Bytes or words written */
+} fmt_result_t;
+
+/* Encode the events through fmt one at a time, as the transports do */
+static void bench_fmt(midi_codec_t *c, bench_fmt_t fmt, fmt_result_t *res) {
+  uint8_t bytes[MIDI_CODEC_MIDI1_MAX];
+  uint32_t words[MIDI_CODEC_UMP_MAX];
+
+  *res = (fmt_result_t){0};
+  midi_codec_reset_status(c);
+
+  for (uint32_t i = 0; i < CODEC_BENCH_EVENTS; i++) {
+    const midi_event_t *ev = &s_events[i];
+    size_t len = 0U;
+
+    uint32_t t0 = k_cycle_get_32();
+    switch (fmt) {
+    case BENCH_FMT_MIDI1:
+    case BENCH_FMT_BLE:
+      len = midi_codec_midi1(c, ev, bytes, sizeof(bytes));
+      break;
+    case BENCH_FMT_UMP1:
+      len = midi_codec_ump_midi1(c, ev, 0U, words, ARRAY_SIZE(words));
+      break;
+    case BENCH_FMT_UMP2:
+      len = midi_codec_ump_midi2(c, ev, 0U, words, ARRAY_SIZE(words));
+      break;
+    default:
+      break;
+    }
+    uint32_t t1 = k_cycle_get_32();
+
+    res->cycles += t1 - t0;
+    res->units += len;
+  }
+}
+
+/* Every MSB/LSB pair must rebuild the 14-bit value exactly */
+static uint32_t bench_check_pairs(void) {
+  midi_codec_t c;
+  uint32_t errors = 0U;
+
+  midi_codec_init(&c, MIDI_CODEC_14BIT | MIDI_CODEC_LSB);
+  for (uint32_t v = 0; v <= 16383U; v++) {
+    const midi_event_t ev = {
+        .type = MIDI_EV_CC,
+        .cc = {.ch = 0U, .cc = 1U, .value = (uint16_t)v},
+    };
+    uint8_t out[MIDI_CODEC_MIDI1_MAX];
+
+    if (midi_codec_midi1(&c, &ev, out, sizeof(out)) != 6U ||
+        (((uint32_t)out[2] << 7) | out[5]) != v) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+void codec_bench_run(void) {
+  /* The pedal values are 14-bit here whatever the build uses */
+  const uint8_t modes[] = {MIDI_CODEC_14BIT,
+                           MIDI_CODEC_14BIT | MIDI_CODEC_LSB};
+
+  LOG_INF("=== Codec bench start (%u events) ===", CODEC_BENCH_EVENTS);
+  bench_events();
+
+  for (size_t m = 0; m < ARRAY_SIZE(modes); m++) {
+    for (size_t f = 0; f < BENCH_FMT_COUNT; f++) {
+      midi_codec_t c;
+      fmt_result_t r;
+
+      /* Running status applies to the DIN byte stream only */
+      midi_codec_init(&c, (f == BENCH_FMT_MIDI1)
+                              ? (modes[m] | MIDI_CODEC_RUNNING_STATUS)
+                              : modes[m]);
+      bench_fmt(&c, (bench_fmt_t)f, &r);
+
+      const bool lsb = (modes[m] & MIDI_CODEC_LSB) != 0U;
+      uint32_t cyc = (uint32_t)(r.cycles / CODEC_BENCH_EVENTS);
+      uint32_t per_x100 = (r.units * 100U) / CODEC_BENCH_EVENTS;
+      LOG_INF("[codec %s%s] %u cyc (%u ns), %u.%02u %s per event",
+              fmt_names[f], lsb ? "+lsb" : "", cyc,
+              (uint32_t)k_cyc_to_ns_floor64(cyc), per_x100 / 100U,
+              per_x100 % 100U, (f >= BENCH_FMT_UMP1) ? "words" : "bytes");
+    }
+  }
+
+  uint32_t errors = bench_check_pairs();
+  if (errors != 0U) {
+    LOG_WRN("[codec] %u of 16384 MSB/LSB pairs do not rebuild the value",
+            errors);
+  } else {
+    LOG_INF("[codec] MSB/LSB pairs rebuild all 16384 values");
+  }
+  LOG_INF("=== Codec bench done ===");
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+/*
+ * Encode the same synthetic CC events into every output format of the MIDI
+ * codec, one at a time as the transports do, and log the cost per event and
+ * the bytes per event. Also checks that 14-bit MSB/LSB pairs rebuild the value.
+ * Runs before the pedal pipeline is started.
+ */
+void codec_bench_run(void);
@@ -0,0 +1,620 @@
+#include "filter_bench.h"
+#include "midal_conf.h"
+#include "pedal/pedal_decim.h"
+#include "pedal/pedal_filter.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(filter_bench, LOG_LEVEL_INF);
+
+/*
+ * Trace: pedal at rest with SAADC noise (mean ~3263, 4..7 LSB p2p as in
+ * resistance-diag.txt), then a step to the fully pressed level.
+ */
+#define TRACE_REST_LEVEL 3263
+#define TRACE_PRESSED_LEVEL 1200
+#define TRACE_REST_SCANS 4096U
+#define TRACE_STEP_SCANS 1024U
+
+#define BENCH_LIVE_KERNEL                                                      \
+  (IS_ENABLED(CONFIG_MIDAL_FILTER_FIXED) ? PEDAL_FILTER_KERNEL_FIXED           \
+                                         : PEDAL_FILTER_KERNEL_FLOAT)
+/* The bench pairs the predictor with the EMA only */
+#define BENCH_LIVE_MODE                                                        \
+  (IS_ENABLED(CONFIG_MIDAL_FILTER_MODE_ONE_EURO)                                \
+       ? PEDAL_FILTER_MODE_ONE_EURO                                            \
+   : IS_ENABLED(CONFIG_MIDAL_PREDICT) ? PEDAL_FILTER_MODE_EMA_PREDICT          \
+                                      : PEDAL_FILTER_MODE_EMA)
+#define BENCH_LIVE_HYST                                                        \
+  (IS_ENABLED(CONFIG_MIDAL_FILTER_HYST_AUTO) ? PEDAL_FILTER_HYST_ADAPTIVE      \
+                                             : PEDAL_FILTER_HYST_STATIC)
+
+#ifndef CONFIG_MIDAL_PREDICT_LEAD_US
+#define CONFIG_MIDAL_PREDICT_LEAD_US 2000
+#endif
+
+static const char *const mode_names[PEDAL_FILTER_MODE_COUNT] = {
+    "ema",
+    "1euro",
+    "ema+pred",
+};
+
+static const char *const hyst_names[PEDAL_FILTER_HYST_COUNT] = {
+    "off",
+    "static",
+    "adaptive",
+};
+
+static uint32_t s_rng;
+
+static int32_t trace_noise(void) {
+  /* Sum of three LCG draws in [-1, 1] → bell-ish noise, p2p up to 6 LSB */
+  int32_t n = 0;
+  for (int k = 0; k < 3; k++) {
+    s_rng = s_rng * 1664525U + 1013904223U;
+    n += (int32_t)((s_rng >> 24) % 3U) - 1;
+  }
+  return n;
+}
+
+static uint16_t trace_scan(uint32_t idx) {
+  int32_t level =
+      (idx < TRACE_REST_SCANS) ? TRACE_REST_LEVEL : TRACE_PRESSED_LEVEL;
+  return (uint16_t)CLAMP(level + trace_noise(), 0, 4095);
+}
+
+typedef struct {
+  int64_t sum;
+  int64_t sum_sq;
+  int32_t min;
+  int32_t max;
+  uint32_t n;
+} bench_stats_t;
+
+static void stats_reset(bench_stats_t *st) {
+  *st = (bench_stats_t){.min = INT32_MAX, .max = INT32_MIN};
+}
+
+static void stats_add(bench_stats_t *st, int32_t v) {
+  st->sum += v;
+  st->sum_sq += (int64_t)v * v;
+  st->min = MIN(st->min, v);
+  st->max = MAX(st->max, v);
+  st->n++;
+}
+
+/* Standard deviation in hundredths of the given unit */
+static uint32_t stats_sigma_x100(const bench_stats_t *st, uint32_t unit) {
+  if (st->n < 2U) {
+    return 0U;
+  }
+  double mean = (double)st->sum / st->n;
+  double var = ((double)st->sum_sq / st->n) - (mean * mean);
+  return (uint32_t)(sqrt(MAX(var, 0.0)) * 100.0 / unit + 0.5);
+}
+
+static void bench_decimator(void) {
+  const uint32_t scan_us =
+      1000000U / (CONFIG_MIDAL_POLL_HZ * PEDAL_DECIM_RATIO);
+  const uint32_t unit = BIT(PEDAL_RAW_FRAC_BITS);
+  const int32_t mid = ((TRACE_REST_LEVEL + TRACE_PRESSED_LEVEL) / 2) * unit;
+
+  bench_stats_t in_st;
+  bench_stats_t out_st;
+  stats_reset(&in_st);
+  stats_reset(&out_st);
+
+  s_rng = 1U;
+  pedal_decim_reset();
+
+  uint32_t cross_scan = 0U;
+  for (uint32_t idx = 0; idx < TRACE_REST_SCANS + TRACE_STEP_SCANS; idx++) {
+    uint16_t in[MIDAL_NUM_PEDALS];
+    uint16_t out[MIDAL_NUM_PEDALS];
+
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      in[i] = trace_scan(idx);
+    }
+    if (idx < TRACE_REST_SCANS) {
+      stats_add(&in_st, in[0]);
+    }
+
+    if (!pedal_decim_push(in, out)) {
+      continue;
+    }
+
+    /* Skip the first rest outputs so the warm-up does not count as noise */
+    if (idx >= TRACE_REST_SCANS / 4U && idx < TRACE_REST_SCANS) {
+      stats_add(&out_st, out[0]);
+    } else if (idx >= TRACE_REST_SCANS && cross_scan == 0U &&
+               (int32_t)out[0] <= mid) {
+      cross_scan = idx;
+    }
+  }
+
+  LOG_INF("[decim R=%d K=%d] input: sigma=%u.%02u p2p=%d LSB",
+          PEDAL_DECIM_RATIO, PEDAL_DECIM_ORDER,
+          stats_sigma_x100(&in_st, 1U) / 100U,
+          stats_sigma_x100(&in_st, 1U) % 100U, in_st.max - in_st.min);
+  LOG_INF("[decim R=%d K=%d] output: sigma=%u.%02u LSB p2p=%d (1/%u LSB)",
+          PEDAL_DECIM_RATIO, PEDAL_DECIM_ORDER,
+          stats_sigma_x100(&out_st, unit) / 100U,
+          stats_sigma_x100(&out_st, unit) % 100U, out_st.max - out_st.min,
+          unit);
+  LOG_INF("[decim R=%d K=%d] step 50%% delay: %u us (nominal %u us)",
+          PEDAL_DECIM_RATIO, PEDAL_DECIM_ORDER,
+          (cross_scan - TRACE_REST_SCANS) * scan_us,
+          pedal_decim_group_delay_us());
+
+  pedal_decim_reset();
+}
+
+/* Triangle sweep between the pressed and rest levels, period in scans */
+static uint16_t trace_sweep(uint32_t idx, uint32_t period) {
+  const int32_t span = TRACE_REST_LEVEL - TRACE_PRESSED_LEVEL;
+  int32_t ph = (int32_t)(idx % period);
+  int32_t half = (int32_t)period / 2;
+  int32_t pos = (ph < half) ? ph : ((int32_t)period - ph);
+  int32_t level = TRACE_PRESSED_LEVEL + (span * pos) / half;
+  return (uint16_t)CLAMP(level + trace_noise(), 0, 4095);
+}
+
+typedef struct {
+  uint64_t cycles[PEDAL_FILTER_KERNEL_COUNT];
+  uint32_t max_diff;
+  uint32_t mismatches;
+} kernel_pass_t;
+
+/* Run both kernels side by side over the same trace and compare outputs */
+static void bench_kernel_pass(pedal_filter_mode_t mode,
+                              pedal_filter_hyst_t hyst, kernel_pass_t *res) {
+  const uint32_t scans = TRACE_REST_SCANS + TRACE_STEP_SCANS;
+
+  *res = (kernel_pass_t){0};
+  s_rng = 7U;
+
+  for (uint32_t idx = 0; idx < scans; idx++) {
+    uint16_t raw[MIDAL_NUM_PEDALS];
+    uint16_t out_f[MIDAL_NUM_PEDALS];
+    uint16_t out_q[MIDAL_NUM_PEDALS];
+
+    /* Rest/step, slow and fast sweeps, with random fractional bits */
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      uint16_t v = (i == 0U)   ? trace_scan(idx)
+                   : (i == 1U) ? trace_sweep(idx, 2048U)
+                               : trace_sweep(idx, 300U);
+      s_rng = s_rng * 1664525U + 1013904223U;
+      raw[i] = (uint16_t)((v << PEDAL_RAW_FRAC_BITS) |
+                          ((s_rng >> 16) & BIT_MASK(PEDAL_RAW_FRAC_BITS)));
+    }
+
+    res->cycles[PEDAL_FILTER_KERNEL_FLOAT] += pedal_filter_bench_kernel(
+        PEDAL_FILTER_KERNEL_FLOAT, mode, idx == 0U, hyst, raw, out_f);
+    res->cycles[PEDAL_FILTER_KERNEL_FIXED] += pedal_filter_bench_kernel(
+        PEDAL_FILTER_KERNEL_FIXED, mode, idx == 0U, hyst, raw, out_q);
+
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      uint32_t d = (uint32_t)abs((int32_t)out_f[i] - (int32_t)out_q[i]);
+      res->max_diff = MAX(res->max_diff, d);
+      res->mismatches += (d != 0U) ? 1U : 0U;
+    }
+  }
+
+  for (size_t k = 0; k < PEDAL_FILTER_KERNEL_COUNT; k++) {
+    res->cycles[k] /= scans;
+  }
+}
+
+static void bench_kernels(void) {
+  const uint32_t outputs =
+      (TRACE_REST_SCANS + TRACE_STEP_SCANS) * MIDAL_NUM_PEDALS;
+  const pedal_filter_mode_t smooth =
+      IS_ENABLED(CONFIG_MIDAL_FILTER_MODE_ONE_EURO) ? PEDAL_FILTER_MODE_ONE_EURO
+                                                    : PEDAL_FILTER_MODE_EMA;
+  kernel_pass_t raw_pass;
+  kernel_pass_t hyst_pass;
+  kernel_pass_t pred_pass;
+
+  /* Kernel equivalence is judged ahead of the dead band: a 1 LSB difference
+   * at its edge makes one path hold where the other moves */
+  bench_kernel_pass(smooth, PEDAL_FILTER_HYST_OFF, &raw_pass);
+  bench_kernel_pass(BENCH_LIVE_MODE, BENCH_LIVE_HYST, &hyst_pass);
+
+  LOG_INF("[filter] float: %u cyc/scan, fixed: %u cyc/scan (%d pedals)",
+          (uint32_t)hyst_pass.cycles[PEDAL_FILTER_KERNEL_FLOAT],
+          (uint32_t)hyst_pass.cycles[PEDAL_FILTER_KERNEL_FIXED],
+          MIDAL_NUM_PEDALS);
+  LOG_INF("[filter] fixed vs float: max |diff| %u LSB, %u/%u outputs differ",
+          raw_pass.max_diff, raw_pass.mismatches, outputs);
+  LOG_INF("[filter] with hysteresis: %u/%u outputs differ (dead band edge)",
+          hyst_pass.mismatches, outputs);
+  if (raw_pass.max_diff > 1U) {
+    LOG_WRN("[filter] fixed-point kernel exceeds 1 LSB from reference");
+  }
+
+  /* Same effect at the predictor's speed gate and deceleration test */
+  bench_kernel_pass(PEDAL_FILTER_MODE_EMA_PREDICT, PEDAL_FILTER_HYST_OFF,
+                    &pred_pass);
+  LOG_INF("[filter] predictor: max |diff| %u LSB, %u/%u outputs differ",
+          pred_pass.max_diff, pred_pass.mismatches, outputs);
+}
+
+/*
+ * Mode comparison trace, at the output sample rate: calibrate on a full
+ * press, then press and release steps, a noisy half-pedal hold and rest.
+ */
+typedef struct {
+  uint32_t scans;
+  int32_t level; /* SAADC LSB */
+} trace_seg_t;
+
+static const trace_seg_t mode_trace[] = {
+    {500U, TRACE_REST_LEVEL},
+    {500U, TRACE_PRESSED_LEVEL},
+    {1000U, TRACE_REST_LEVEL},
+    {1000U, TRACE_PRESSED_LEVEL}, /* press step */
+    {1000U, TRACE_REST_LEVEL},    /* release step */
+    {3000U, (TRACE_REST_LEVEL + TRACE_PRESSED_LEVEL) / 2}, /* half pedal */
+    {2000U, TRACE_REST_LEVEL},                             /* rest */
+};
+#define SEG_PRESS 3
+#define SEG_RELEASE 4
+#define SEG_HALF 5
+#define SEG_REST 6
+
+typedef struct {
+  uint16_t seg_start[ARRAY_SIZE(mode_trace)]; /* Output before the segment */
+  uint16_t seg_end[ARRAY_SIZE(mode_trace)];   /* Output at its last scan */
+  uint32_t t90[ARRAY_SIZE(mode_trace)];       /* Scans to 90% of the move */
+  uint32_t events[ARRAY_SIZE(mode_trace)];    /* Changes, second half only */
+} mode_result_t;
+
+/* One output-rate sample at level, through the decimator when enabled */
+static bool mode_trace_raw(int32_t level, uint16_t raw[MIDAL_NUM_PEDALS]) {
+  bool ready = false;
+
+  for (int k = 0; k < PEDAL_DECIM_RATIO; k++) {
+    uint16_t in[MIDAL_NUM_PEDALS];
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      in[i] = (uint16_t)CLAMP(level + trace_noise(), 0, 4095);
+    }
+    ready = pedal_decim_push(in, raw);
+  }
+  return ready;
+}
+
+/*
+ * First pass (measure=false) records where each segment settles, second pass
+ * finds the 90% crossing and counts output changes against it.
+ */
+static void bench_mode_pass(mode_result_t res[PEDAL_FILTER_MODE_COUNT],
+                            pedal_filter_hyst_t hyst, bool measure) {
+  uint16_t prev[PEDAL_FILTER_MODE_COUNT] = {0};
+  bool reset = true;
+
+  s_rng = 11U;
+  pedal_decim_reset();
+
+  for (size_t s = 0; s < ARRAY_SIZE(mode_trace); s++) {
+    const uint32_t scans = mode_trace[s].scans;
+
+    for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+      res[m].seg_start[s] = prev[m];
+    }
+
+    for (uint32_t n = 0; n < scans; n++) {
+      uint16_t raw[MIDAL_NUM_PEDALS];
+      if (!mode_trace_raw(mode_trace[s].level, raw)) {
+        continue;
+      }
+
+      for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+        uint16_t out[MIDAL_NUM_PEDALS];
+        mode_result_t *r = &res[m];
+
+        (void)pedal_filter_bench_kernel(BENCH_LIVE_KERNEL,
+                                        (pedal_filter_mode_t)m, reset, hyst,
+                                        raw, out);
+        if (measure) {
+          int64_t move = (int64_t)r->seg_end[s] - r->seg_start[s];
+          int64_t done = (int64_t)out[0] - r->seg_start[s];
+          if (r->t90[s] == 0U && move != 0 &&
+              done * move * 10 >= move * move * 9) {
+            r->t90[s] = n + 1U;
+          }
+          if (n >= scans / 2U && out[0] != prev[m]) {
+            r->events[s]++;
+          }
+        }
+        prev[m] = out[0];
+      }
+      reset = false;
+    }
+
+    if (!measure) {
+      for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+        res[m].seg_end[s] = prev[m];
+      }
+    }
+  }
+}
+
+/* Output changes per second, in hundredths, over the counted half segment */
+static uint32_t mode_events_x100(const mode_result_t *r, size_t seg) {
+  return r->events[seg] * 100U * CONFIG_MIDAL_POLL_HZ /
+         (mode_trace[seg].scans / 2U);
+}
+
+static void bench_modes(void) {
+  const uint32_t scan_us = 1000000U / CONFIG_MIDAL_POLL_HZ;
+  mode_result_t res[PEDAL_FILTER_MODE_COUNT] = {0};
+  mode_result_t raw_res[PEDAL_FILTER_MODE_COUNT] = {0};
+
+  /* With the configured dead band, and without it to see the filter alone */
+  bench_mode_pass(res, BENCH_LIVE_HYST, false);
+  bench_mode_pass(res, BENCH_LIVE_HYST, true);
+  bench_mode_pass(raw_res, PEDAL_FILTER_HYST_OFF, false);
+  bench_mode_pass(raw_res, PEDAL_FILTER_HYST_OFF, true);
+
+  for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+    const char *live = (m == BENCH_LIVE_MODE) ? "*" : "";
+    uint32_t rest = mode_events_x100(&res[m], SEG_REST);
+    uint32_t half = mode_events_x100(&res[m], SEG_HALF);
+    uint32_t rest_raw = mode_events_x100(&raw_res[m], SEG_REST);
+    uint32_t half_raw = mode_events_x100(&raw_res[m], SEG_HALF);
+
+    LOG_INF("[mode %s%s] t90: press %u us, release %u us", mode_names[m], live,
+            res[m].t90[SEG_PRESS] * scan_us,
+            res[m].t90[SEG_RELEASE] * scan_us);
+    LOG_INF("[mode %s%s] noise events/s: rest %u.%02u, half pedal %u.%02u",
+            mode_names[m], live, rest / 100U, rest % 100U, half / 100U,
+            half % 100U);
+    LOG_INF("[mode %s%s] without dead band: rest %u.%02u, half pedal %u.%02u",
+            mode_names[m], live, rest_raw / 100U, rest_raw % 100U,
+            half_raw / 100U, half_raw % 100U);
+  }
+}
+
+/*
+ * Fast stroke trace for the predictor: each segment moves from the previous
+ * level to its own with a raised-cosine ramp (a quick foot stroke), then
+ * holds. Includes stops at both endpoints and in mid travel.
+ */
+typedef struct {
+  uint16_t ramp; /* scans */
+  uint16_t hold; /* scans */
+  int32_t level; /* SAADC LSB */
+} stroke_seg_t;
+
+#define STROKE_HALF_LEVEL ((TRACE_REST_LEVEL + TRACE_PRESSED_LEVEL) / 2)
+
+static const stroke_seg_t stroke_trace[] = {
+    {0U, 500U, TRACE_REST_LEVEL}, /* calibration */
+    {0U, 500U, TRACE_PRESSED_LEVEL},
+    {0U, 500U, TRACE_REST_LEVEL},
+    {30U, 300U, TRACE_PRESSED_LEVEL}, /* full strokes */
+    {30U, 300U, TRACE_REST_LEVEL},
+    {15U, 300U, TRACE_PRESSED_LEVEL},
+    {15U, 300U, TRACE_REST_LEVEL},
+    {20U, 300U, STROKE_HALF_LEVEL}, /* stops in mid travel */
+    {20U, 300U, TRACE_PRESSED_LEVEL},
+    {20U, 300U, STROKE_HALF_LEVEL},
+    {20U, 300U, TRACE_REST_LEVEL},
+};
+#define STROKE_FIRST 3U
+
+typedef struct {
+  uint16_t settled[ARRAY_SIZE(stroke_trace)]; /* Output at the end */
+  int64_t lag_sum_x10; /* 50% crossing after the input's, 1/10 scan */
+  uint32_t lag_n;
+  uint32_t overshoot; /* Worst excursion past the settled level, LSB */
+} stroke_result_t;
+
+static int32_t stroke_level(const stroke_seg_t *seg, int32_t from,
+                            uint32_t n) {
+  if (n >= seg->ramp) {
+    return seg->level;
+  }
+  float ph = (float)n / (float)seg->ramp;
+  float w = 0.5F - (0.5F * cosf(3.14159265F * ph));
+  return from + (int32_t)((float)(seg->level - from) * w);
+}
+
+/*
+ * First pass (measure=false) records where each segment settles; the
+ * second one times the 50% crossing of every ramp against the input's
+ * (the middle of the ramp) and tracks the excursion past the settled level.
+ */
+static void bench_stroke_pass(stroke_result_t res[PEDAL_FILTER_MODE_COUNT],
+                              bool measure) {
+  uint16_t prev[PEDAL_FILTER_MODE_COUNT] = {0};
+  bool crossed[PEDAL_FILTER_MODE_COUNT];
+  int32_t from = stroke_trace[0].level;
+  bool reset = true;
+
+  s_rng = 23U;
+  pedal_decim_reset();
+
+  for (size_t s = 0; s < ARRAY_SIZE(stroke_trace); s++) {
+    const stroke_seg_t *seg = &stroke_trace[s];
+    const bool timed = measure && s >= STROKE_FIRST;
+
+    for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+      crossed[m] = false;
+    }
+
+    for (uint32_t n = 0; n < (uint32_t)seg->ramp + seg->hold; n++) {
+      uint16_t raw[MIDAL_NUM_PEDALS];
+      if (!mode_trace_raw(stroke_level(seg, from, n), raw)) {
+        continue;
+      }
+
+      for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+        uint16_t out[MIDAL_NUM_PEDALS];
+        stroke_result_t *r = &res[m];
+
+        (void)pedal_filter_bench_kernel(BENCH_LIVE_KERNEL,
+                                        (pedal_filter_mode_t)m, reset,
+                                        PEDAL_FILTER_HYST_OFF, raw, out);
+        if (timed) {
+          int32_t a = (s > 0U) ? r->settled[s - 1U] : 0;
+          int32_t b = r->settled[s];
+          int32_t dir = (b > a) ? 1 : -1;
+          int32_t mid2 = a + b; /* twice the 50% level */
+          int32_t over = (out[0] - b) * dir;
+
+          if (!crossed[m] && ((2 * out[0]) - mid2) * dir >= 0) {
+            /* Interpolate between the two outputs around the crossing */
+            int32_t d = ((int32_t)out[0] - prev[m]) * 2;
+            int32_t frac_x10 =
+                (d != 0) ? (((mid2 - (2 * prev[m])) * 10) / d) : 10;
+            int32_t t_x10 = (((int32_t)n - 1) * 10) + frac_x10;
+            r->lag_sum_x10 += t_x10 - (int32_t)(seg->ramp * 5U);
+            r->lag_n++;
+            crossed[m] = true;
+          }
+          if (over > (int32_t)r->overshoot) {
+            r->overshoot = (uint32_t)over;
+          }
+        }
+        prev[m] = out[0];
+      }
+      reset = false;
+    }
+
+    if (!measure) {
+      for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+        res[m].settled[s] = prev[m];
+      }
+    }
+    from = seg->level;
+  }
+}
+
+static void bench_predict(void) {
+  const int32_t scan_us = 1000000 / CONFIG_MIDAL_POLL_HZ;
+  const uint32_t out_max = IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? 16383U
+                                                                 : 127U;
+  stroke_result_t res[PEDAL_FILTER_MODE_COUNT] = {0};
+
+  bench_stroke_pass(res, false);
+  bench_stroke_pass(res, true);
+
+  for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+    if (m == PEDAL_FILTER_MODE_ONE_EURO) {
+      continue; /* The predictor comparison is against the plain EMA */
+    }
+
+    const stroke_result_t *r = &res[m];
+    int32_t lag_us = (r->lag_n > 0U)
+                         ? (int32_t)((r->lag_sum_x10 * scan_us) /
+                                     (10 * (int64_t)r->lag_n))
+                         : 0;
+    uint32_t over_x100 = (r->overshoot * 10000U) / out_max;
+
+    LOG_INF("[stroke %s%s] lag %d us, end-to-end %d us (+%d us transport), "
+            "overshoot %u LSB (%u.%02u%%)",
+            mode_names[m], (m == BENCH_LIVE_MODE) ? "*" : "", lag_us,
+            lag_us + CONFIG_MIDAL_PREDICT_LEAD_US,
+            CONFIG_MIDAL_PREDICT_LEAD_US, r->overshoot, over_x100 / 100U,
+            over_x100 % 100U);
+  }
+}
+
+/*
+ * Dead band comparison on the live kernel and mode: after calibration the
+ * pedal rests, then presses slowly across the whole travel. Rest events are
+ * counted over the second half of the rest, resolution during the sweep is
+ * full scale over the mean output step.
+ */
+#define HYST_CAL_SCANS 500U
+#define HYST_REST_SCANS 4000U
+#define HYST_SWEEP_SCANS 2000U
+
+typedef struct {
+  uint32_t rest_events;
+  uint32_t sweep_events;
+  uint32_t sweep_steps;
+} hyst_result_t;
+
+static void bench_hyst_pass(pedal_filter_hyst_t hyst, hyst_result_t *res) {
+  const uint32_t scans = (3U * HYST_CAL_SCANS) + HYST_REST_SCANS +
+                         HYST_SWEEP_SCANS;
+  const uint32_t rest_from = (3U * HYST_CAL_SCANS) + (HYST_REST_SCANS / 2U);
+  const uint32_t sweep_from = (3U * HYST_CAL_SCANS) + HYST_REST_SCANS;
+  uint16_t prev = 0U;
+  bool reset = true;
+
+  *res = (hyst_result_t){0};
+  s_rng = 31U;
+  pedal_decim_reset();
+
+  for (uint32_t idx = 0; idx < scans; idx++) {
+    int32_t level = TRACE_REST_LEVEL;
+    if (idx >= HYST_CAL_SCANS && idx < 2U * HYST_CAL_SCANS) {
+      level = TRACE_PRESSED_LEVEL;
+    } else if (idx >= sweep_from) {
+      level = TRACE_REST_LEVEL -
+              (int32_t)(((TRACE_REST_LEVEL - TRACE_PRESSED_LEVEL) *
+                         (idx - sweep_from)) /
+                        HYST_SWEEP_SCANS);
+    }
+
+    uint16_t raw[MIDAL_NUM_PEDALS];
+    uint16_t out[MIDAL_NUM_PEDALS];
+    if (!mode_trace_raw(level, raw)) {
+      continue;
+    }
+    (void)pedal_filter_bench_kernel(BENCH_LIVE_KERNEL, BENCH_LIVE_MODE, reset,
+                                    hyst, raw, out);
+
+    if (!reset && out[0] != prev) {
+      if (idx >= sweep_from) {
+        res->sweep_events++;
+        res->sweep_steps += (uint32_t)abs((int32_t)out[0] - (int32_t)prev);
+      } else if (idx >= rest_from) {
+        res->rest_events++;
+      }
+    }
+    prev = out[0];
+    reset = false;
+  }
+}
+
+static void bench_hyst(void) {
+  const uint32_t out_max = IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? 16383U
+                                                                 : 127U;
+  const pedal_filter_hyst_t kinds[] = {PEDAL_FILTER_HYST_STATIC,
+                                       PEDAL_FILTER_HYST_ADAPTIVE};
+
+  for (size_t k = 0; k < ARRAY_SIZE(kinds); k++) {
+    hyst_result_t r;
+
+    bench_hyst_pass(kinds[k], &r);
+
+    uint32_t rest_x100 = (r.rest_events * 100U * CONFIG_MIDAL_POLL_HZ) /
+                         (HYST_REST_SCANS / 2U);
+    uint32_t levels =
+        (r.sweep_steps > 0U) ? (out_max * r.sweep_events) / r.sweep_steps
+                             : 0U;
+
+    LOG_INF("[hyst %s%s] rest events/s %u.%02u, sweep: %u changes, %u "
+            "levels over the travel",
+            hyst_names[kinds[k]], (kinds[k] == BENCH_LIVE_HYST) ? "*" : "",
+            rest_x100 / 100U, rest_x100 % 100U, r.sweep_events, levels);
+  }
+}
+
+void filter_bench_run(void) {
+  LOG_INF("=== Filter bench start ===");
+  bench_decimator();
+  bench_kernels();
+  bench_modes();
+  bench_predict();
+  bench_hyst();
+  LOG_INF("=== Filter bench done ===");
+}
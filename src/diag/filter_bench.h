@@ -0,0 +1,7 @@
+#pragma once
+
+/*
+ * Feed a deterministic synthetic pedal trace through the filter stages and
+ * log noise/latency figures. Runs before the pedal pipeline is started.
+ */
+void filter_bench_run(void);
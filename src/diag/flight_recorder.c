@@ -0,0 +1,313 @@
+#include "flight_recorder.h"
+#include "midal_conf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_SHELL)
+#include "transports/transport_usb_midi.h"
+
+#include <zephyr/shell/shell.h>
+#endif
+
+LOG_MODULE_REGISTER(flight_rec, LOG_LEVEL_INF);
+
+#define REC_SCANS CONFIG_MIDAL_FLIGHT_RECORDER_SCANS
+#define REC_MASK (REC_SCANS - 1U)
+#define REC_POST_SCANS                                                         \
+  ((REC_SCANS * CONFIG_MIDAL_FLIGHT_RECORDER_POST_PCT) / 100U)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(REC_SCANS),
+             "MIDAL_FLIGHT_RECORDER_SCANS must be a power of two");
+
+typedef enum {
+  REC_ARMED,     /* Recording, waiting for a trigger */
+  REC_TRIGGERED, /* Recording the post-trigger scans */
+  REC_FROZEN,    /* Holding the trace */
+} rec_state_t;
+
+static flight_rec_entry_t s_ring[REC_SCANS];
+/* Scans recorded since boot; the next entry goes at s_head & REC_MASK */
+static atomic_t s_head;
+static atomic_t s_state;
+static atomic_t s_reason;
+/*
+ * s_head when the trigger fired: the ring freezes REC_POST_SCANS after it,
+ * keeping the REC_SCANS - REC_POST_SCANS scans before it
+ */
+static atomic_t s_trig_head;
+
+/* Sampler thread only */
+static uint16_t s_filtered[MIDAL_NUM_PEDALS];
+static int16_t s_prev_raw[MIDAL_NUM_PEDALS];
+static bool s_prev_valid;
+
+static const char *const s_reason_names[FLIGHT_REC_TRIG_COUNT] = {
+    [FLIGHT_REC_TRIG_NONE] = "none",
+    [FLIGHT_REC_TRIG_SHELL] = "shell",
+    [FLIGHT_REC_TRIG_JUMP] = "jump",
+    [FLIGHT_REC_TRIG_ADC_TIMEOUT] = "adc-timeout",
+};
+
+void flight_rec_scan(const pedal_raw_sample_t *sample) {
+  const rec_state_t state = (rec_state_t)atomic_get(&s_state);
+
+  if (state == REC_FROZEN) {
+    s_prev_valid = false; /* No jump across the gap once re-armed */
+    return;
+  }
+  const uint32_t head = (uint32_t)atomic_get(&s_head);
+
+  if (state == REC_TRIGGERED &&
+      head - (uint32_t)atomic_get(&s_trig_head) >= REC_POST_SCANS) {
+    atomic_set(&s_state, REC_FROZEN);
+    LOG_INF("Flight recorder frozen (%s)",
+            s_reason_names[atomic_get(&s_reason)]);
+    return;
+  }
+
+  flight_rec_entry_t *e = &s_ring[head & REC_MASK];
+
+  e->timestamp_us = sample->timestamp_us;
+  memcpy(e->raw, sample->values, sizeof(e->raw));
+  memcpy(e->filtered, s_filtered, sizeof(e->filtered));
+
+  if (CONFIG_MIDAL_FLIGHT_RECORDER_JUMP_LSB > 0 && s_prev_valid) {
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      if (abs((int32_t)sample->values[i] - (int32_t)s_prev_raw[i]) >
+          CONFIG_MIDAL_FLIGHT_RECORDER_JUMP_LSB) {
+        flight_rec_trigger(FLIGHT_REC_TRIG_JUMP);
+        break;
+      }
+    }
+  }
+  memcpy(s_prev_raw, sample->values, sizeof(s_prev_raw));
+  s_prev_valid = true;
+
+  atomic_set(&s_head, (atomic_val_t)(head + 1U));
+}
+
+void flight_rec_output(const uint16_t values[MIDAL_NUM_PEDALS]) {
+  memcpy(s_filtered, values, sizeof(s_filtered));
+
+  /* The entry of this scan is written; the ring freezes on the next one */
+  const uint32_t head = (uint32_t)atomic_get(&s_head);
+  if (head > 0U && atomic_get(&s_state) != REC_FROZEN) {
+    memcpy(s_ring[(head - 1U) & REC_MASK].filtered, values,
+           sizeof(s_filtered));
+  }
+}
+
+void flight_rec_trigger(flight_rec_trigger_t why) {
+  if (why == FLIGHT_REC_TRIG_NONE || why >= FLIGHT_REC_TRIG_COUNT ||
+      !atomic_cas(&s_reason, FLIGHT_REC_TRIG_NONE, why)) {
+    return;
+  }
+
+  atomic_set(&s_trig_head, atomic_get(&s_head));
+  atomic_set(&s_state, REC_TRIGGERED);
+}
+
+void flight_rec_rearm(void) {
+  atomic_set(&s_state, REC_ARMED);
+  atomic_clear(&s_reason);
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+/* SysEx dump: universal non-commercial ID, "MR", then the record type */
+#define REC_SYSEX_ID 0x7DU
+#define REC_SYSEX_HEADER 0x01U
+#define REC_SYSEX_ENTRY 0x02U
+#define REC_SYSEX_END 0x03U
+#define REC_SYSEX_VERSION 1U
+#define REC_SYSEX_TIMEOUT K_MSEC(100)
+
+/* Frozen trace as [first, first + count) in s_head terms */
+static bool rec_frozen_span(uint32_t *first, uint32_t *count) {
+  if (atomic_get(&s_state) != REC_FROZEN) {
+    return false;
+  }
+
+  const uint32_t head = (uint32_t)atomic_get(&s_head);
+  *count = MIN(head, (uint32_t)REC_SCANS);
+  *first = head - *count;
+  return true;
+}
+
+/* 8-to-7 packing: per 7 bytes, one byte of MSBs then the low 7 bits */
+static size_t rec_pack7(const uint8_t *in, size_t len, uint8_t *out) {
+  size_t n = 0U;
+
+  for (size_t off = 0; off < len; off += 7U) {
+    const size_t k = MIN(len - off, 7U);
+    uint8_t msbs = 0U;
+
+    for (size_t i = 0; i < k; i++) {
+      msbs |= (uint8_t)((in[off + i] >> 7) << i);
+    }
+    out[n++] = msbs;
+    for (size_t i = 0; i < k; i++) {
+      out[n++] = in[off + i] & 0x7F;
+    }
+  }
+  return n;
+}
+
+static size_t rec_sysex_start(uint8_t *msg, uint8_t type) {
+  msg[0] = REC_SYSEX_ID;
+  msg[1] = 'M';
+  msg[2] = 'R';
+  msg[3] = type;
+  return 4U;
+}
+
+static int cmd_rec_status(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  static const char *const state_names[] = {
+      [REC_ARMED] = "armed",
+      [REC_TRIGGERED] = "triggered",
+      [REC_FROZEN] = "frozen",
+  };
+  const uint32_t head = (uint32_t)atomic_get(&s_head);
+  const rec_state_t state = (rec_state_t)atomic_get(&s_state);
+
+  shell_print(sh, "%s, %u of %u scans, trigger %s", state_names[state],
+              MIN(head, (uint32_t)REC_SCANS), (uint32_t)REC_SCANS,
+              s_reason_names[atomic_get(&s_reason)]);
+  return 0;
+}
+
+static int cmd_rec_freeze(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  flight_rec_trigger(FLIGHT_REC_TRIG_SHELL);
+  shell_print(sh, "trigger set; frozen after %u more scans",
+              (uint32_t)REC_POST_SCANS);
+  return 0;
+}
+
+static int cmd_rec_rearm(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  flight_rec_rearm();
+  shell_print(sh, "recording");
+  return 0;
+}
+
+static int cmd_rec_dump(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  uint32_t first;
+  uint32_t count;
+
+  if (!rec_frozen_span(&first, &count)) {
+    shell_error(sh, "not frozen: run \"midal rec freeze\" first");
+    return -EBUSY;
+  }
+
+  const uint32_t trig = (uint32_t)atomic_get(&s_trig_head) - first;
+
+  shell_print(sh, "# midal flight recorder: %u scans, trigger %s at row %u",
+              count, s_reason_names[atomic_get(&s_reason)], trig);
+  shell_fprintf(sh, SHELL_NORMAL, "t_us");
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    shell_fprintf(sh, SHELL_NORMAL, ",raw%u", (unsigned)i);
+  }
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    shell_fprintf(sh, SHELL_NORMAL, ",out%u", (unsigned)i);
+  }
+  shell_fprintf(sh, SHELL_NORMAL, "\n");
+
+  for (uint32_t n = 0; n < count; n++) {
+    const flight_rec_entry_t *e = &s_ring[(first + n) & REC_MASK];
+
+    shell_fprintf(sh, SHELL_NORMAL, "%u", e->timestamp_us);
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      shell_fprintf(sh, SHELL_NORMAL, ",%d", e->raw[i]);
+    }
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      shell_fprintf(sh, SHELL_NORMAL, ",%u", e->filtered[i]);
+    }
+    shell_fprintf(sh, SHELL_NORMAL, "\n");
+  }
+  return 0;
+}
+
+static int cmd_rec_sysex(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  uint8_t msg[4U + 2U + DIV_ROUND_UP(sizeof(flight_rec_entry_t) * 8U, 7U)];
+  uint32_t first;
+  uint32_t count;
+  size_t n;
+  int ret;
+
+  if (!rec_frozen_span(&first, &count)) {
+    shell_error(sh, "not frozen: run \"midal rec freeze\" first");
+    return -EBUSY;
+  }
+
+  const uint32_t trig = (uint32_t)atomic_get(&s_trig_head) - first;
+
+  /* Header: version, pedals, trigger reason, scans and trigger row */
+  n = rec_sysex_start(msg, REC_SYSEX_HEADER);
+  msg[n++] = REC_SYSEX_VERSION;
+  msg[n++] = MIDAL_NUM_PEDALS;
+  msg[n++] = (uint8_t)atomic_get(&s_reason);
+  msg[n++] = count & 0x7F;
+  msg[n++] = (count >> 7) & 0x7F;
+  msg[n++] = trig & 0x7F;
+  msg[n++] = (trig >> 7) & 0x7F;
+  ret = transport_usb_send_sysex(msg, n, REC_SYSEX_TIMEOUT);
+
+  for (uint32_t i = 0; ret == 0 && i < count; i++) {
+    const flight_rec_entry_t *e = &s_ring[(first + i) & REC_MASK];
+
+    n = rec_sysex_start(msg, REC_SYSEX_ENTRY);
+    msg[n++] = i & 0x7F;
+    msg[n++] = (i >> 7) & 0x7F;
+    n += rec_pack7((const uint8_t *)e, sizeof(*e), &msg[n]);
+    ret = transport_usb_send_sysex(msg, n, REC_SYSEX_TIMEOUT);
+  }
+
+  if (ret == 0) {
+    n = rec_sysex_start(msg, REC_SYSEX_END);
+    msg[n++] = count & 0x7F;
+    msg[n++] = (count >> 7) & 0x7F;
+    ret = transport_usb_send_sysex(msg, n, REC_SYSEX_TIMEOUT);
+  }
+
+  if (ret != 0) {
+    shell_error(sh, "SysEx dump failed: %d", ret);
+    return ret;
+  }
+  shell_print(sh, "%u scans sent as SysEx", count);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    rec_cmds,
+    SHELL_CMD(freeze, NULL, "Trigger: freeze after the post-trigger scans",
+              cmd_rec_freeze),
+    SHELL_CMD(rearm, NULL, "Discard the trace and record again",
+              cmd_rec_rearm),
+    SHELL_CMD(dump, NULL, "Print the frozen trace as CSV", cmd_rec_dump),
+    SHELL_CMD(sysex, NULL, "Send the frozen trace as SysEx over USB MIDI",
+              cmd_rec_sysex),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((midal), rec, &rec_cmds, "Raw ADC flight recorder",
+                 cmd_rec_status, 1, 0);
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "midal_conf.h"
+#include "pedal/pedal_sampler.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+/**
+ * @file flight_recorder.h
+ * @brief Raw ADC flight recorder
+ *
+ * A RAM ring of the last CONFIG_MIDAL_FLIGHT_RECORDER_SCANS raw scans, each
+ * with the filter outputs current at that scan (held between decimated
+ * outputs). A trigger (shell command, raw jump detector, ADC timeout) lets
+ * CONFIG_MIDAL_FLIGHT_RECORDER_POST_PCT percent of the ring fill after it
+ * and then freezes the ring until it is re-armed, so the trace shows the
+ * moments around the event. Recording costs one entry write and one jump
+ * check per scan, whatever the state.
+ *
+ * With CONFIG_SHELL the frozen ring is dumped as CSV on the console
+ * ("midal rec dump") or as SysEx over USB MIDI ("midal rec sysex",
+ * tools/midal_flightrec.py turns a capture into CSV).
+ */
+
+typedef enum {
+  FLIGHT_REC_TRIG_NONE = 0,
+  FLIGHT_REC_TRIG_SHELL,       /* "midal rec freeze" */
+  FLIGHT_REC_TRIG_JUMP,        /* Raw step over the jump threshold */
+  FLIGHT_REC_TRIG_ADC_TIMEOUT, /* Block acquisition timed out */
+  FLIGHT_REC_TRIG_COUNT
+} flight_rec_trigger_t;
+
+typedef struct {
+  uint32_t timestamp_us;               /* Capture time of the scan */
+  int16_t raw[MIDAL_NUM_PEDALS];       /* SAADC results */
+  uint16_t filtered[MIDAL_NUM_PEDALS]; /* Filter outputs at that scan */
+} flight_rec_entry_t;
+
+#if IS_ENABLED(CONFIG_MIDAL_FLIGHT_RECORDER)
+
+/* Record one raw scan; sampler thread only */
+void flight_rec_scan(const pedal_raw_sample_t *sample);
+
+/* Filter outputs of the scan just recorded; sampler thread only */
+void flight_rec_output(const uint16_t values[MIDAL_NUM_PEDALS]);
+
+/* Freeze after the post-trigger scans; first trigger wins, any context */
+void flight_rec_trigger(flight_rec_trigger_t why);
+
+/* Discard the frozen trace and record again */
+void flight_rec_rearm(void);
+
+#else
+
+static inline void flight_rec_scan(const pedal_raw_sample_t *sample) {
+  ARG_UNUSED(sample);
+}
+
+static inline void flight_rec_output(const uint16_t values[MIDAL_NUM_PEDALS]) {
+  ARG_UNUSED(values);
+}
+
+static inline void flight_rec_trigger(flight_rec_trigger_t why) {
+  ARG_UNUSED(why);
+}
+
+#endif
@@ -1,33 +1,208 @@
+#include <zephyr/bluetooth/gap.h>
 #include <zephyr/kernel.h>
 #include <zephyr/sys/printk.h>
 
+#include <string.h>
+
+#include "diag/heartbeat.h"
+#include "diag/latency.h"
+#include "diag/profiler.h"
 #include "diag/stats.h"
 #include "transports/transport_ble_midi.h"
 #include "transports/transport_usb_midi.h"
 
-static void hb_timer_cb(struct k_timer *timer) {
-  ARG_UNUSED(timer);
+#define HB_WQ_STACK_SIZE 2048
+/* Below every pipeline thread: formatting never delays a sample */
+#define HB_WQ_PRIORITY K_LOWEST_APPLICATION_THREAD_PRIO
+
+static K_THREAD_STACK_DEFINE(hb_wq_stack, HB_WQ_STACK_SIZE);
+static struct k_work_q hb_wq;
+
+/* Packets per batch; unit names what a batch is on that link */
+static void hb_print_batching(const char *name, const char *unit,
+                              const struct transport_stats *tx) {
+  uint32_t per_x100 = (tx->batches > 0U)
+                          ? (uint32_t)(((uint64_t)tx->packets * 100U) /
+                                       tx->batches)
+                          : 0U;
+
+  printk(" | %s %s=%lu pk/%s=%lu.%02lu", name, unit,
+         (unsigned long)tx->batches, unit, (unsigned long)(per_x100 / 100U),
+         (unsigned long)(per_x100 % 100U));
+}
+
+#if IS_ENABLED(CONFIG_MIDAL_LATENCY)
+/* p50/p99 since capture of the probes in [first, last], e.g. " send=410/980" */
+static void hb_print_latency(const char *name, latency_probe_t first,
+                             latency_probe_t last) {
+  printk(" | %s", name);
+  for (int p = first; p <= (int)last; p++) {
+    struct latency_stats st;
+    const char *probe = latency_probe_name((latency_probe_t)p);
+    const char *dot = strchr(probe, '.');
+
+    latency_get_stats((latency_probe_t)p, &st);
+    printk(" %s=%lu/%lu", (dot != NULL) ? dot + 1 : probe,
+           (unsigned long)st.p50_us, (unsigned long)st.p99_us);
+  }
+}
+#endif
+
+static const char *hb_phy_name(uint8_t phy) {
+  switch (phy) {
+  case BT_GAP_LE_PHY_1M:
+    return "1M";
+  case BT_GAP_LE_PHY_2M:
+    return "2M";
+  case BT_GAP_LE_PHY_CODED:
+    return "coded";
+  default:
+    return "?";
+  }
+}
+
+static void hb_print_work(struct k_work *work) {
+  ARG_UNUSED(work);
   /* Use printk to bypass the logging backend entirely */
   uint32_t t = k_uptime_get_32();
 
   bool usb_ready = transport_usb_ready();
   bool ble_ready =
-      IS_ENABLED(CONFIG_BLE_MIDI) ? transport_ble_midi_ready() : false;
+      IS_ENABLED(CONFIG_MIDAL_BLE_TRANSPORT) ? transport_ble_midi_ready() : false;
 
   struct midal_stats stats;
   midal_get_stats(&stats);
 
   printk(
-      "[hb] t=%ums usb=%d ble=%d | events=%lu usb_tx=%lu/%lu ble_tx=%lu/%lu\n",
+      "[hb] t=%ums usb=%d ble=%d | events=%lu usb_tx=%lu/%lu/%lu/%lu"
+      " ble_tx=%lu/%lu/%lu/%lu"
+      " | rate=%s active=%lums idle=%lums"
+      " | clk overrun=%lu jitter=%ld/%ld/%luns lat_max=%luns"
+      " | filt=%s %lu/%lucyc | first_ev=%lums\n",
       t, usb_ready ? 1 : 0, ble_ready ? 1 : 0,
       (unsigned long)stats.total_events, (unsigned long)stats.usb.sent,
+      (unsigned long)stats.usb.coalesced, (unsigned long)stats.usb.aged,
       (unsigned long)stats.usb.dropped, (unsigned long)stats.ble.sent,
-      (unsigned long)stats.ble.dropped);
+      (unsigned long)stats.ble.coalesced, (unsigned long)stats.ble.aged,
+      (unsigned long)stats.ble.dropped, stats.rate.idle ? "idle" : "active",
+      (unsigned long)stats.rate.active_ms, (unsigned long)stats.rate.idle_ms,
+      (unsigned long)stats.clock.overruns, (long)stats.clock.jitter_min_ns,
+      (long)stats.clock.jitter_max_ns,
+      (unsigned long)stats.clock.jitter_mean_abs_ns,
+      (unsigned long)stats.clock.latency_max_ns,
+      stats.filter.fixed_point ? "q30" : "f32",
+      (unsigned long)stats.filter.cycles_avg,
+      (unsigned long)stats.filter.cycles_max,
+      (unsigned long)(stats.boot.first_event_us / 1000U));
+
+  printk("[hb] batching");
+  hb_print_batching("usb", "flush", &stats.usb);
+  if (IS_ENABLED(CONFIG_MIDAL_BLE_TRANSPORT)) {
+    hb_print_batching("ble", "notif", &stats.ble);
+    printk(" stamp_lag_max=%luus", (unsigned long)stats.ble.stamp_lag_us);
+  }
+  printk("\n");
+
+  if (IS_ENABLED(CONFIG_MIDAL_BLE_TRANSPORT) && stats.ble_link.connected) {
+    const struct ble_link_stats *l = &stats.ble_link;
+
+    printk("[hb] ble link int=%lu.%02lums lat=%u phy=%s/%s mtu=%u dl=%u"
+           " turn=%lu/%luus rejects=%lu\n",
+           (unsigned long)(l->interval_us / 1000U),
+           (unsigned long)((l->interval_us % 1000U) / 10U), l->latency,
+           hb_phy_name(l->tx_phy), hb_phy_name(l->rx_phy), l->mtu,
+           l->tx_octets, (unsigned long)l->turnaround_avg_us,
+           (unsigned long)l->turnaround_max_us, (unsigned long)l->rejects);
+  }
+
+  if (IS_ENABLED(CONFIG_MIDAL_DIN_MIDI)) {
+    /* Wire utilization since the previous heartbeat */
+    static uint32_t prev_t;
+    static uint32_t prev_busy_us;
+    uint32_t dt_us = (t - prev_t) * 1000U;
+    uint32_t busy_us = stats.din_link.busy_us - prev_busy_us;
+    uint32_t util_x10 =
+        (dt_us > 0U) ? (uint32_t)(((uint64_t)busy_us * 1000U) / dt_us) : 0U;
+
+    prev_t = t;
+    prev_busy_us = stats.din_link.busy_us;
+    printk("[hb] din tx=%lu/%lu/%lu bytes=%lu util=%lu.%lu%%\n",
+           (unsigned long)stats.din.sent, (unsigned long)stats.din.coalesced,
+           (unsigned long)stats.din.dropped,
+           (unsigned long)stats.din_link.bytes,
+           (unsigned long)(util_x10 / 10U), (unsigned long)(util_x10 % 10U));
+  }
+
+#if IS_ENABLED(CONFIG_MIDAL_LATENCY)
+  printk("[hb] latency p50/p99 us");
+  hb_print_latency("pedal", LATENCY_FILTER, LATENCY_PUBLISH);
+  hb_print_latency("usb", LATENCY_USB_DEQUEUE, LATENCY_USB_QUEUED);
+  if (IS_ENABLED(CONFIG_MIDAL_BLE_TRANSPORT)) {
+    hb_print_latency("ble", LATENCY_BLE_DEQUEUE, LATENCY_BLE_DONE);
+  }
+  if (IS_ENABLED(CONFIG_MIDAL_DIN_MIDI)) {
+    hb_print_latency("din", LATENCY_DIN_DEQUEUE, LATENCY_DIN_DONE);
+  }
+  printk("\n");
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_PROFILER)
+  struct profiler_stats ps;
+  struct profiler_stage_stats block;
+
+  profiler_get_stats(&ps);
+  profiler_get_stage_stats(PROF_BLOCK, &block);
+  printk("[hb] prof load=%lu.%lu%% miss=%lu/%lu worst=%lu.%lu%%"
+         " block=%lu/%lucyc\n",
+         (unsigned long)(ps.cpu_load_permille / 10U),
+         (unsigned long)(ps.cpu_load_permille % 10U),
+         (unsigned long)ps.deadline_misses, (unsigned long)ps.blocks,
+         (unsigned long)(ps.budget_max_permille / 10U),
+         (unsigned long)(ps.budget_max_permille % 10U),
+         (unsigned long)block.mean_cycles, (unsigned long)block.max_cycles);
+#endif
+
+  if (IS_ENABLED(CONFIG_MIDAL_FILTER_HYST_AUTO)) {
+    printk("[hb] dead band");
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      const struct pedal_noise_stats *n = &stats.noise[i];
+      uint32_t ev_milli =
+          (n->rest_ms > 0U)
+              ? (uint32_t)(((uint64_t)n->rest_events * 1000000U) / n->rest_ms)
+              : 0U;
+
+      printk(" | p%u %s h=%u/%u noise=%lu.%03lu rest_ev=%lu.%03lu/s lv=%lu",
+             (unsigned)i, n->moving ? "move" : "rest", n->hyst, n->hyst_rest,
+             (unsigned long)(n->noise_milli / 1000U),
+             (unsigned long)(n->noise_milli % 1000U),
+             (unsigned long)(ev_milli / 1000U),
+             (unsigned long)(ev_milli % 1000U),
+             (unsigned long)n->motion_levels);
+    }
+    printk("\n");
+  }
+}
+
+static K_WORK_DEFINE(hb_work, hb_print_work);
+
+/* The timer only queues the work: nothing is gathered or printed in ISR */
+static void hb_timer_cb(struct k_timer *timer) {
+  ARG_UNUSED(timer);
+  (void)k_work_submit_to_queue(&hb_wq, &hb_work);
 }
 
 K_TIMER_DEFINE(hb_timer, hb_timer_cb, NULL);
 
+struct k_work_q *heartbeat_work_queue(void) { return &hb_wq; }
+
 void heartbeat_start(void) {
-  /* Fire every 1000 ms; first tick after 1000 ms */
-  k_timer_start(&hb_timer, K_MSEC(1000), K_MSEC(1000));
+  const struct k_work_queue_config cfg = {.name = "heartbeat"};
+
+  k_work_queue_start(&hb_wq, hb_wq_stack, K_THREAD_STACK_SIZEOF(hb_wq_stack),
+                     HB_WQ_PRIORITY, &cfg);
+
+  if (IS_ENABLED(CONFIG_MIDAL_HEARTBEAT)) {
+    /* Fire every 1000 ms; first tick after 1000 ms */
+    k_timer_start(&hb_timer, K_MSEC(1000), K_MSEC(1000));
+  }
 }
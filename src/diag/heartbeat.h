@@ -1,2 +1,12 @@
 #pragma once
+
+#include <zephyr/kernel.h>
+
+/*
+ * Start the diagnostics work queue (lowest application priority) and, with
+ * CONFIG_MIDAL_HEARTBEAT, the once-per-second text heartbeat on it.
+ */
 void heartbeat_start(void);
+
+/* Work queue for periodic diagnostics output; valid after heartbeat_start() */
+struct k_work_q *heartbeat_work_queue(void);
@@ -0,0 +1,205 @@
+#include "latency.h"
+#include "diag/stats.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+/*
+ * Bin layout: values below 4 us get a bin each, then every octave is split
+ * in four (at most 25% wide). The last octave starts at 2^20 us (about 1 s)
+ * and its last bin also holds everything above.
+ */
+#define LAT_SUB_BITS 2U
+#define LAT_SUB_BINS BIT(LAT_SUB_BITS)
+#define LAT_MAX_OCTAVE 20U
+#define LAT_BINS ((LAT_MAX_OCTAVE - LAT_SUB_BITS + 2U) * LAT_SUB_BINS)
+
+struct latency_hist {
+  atomic_t bins[LAT_BINS];
+  atomic_t max_us;
+};
+
+static struct latency_hist s_hist[LATENCY_PROBE_COUNT];
+
+static const char *const s_probe_names[LATENCY_PROBE_COUNT] = {
+    [LATENCY_FILTER] = "filter",
+    [LATENCY_PUBLISH] = "publish",
+    [LATENCY_USB_DEQUEUE] = "usb.dequeue",
+    [LATENCY_USB_SEND] = "usb.send",
+    [LATENCY_USB_QUEUED] = "usb.queued",
+    [LATENCY_BLE_DEQUEUE] = "ble.dequeue",
+    [LATENCY_BLE_SEND] = "ble.send",
+    [LATENCY_BLE_DONE] = "ble.done",
+    [LATENCY_DIN_DEQUEUE] = "din.dequeue",
+    [LATENCY_DIN_SEND] = "din.send",
+    [LATENCY_DIN_DONE] = "din.done",
+};
+
+static inline uint32_t lat_bin(uint32_t us) {
+  if (us < LAT_SUB_BINS) {
+    return us;
+  }
+
+  uint32_t octave = 31U - (uint32_t)__builtin_clz(us);
+  if (octave > LAT_MAX_OCTAVE) {
+    return LAT_BINS - 1U;
+  }
+  return ((octave - LAT_SUB_BITS + 1U) * LAT_SUB_BINS) +
+         ((us >> (octave - LAT_SUB_BITS)) & (LAT_SUB_BINS - 1U));
+}
+
+/* Lowest value that falls in bin */
+static uint32_t lat_bin_floor(uint32_t bin) {
+  if (bin < LAT_SUB_BINS) {
+    return bin;
+  }
+
+  uint32_t octave = (bin / LAT_SUB_BINS) + LAT_SUB_BITS - 1U;
+  return (LAT_SUB_BINS + (bin % LAT_SUB_BINS)) << (octave - LAT_SUB_BITS);
+}
+
+void latency_record_at(latency_probe_t probe, uint32_t capture_us,
+                       uint32_t now_us) {
+  if ((unsigned int)probe >= LATENCY_PROBE_COUNT) {
+    return;
+  }
+
+  struct latency_hist *h = &s_hist[probe];
+  uint32_t us = now_us - capture_us;
+
+  atomic_inc(&h->bins[lat_bin(us)]);
+
+  /* Several recorders per probe (thread and ISR): keep the larger */
+  atomic_val_t max = atomic_get(&h->max_us);
+  while (us > (uint32_t)max &&
+         !atomic_cas(&h->max_us, max, (atomic_val_t)us)) {
+    max = atomic_get(&h->max_us);
+  }
+}
+
+void latency_record(latency_probe_t probe, uint32_t capture_us) {
+  latency_record_at(probe, capture_us,
+                    k_ticks_to_us_floor32(k_uptime_ticks()));
+}
+
+const char *latency_probe_name(latency_probe_t probe) {
+  if ((unsigned int)probe >= LATENCY_PROBE_COUNT) {
+    return "?";
+  }
+  return s_probe_names[probe];
+}
+
+void latency_get_stats(latency_probe_t probe, struct latency_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  *stats = (struct latency_stats){0};
+  if ((unsigned int)probe >= LATENCY_PROBE_COUNT) {
+    return;
+  }
+
+  const struct latency_hist *h = &s_hist[probe];
+  uint32_t bins[LAT_BINS];
+  uint32_t total = 0U;
+
+  /* Snapshot first so the percentiles agree with each other */
+  for (size_t b = 0; b < LAT_BINS; b++) {
+    bins[b] = (uint32_t)atomic_get(&h->bins[b]);
+    total += bins[b];
+  }
+
+  stats->count = total;
+  stats->max_us = (uint32_t)atomic_get(&h->max_us);
+  if (total == 0U) {
+    return;
+  }
+
+  /* Report the upper edge of the bin holding each rank */
+  const uint32_t rank50 = DIV_ROUND_UP(total * 50ULL, 100U);
+  const uint32_t rank90 = DIV_ROUND_UP(total * 90ULL, 100U);
+  const uint32_t rank99 = DIV_ROUND_UP(total * 99ULL, 100U);
+  uint32_t seen = 0U;
+
+  for (size_t b = 0; b < LAT_BINS; b++) {
+    if (bins[b] == 0U) {
+      continue;
+    }
+
+    uint32_t prev = seen;
+    uint32_t edge = (b + 1U < LAT_BINS) ? lat_bin_floor(b + 1U) - 1U
+                                        : stats->max_us;
+    edge = MIN(edge, stats->max_us);
+    seen += bins[b];
+
+    if (prev < rank50 && seen >= rank50) {
+      stats->p50_us = edge;
+    }
+    if (prev < rank90 && seen >= rank90) {
+      stats->p90_us = edge;
+    }
+    if (prev < rank99 && seen >= rank99) {
+      stats->p99_us = edge;
+    }
+  }
+}
+
+void latency_reset(void) {
+  for (size_t p = 0; p < LATENCY_PROBE_COUNT; p++) {
+    struct latency_hist *h = &s_hist[p];
+
+    for (size_t b = 0; b < LAT_BINS; b++) {
+      atomic_clear(&h->bins[b]);
+    }
+    atomic_clear(&h->max_us);
+  }
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_latency_show(const struct shell *sh, size_t argc,
+                            char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  shell_print(sh, "%-13s %10s %8s %8s %8s %8s", "since capture", "count",
+              "p50 us", "p90 us", "p99 us", "max us");
+  for (size_t p = 0; p < LATENCY_PROBE_COUNT; p++) {
+    struct latency_stats st;
+
+    latency_get_stats((latency_probe_t)p, &st);
+    if (st.count == 0U) {
+      continue;
+    }
+    shell_print(sh, "%-13s %10u %8u %8u %8u %8u",
+                latency_probe_name((latency_probe_t)p), st.count, st.p50_us,
+                st.p90_us, st.p99_us, st.max_us);
+  }
+  return 0;
+}
+
+static int cmd_latency_reset(const struct shell *sh, size_t argc,
+                             char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  latency_reset();
+  shell_print(sh, "latency histograms cleared");
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    latency_cmds,
+    SHELL_CMD(reset, NULL, "Clear the latency histograms", cmd_latency_reset),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((midal), latency, &latency_cmds,
+                 "Pipeline latency percentiles since capture",
+                 cmd_latency_show, 1, 0);
+
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+/**
+ * @file latency.h
+ * @brief Pipeline latency histograms
+ *
+ * Every probe is the time from the SAADC capture of a scan (its frame
+ * timestamp) to a later point of the pipeline, so the difference between
+ * two probes of a path is the cost of the stages between them. Each probe
+ * feeds a fixed log-binned histogram (four bins per octave, up to about one
+ * second) of atomic counters: recording is lock-free and safe from ISRs.
+ */
+
+struct latency_stats;
+
+typedef enum {
+  LATENCY_FILTER,      /* Filter output */
+  LATENCY_PUBLISH,     /* Pedal frame publish returned */
+  LATENCY_USB_DEQUEUE, /* USB transport took the frame off the bus */
+  LATENCY_USB_SEND,    /* UMPs queued to the class driver */
+  LATENCY_USB_QUEUED,  /* Class TX work ran: UMPs in a bulk transfer, or
+                          still in the class ring behind the one in flight */
+  LATENCY_BLE_DEQUEUE, /* BLE transport took the frame off the bus */
+  LATENCY_BLE_SEND,    /* Message queued into the BLE MIDI packet */
+  LATENCY_BLE_DONE,    /* Notification sent (oldest message per packet) */
+  LATENCY_DIN_DEQUEUE, /* DIN transport took the frame off the bus */
+  LATENCY_DIN_SEND,    /* DMA transfer started */
+  LATENCY_DIN_DONE,    /* Last byte on the wire */
+  LATENCY_PROBE_COUNT
+} latency_probe_t;
+
+#if IS_ENABLED(CONFIG_MIDAL_LATENCY)
+
+/* Record that the scan captured at capture_us reached probe now */
+void latency_record(latency_probe_t probe, uint32_t capture_us);
+
+/* Same, at an already known time (several records of one instant) */
+void latency_record_at(latency_probe_t probe, uint32_t capture_us,
+                       uint32_t now_us);
+
+/* Short probe name, e.g. "usb.send" */
+const char *latency_probe_name(latency_probe_t probe);
+
+/**
+ * @brief Get the percentiles of one probe
+ *
+ * @param probe Probe to read
+ * @param stats Pointer to structure to fill with statistics
+ */
+void latency_get_stats(latency_probe_t probe, struct latency_stats *stats);
+
+/* Clear every histogram */
+void latency_reset(void);
+
+#else
+
+static inline void latency_record(latency_probe_t probe, uint32_t capture_us) {
+  ARG_UNUSED(probe);
+  ARG_UNUSED(capture_us);
+}
+
+static inline void latency_record_at(latency_probe_t probe,
+                                     uint32_t capture_us, uint32_t now_us) {
+  ARG_UNUSED(probe);
+  ARG_UNUSED(capture_us);
+  ARG_UNUSED(now_us);
+}
+
+#endif
@@ -0,0 +1,12 @@
+/**
+ * @file midal_shell.c
+ * @brief Root of the "midal" shell command
+ *
+ * Modules add their subcommands with SHELL_SUBCMD_ADD((midal), ...).
+ */
+
+#include <zephyr/shell/shell.h>
+
+SHELL_SUBCMD_SET_CREATE(midal_cmds, (midal));
+
+SHELL_CMD_REGISTER(midal, &midal_cmds, "MIDAL diagnostics", NULL);
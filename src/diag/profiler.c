@@ -0,0 +1,430 @@
+#include "profiler.h"
+#include "diag/stats.h"
+#include "midal_conf.h"
+#include "midi/midi_codec.h"
+#include "midi/midi_types.h"
+#include "pedal/pedal_filter.h"
+#include "pedal/sample_clock.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+/* CPU load window */
+#define PROF_LOAD_WINDOW_MS 1000U
+
+/*
+ * One writer per stage (the thread that runs it), so the sum needs no lock.
+ * A reset is requested through a flag and carried out by that writer.
+ */
+struct prof_stage {
+  atomic_t count;
+  atomic_t min;
+  atomic_t max;
+  atomic_t reset;
+  uint64_t sum;
+};
+
+static struct prof_stage s_stage[PROF_STAGE_COUNT];
+
+static const char *const s_stage_names[PROF_STAGE_COUNT] = {
+    [PROF_ADC] = "adc",
+    [PROF_FILTER] = "filter",
+    [PROF_PUBLISH] = "publish",
+    [PROF_LOG] = "log",
+    [PROF_BLOCK] = "block",
+    [PROF_ENCODE_USB] = "usb.encode",
+    [PROF_ENCODE_BLE] = "ble.encode",
+    [PROF_ENCODE_DIN] = "din.encode",
+};
+
+/* Reader wakeups over budget, and the worst share of the budget used */
+static atomic_t s_deadline_misses;
+static atomic_t s_budget_max_permille;
+
+/* Scheduler runtime at the start of the load window, and the last load */
+static struct k_spinlock s_load_lock;
+static uint64_t s_load_exec0;
+static uint64_t s_load_busy0;
+static uint32_t s_load_start_ms;
+static uint32_t s_load_permille;
+
+static void prof_stage_clear(struct prof_stage *st) {
+  st->sum = 0U;
+  atomic_set(&st->min, (atomic_val_t)UINT32_MAX);
+  atomic_clear(&st->max);
+  atomic_clear(&st->count);
+}
+
+void profiler_init(void) {
+#if IS_ENABLED(CONFIG_CORTEX_M_DWT)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+  for (size_t s = 0; s < PROF_STAGE_COUNT; s++) {
+    prof_stage_clear(&s_stage[s]);
+    atomic_clear(&s_stage[s].reset);
+  }
+}
+
+uint32_t profiler_cycles_per_sec(void) {
+#if IS_ENABLED(CONFIG_CORTEX_M_DWT)
+  return SystemCoreClock;
+#else
+  return sys_clock_hw_cycles_per_sec();
+#endif
+}
+
+static void prof_account(prof_stage_t stage, uint32_t cycles) {
+  struct prof_stage *st = &s_stage[stage];
+
+  if (atomic_clear(&st->reset) != 0) {
+    prof_stage_clear(st);
+  }
+
+  st->sum += cycles;
+  if (cycles < (uint32_t)atomic_get(&st->min)) {
+    atomic_set(&st->min, (atomic_val_t)cycles);
+  }
+  if (cycles > (uint32_t)atomic_get(&st->max)) {
+    atomic_set(&st->max, (atomic_val_t)cycles);
+  }
+  /* Last, so a reader never sees a count without its sample */
+  atomic_inc(&st->count);
+}
+
+void prof_end(prof_stage_t stage, uint32_t t0) {
+  if ((unsigned int)stage >= PROF_STAGE_COUNT) {
+    return;
+  }
+  prof_account(stage, prof_cycles() - t0);
+}
+
+void prof_block_end(uint32_t t0, uint32_t period_us) {
+  const uint32_t cycles = prof_cycles() - t0;
+  const uint64_t budget =
+      ((uint64_t)period_us * profiler_cycles_per_sec()) / USEC_PER_SEC;
+
+  prof_account(PROF_BLOCK, cycles);
+  if (budget == 0U) {
+    return;
+  }
+
+  if (cycles > budget) {
+    atomic_inc(&s_deadline_misses);
+  }
+
+  /* Only the reader thread writes the maximum */
+  uint32_t permille = (uint32_t)MIN(((uint64_t)cycles * 1000U) / budget,
+                                    (uint64_t)UINT32_MAX);
+  if (permille > (uint32_t)atomic_get(&s_budget_max_permille)) {
+    atomic_set(&s_budget_max_permille, (atomic_val_t)permille);
+  }
+}
+
+const char *profiler_stage_name(prof_stage_t stage) {
+  if ((unsigned int)stage >= PROF_STAGE_COUNT) {
+    return "?";
+  }
+  return s_stage_names[stage];
+}
+
+void profiler_get_stage_stats(prof_stage_t stage,
+                              struct profiler_stage_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  *stats = (struct profiler_stage_stats){0};
+  if ((unsigned int)stage >= PROF_STAGE_COUNT) {
+    return;
+  }
+
+  const struct prof_stage *st = &s_stage[stage];
+  const uint32_t count = (uint32_t)atomic_get(&st->count);
+
+  if (count == 0U || atomic_get(&st->reset) != 0) {
+    return;
+  }
+
+  stats->count = count;
+  stats->min_cycles = (uint32_t)atomic_get(&st->min);
+  stats->max_cycles = (uint32_t)atomic_get(&st->max);
+  /* The sum may already include a sample the count does not */
+  stats->mean_cycles =
+      (uint32_t)MIN(st->sum / count, (uint64_t)stats->max_cycles);
+}
+
+/* Non-idle share of the CPU over the last full window, in permille */
+static uint32_t prof_cpu_load(void) {
+  k_spinlock_key_t key = k_spin_lock(&s_load_lock);
+  const uint32_t now = k_uptime_get_32();
+
+  if (s_load_start_ms == 0U || now - s_load_start_ms >= PROF_LOAD_WINDOW_MS) {
+    k_thread_runtime_stats_t rt;
+
+    if (k_thread_runtime_stats_all_get(&rt) == 0) {
+      const uint64_t exec = rt.execution_cycles - s_load_exec0;
+      const uint64_t busy = rt.total_cycles - s_load_busy0;
+
+      if (s_load_start_ms != 0U && exec > 0U) {
+        s_load_permille = (uint32_t)MIN((busy * 1000U) / exec, 1000U);
+      }
+      s_load_exec0 = rt.execution_cycles;
+      s_load_busy0 = rt.total_cycles;
+      s_load_start_ms = MAX(now, 1U);
+    }
+  }
+
+  uint32_t load = s_load_permille;
+  k_spin_unlock(&s_load_lock, key);
+  return load;
+}
+
+void profiler_get_stats(struct profiler_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  stats->cycles_per_sec = profiler_cycles_per_sec();
+  stats->cpu_load_permille = prof_cpu_load();
+  stats->blocks = (uint32_t)atomic_get(&s_stage[PROF_BLOCK].count);
+  stats->deadline_misses = (uint32_t)atomic_get(&s_deadline_misses);
+  stats->budget_max_permille = (uint32_t)atomic_get(&s_budget_max_permille);
+}
+
+void profiler_reset(void) {
+  for (size_t s = 0; s < PROF_STAGE_COUNT; s++) {
+    atomic_set(&s_stage[s].reset, 1);
+  }
+  atomic_clear(&s_deadline_misses);
+  atomic_clear(&s_budget_max_permille);
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+/* Scans and events per microbenchmark */
+#define PROF_BENCH_RUNS 512U
+
+typedef struct {
+  uint64_t sum;
+  uint32_t min;
+  uint32_t max;
+} bench_acc_t;
+
+static void bench_acc_reset(bench_acc_t *acc) {
+  *acc = (bench_acc_t){.min = UINT32_MAX};
+}
+
+static void bench_acc_add(bench_acc_t *acc, uint32_t cycles) {
+  acc->sum += cycles;
+  acc->min = MIN(acc->min, cycles);
+  acc->max = MAX(acc->max, cycles);
+}
+
+static void bench_print(const struct shell *sh, const char *name,
+                        const bench_acc_t *acc) {
+  const uint32_t cps = profiler_cycles_per_sec();
+  const uint32_t mean = (uint32_t)(acc->sum / PROF_BENCH_RUNS);
+
+  shell_print(sh, "%-16s %8u %8u %8u %8u", name, acc->min, mean, acc->max,
+              (uint32_t)(((uint64_t)mean * NSEC_PER_SEC) / cps));
+}
+
+static uint32_t s_bench_rng;
+
+/* Pedal-like trace: a slow sweep with a few LSB of noise */
+static uint16_t bench_raw(uint32_t scan, size_t pedal) {
+  s_bench_rng = s_bench_rng * 1664525U + 1013904223U;
+  uint32_t level = ((scan * 16U) + (pedal * 1000U)) % 4096U;
+  int32_t noise = (int32_t)((s_bench_rng >> 24) % 7U) - 3;
+
+  return (uint16_t)CLAMP((int32_t)level + noise, 0, 4095);
+}
+
+/* CC value of the trace in the build's value range */
+static uint16_t bench_value(uint32_t n) {
+  uint16_t raw = bench_raw(n, n % MIDAL_NUM_PEDALS);
+
+  return IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? (uint16_t)(raw << 2)
+                                               : (uint16_t)(raw >> 5);
+}
+
+static void bench_filter(const struct shell *sh) {
+  static const char *const names[PEDAL_FILTER_KERNEL_COUNT]
+                                 [PEDAL_FILTER_MODE_COUNT] = {
+      {"filter.f32.ema", "filter.f32.1euro", "filter.f32.pred"},
+      {"filter.q30.ema", "filter.q30.1euro", "filter.q30.pred"},
+  };
+  const pedal_filter_hyst_t hyst = IS_ENABLED(CONFIG_MIDAL_FILTER_HYST_AUTO)
+                                       ? PEDAL_FILTER_HYST_ADAPTIVE
+                                       : PEDAL_FILTER_HYST_STATIC;
+
+  for (size_t k = 0; k < PEDAL_FILTER_KERNEL_COUNT; k++) {
+    for (size_t m = 0; m < PEDAL_FILTER_MODE_COUNT; m++) {
+      uint16_t raw[MIDAL_NUM_PEDALS];
+      uint16_t out[MIDAL_NUM_PEDALS];
+      bench_acc_t acc;
+
+      bench_acc_reset(&acc);
+      s_bench_rng = 1U;
+      for (uint32_t n = 0; n < PROF_BENCH_RUNS; n++) {
+        for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+          raw[i] = bench_raw(n, i);
+        }
+
+        /* No thread switch inside a run; ISRs still count */
+        k_sched_lock();
+        uint32_t cycles = pedal_filter_bench_kernel(
+            (pedal_filter_kernel_t)k, (pedal_filter_mode_t)m, n == 0U, hyst,
+            raw, out);
+        k_sched_unlock();
+        bench_acc_add(&acc, cycles);
+      }
+      bench_print(sh, names[k][m], &acc);
+    }
+  }
+}
+
+typedef enum {
+  BENCH_ENC_MIDI1,
+  BENCH_ENC_BLE,
+  BENCH_ENC_UMP1,
+  BENCH_ENC_UMP2,
+  BENCH_ENC_COUNT,
+} bench_enc_t;
+
+static void bench_encode(const struct shell *sh) {
+  static const char *const names[BENCH_ENC_COUNT] = {
+      "encode.midi1",
+      "encode.ble",
+      "encode.ump1",
+      "encode.ump2",
+  };
+  static const uint8_t ccs[MIDAL_NUM_PEDALS] = {
+      MIDAL_CC_SUSTAIN, MIDAL_CC_SOSTENUTO, MIDAL_CC_SOFT};
+  const uint8_t flags =
+      IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? MIDI_CODEC_14BIT : 0U;
+
+  for (size_t f = 0; f < BENCH_ENC_COUNT; f++) {
+    uint8_t bytes[MIDI_CODEC_MIDI1_MAX];
+    uint32_t words[MIDI_CODEC_UMP_MAX];
+    midi_codec_t c;
+    bench_acc_t acc;
+
+    midi_codec_init(&c, (f == BENCH_ENC_MIDI1)
+                            ? (flags | MIDI_CODEC_RUNNING_STATUS)
+                            : (f == BENCH_ENC_BLE) ? (flags | MIDI_CODEC_LSB)
+                                                   : flags);
+    bench_acc_reset(&acc);
+    s_bench_rng = 1U;
+    for (uint32_t n = 0; n < PROF_BENCH_RUNS; n++) {
+      const midi_event_t ev = {
+          .type = MIDI_EV_CC,
+          .cc = {.ch = 0U,
+                 .cc = ccs[n % MIDAL_NUM_PEDALS],
+                 .value = bench_value(n)},
+          .timestamp_us = n * 1000U,
+      };
+
+      k_sched_lock();
+      uint32_t t0 = prof_cycles();
+      switch (f) {
+      case BENCH_ENC_MIDI1:
+      case BENCH_ENC_BLE:
+        (void)midi_codec_midi1(&c, &ev, bytes, sizeof(bytes));
+        break;
+      case BENCH_ENC_UMP1:
+        (void)midi_codec_ump_midi1(&c, &ev, 0U, words, ARRAY_SIZE(words));
+        break;
+      default:
+        (void)midi_codec_ump_midi2(&c, &ev, 0U, words, ARRAY_SIZE(words));
+        break;
+      }
+      uint32_t cycles = prof_cycles() - t0;
+      k_sched_unlock();
+      bench_acc_add(&acc, cycles);
+    }
+    bench_print(sh, names[f], &acc);
+  }
+}
+
+static int cmd_profile_show(const struct shell *sh, size_t argc,
+                            char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  struct profiler_stats ps;
+  struct sample_clock_stats clk;
+
+  profiler_get_stats(&ps);
+  sample_clock_get_stats(&clk);
+
+  shell_print(sh, "cpu load %u.%u%%, %u cycles/s", ps.cpu_load_permille / 10U,
+              ps.cpu_load_permille % 10U, ps.cycles_per_sec);
+  shell_print(sh,
+              "blocks %u, deadline misses %u, worst block %u.%u%% of its"
+              " period, clock overruns %u",
+              ps.blocks, ps.deadline_misses, ps.budget_max_permille / 10U,
+              ps.budget_max_permille % 10U, clk.overruns);
+  shell_print(sh, "%-12s %10s %8s %8s %8s", "stage", "count", "min cyc",
+              "mean cyc", "max cyc");
+  for (size_t s = 0; s < PROF_STAGE_COUNT; s++) {
+    struct profiler_stage_stats st;
+
+    profiler_get_stage_stats((prof_stage_t)s, &st);
+    if (st.count == 0U) {
+      continue;
+    }
+    shell_print(sh, "%-12s %10u %8u %8u %8u",
+                profiler_stage_name((prof_stage_t)s), st.count, st.min_cycles,
+                st.mean_cycles, st.max_cycles);
+  }
+  return 0;
+}
+
+static int cmd_profile_reset(const struct shell *sh, size_t argc,
+                             char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  profiler_reset();
+  shell_print(sh, "profiler counters cleared");
+  return 0;
+}
+
+static int cmd_bench(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  /* Private filter state and codecs: the live pipeline keeps running */
+  shell_print(sh, "%u runs, cycles per scan (filter) or event (encode)",
+              PROF_BENCH_RUNS);
+  shell_print(sh, "%-16s %8s %8s %8s %8s", "bench", "min", "mean", "max",
+              "mean ns");
+  bench_filter(sh);
+  bench_encode(sh);
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    profile_cmds,
+    SHELL_CMD(reset, NULL, "Clear the stage and deadline counters",
+              cmd_profile_reset),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((midal), profile, &profile_cmds,
+                 "Per-stage cycles, CPU load and sampling deadline misses",
+                 cmd_profile_show, 1, 0);
+
+SHELL_SUBCMD_ADD((midal), bench, NULL,
+                 "Microbenchmark the filter kernels and MIDI encoders",
+                 cmd_bench, 1, 0);
+
+#endif
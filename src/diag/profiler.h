@@ -0,0 +1,99 @@
+#pragma once
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_MIDAL_PROFILER) && IS_ENABLED(CONFIG_CORTEX_M_DWT)
+#include <cmsis_core.h>
+#endif
+
+/**
+ * @file profiler.h
+ * @brief Per-stage cycle profiler
+ *
+ * Stages of the sampling and transport paths are bracketed with
+ * prof_cycles() and accumulated as count, min, mean and max cycles. Cycles
+ * are CPU cycles from the DWT cycle counter on Cortex-M, otherwise kernel
+ * clock cycles (the native_sim timer). Each stage is written by a single
+ * thread; readers may see a slightly torn mean.
+ *
+ * The profiler also tracks CPU load (non-idle share of the scheduler's
+ * runtime statistics over the last full second) and sampling deadline
+ * misses: reader wakeups whose acquisition and processing took longer than
+ * the block period.
+ */
+
+struct profiler_stage_stats;
+struct profiler_stats;
+
+typedef enum {
+  PROF_ADC,        /* adc_read_async() up to k_poll() returning */
+  PROF_FILTER,     /* pedal_filter_apply_all() */
+  PROF_PUBLISH,    /* zbus_chan_pub() of a pedal frame */
+  PROF_LOG,        /* Pedal state logging */
+  PROF_BLOCK,      /* Reader wakeup: acquisition and processing */
+  PROF_ENCODE_USB, /* UMP encoding of one event (both in MIDI 2.0 mode) */
+  PROF_ENCODE_BLE, /* MIDI 1.0 encoding of one event for BLE */
+  PROF_ENCODE_DIN, /* Running-status encoding of one event for DIN */
+  PROF_STAGE_COUNT
+} prof_stage_t;
+
+#if IS_ENABLED(CONFIG_MIDAL_PROFILER)
+
+static inline uint32_t prof_cycles(void) {
+#if IS_ENABLED(CONFIG_CORTEX_M_DWT)
+  return DWT->CYCCNT;
+#else
+  return k_cycle_get_32();
+#endif
+}
+
+/* Enable the cycle counter; call once before the pipeline starts */
+void profiler_init(void);
+
+/* Cycle counter frequency */
+uint32_t profiler_cycles_per_sec(void);
+
+/* Account one run of stage that started at t0 (from prof_cycles()) */
+void prof_end(prof_stage_t stage, uint32_t t0);
+
+/* Account one reader wakeup that started at t0 against its period */
+void prof_block_end(uint32_t t0, uint32_t period_us);
+
+/* Short stage name, e.g. "filter" */
+const char *profiler_stage_name(prof_stage_t stage);
+
+/**
+ * @brief Get the cycle statistics of one stage
+ *
+ * @param stage Stage to read
+ * @param stats Pointer to structure to fill with statistics
+ */
+void profiler_get_stage_stats(prof_stage_t stage,
+                              struct profiler_stage_stats *stats);
+
+/**
+ * @brief Get CPU load and deadline statistics
+ *
+ * @param stats Pointer to structure to fill with statistics
+ */
+void profiler_get_stats(struct profiler_stats *stats);
+
+/* Clear the stage statistics and deadline counters */
+void profiler_reset(void);
+
+#else
+
+static inline uint32_t prof_cycles(void) { return 0U; }
+
+static inline void prof_end(prof_stage_t stage, uint32_t t0) {
+  ARG_UNUSED(stage);
+  ARG_UNUSED(t0);
+}
+
+static inline void prof_block_end(uint32_t t0, uint32_t period_us) {
+  ARG_UNUSED(t0);
+  ARG_UNUSED(period_us);
+}
+
+#endif
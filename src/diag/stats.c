@@ -5,9 +5,15 @@
 
 #include "stats.h"
 #include "stats_listener.h"
+#include "boot.h"
+#include "pedal/pedal_filter.h"
+#include "pedal/pedal_reader.h"
+#include "pedal/sample_clock.h"
 #include "transports/transport_ble_midi.h"
+#include "transports/transport_din_midi.h"
 #include "transports/transport_usb_midi.h"
 
+#include <string.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
@@ -36,10 +42,43 @@ void midal_get_stats(struct midal_stats *stats) {
   transport_usb_get_stats(&stats->usb);
 
   /* Get BLE transport stats */
-#if IS_ENABLED(CONFIG_BLE_MIDI)
+#if IS_ENABLED(CONFIG_MIDAL_BLE_TRANSPORT)
   transport_ble_get_stats(&stats->ble);
+  transport_ble_get_link_stats(&stats->ble_link);
 #else
   stats->ble.sent = 0;
+  stats->ble.coalesced = 0;
+  stats->ble.aged = 0;
   stats->ble.dropped = 0;
+  stats->ble.packets = 0;
+  stats->ble.batches = 0;
+  stats->ble.stamp_lag_us = 0;
+  memset(&stats->ble_link, 0, sizeof(stats->ble_link));
 #endif
+
+  /* Get DIN transport stats */
+#if IS_ENABLED(CONFIG_MIDAL_DIN_MIDI)
+  transport_din_get_stats(&stats->din);
+  transport_din_get_link_stats(&stats->din_link);
+#else
+  memset(&stats->din, 0, sizeof(stats->din));
+  memset(&stats->din_link, 0, sizeof(stats->din_link));
+#endif
+
+  /* Get pedal sampling rate stats */
+  pedal_reader_get_rate_stats(&stats->rate);
+
+  /* Get pedal sampling clock stats */
+  sample_clock_get_stats(&stats->clock);
+
+  /* Get pedal filter kernel cost */
+  pedal_filter_get_stats(&stats->filter);
+
+  /* Get boot phase timestamps */
+  boot_get_stats(&stats->boot);
+
+  /* Get per-pedal noise and dead band */
+  for (uint8_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    pedal_filter_get_noise_stats(i, &stats->noise[i]);
+  }
 }
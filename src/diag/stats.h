@@ -1,5 +1,7 @@
 #pragma once
 
+#include "midal_conf.h"
+
 #include <zephyr/kernel.h>
 
 /**
@@ -11,17 +13,170 @@
  * @brief Transport statistics
  */
 struct transport_stats {
-  uint32_t sent;    /* Successfully sent messages */
-  uint32_t dropped; /* Dropped messages (errors, queue full, etc.) */
+  uint32_t sent;         /* Successfully sent messages */
+  uint32_t coalesced;    /* Superseded by a newer value before sending */
+  uint32_t aged;         /* Shed after exceeding the age budget */
+  uint32_t dropped;      /* Lost for good (send errors, no staging slot) */
+  uint32_t packets;      /* Link packets queued (UMPs, BLE MIDI messages) */
+  uint32_t batches;      /* USB flushes, BLE notifications, DIN transfers */
+  uint32_t stamp_lag_us; /* Max capture-to-timestamp delay (BLE) */
+};
+
+/**
+ * @brief Pedal sampling rate statistics
+ */
+struct pedal_rate_stats {
+  uint32_t active_ms; /* Time spent sampling at the active poll rate */
+  uint32_t idle_ms;   /* Time spent at the idle rate */
+  uint32_t switches;  /* Number of rate changes */
+  bool idle;          /* Currently at the idle rate */
+};
+
+/**
+ * @brief Pedal sampling clock statistics
+ *
+ * Jitter is the change of the tick-to-acquisition-start latency between
+ * consecutive ticks, i.e. the deviation of each sample period from nominal.
+ */
+struct sample_clock_stats {
+  uint32_t ticks;              /* Sampling clock ticks */
+  uint32_t overruns;           /* Ticks that fired before the previous one was processed */
+  uint32_t period_ns;          /* Tick period after clock rounding */
+  int32_t jitter_min_ns;       /* Most negative period error */
+  int32_t jitter_max_ns;       /* Most positive period error */
+  uint32_t jitter_mean_abs_ns; /* Mean absolute period error */
+  uint32_t latency_max_ns;     /* Worst tick-to-acquisition-start latency */
+};
+
+/**
+ * @brief Pedal filter kernel cost
+ *
+ * Cycles are the profiler's "filter" stage (CONFIG_MIDAL_PROFILER, zero
+ * otherwise): CPU cycles when the DWT cycle counter is available, otherwise
+ * kernel clock cycles.
+ */
+struct pedal_filter_stats {
+  uint32_t scans;      /* Scans filtered (all pedals per scan) */
+  uint32_t cycles_avg; /* Mean cycles per scan */
+  uint32_t cycles_max; /* Worst cycles per scan */
+  bool fixed_point;    /* Fixed-point kernel in use */
+};
+
+/**
+ * @brief Pedal noise and output dead band
+ *
+ * Output LSBs are 7-bit or 14-bit CC steps. Rest and motion are told apart
+ * per block of samples from the filtered signal itself.
+ */
+struct pedal_noise_stats {
+  uint32_t noise_milli;   /* Noise at rest (1 sigma), 1/1000 output LSB */
+  uint16_t hyst_rest;     /* Dead band while resting, output LSBs */
+  uint16_t hyst;          /* Dead band in use, output LSBs */
+  bool moving;            /* Minimum dead band in use */
+  uint32_t rest_ms;       /* Time at rest */
+  uint32_t rest_events;   /* Output changes at rest */
+  uint32_t motion_events; /* Output changes while moving */
+  uint32_t motion_levels; /* Full scale / mean output step while moving */
+};
+
+/**
+ * @brief Boot phase completion times
+ *
+ * Microseconds since boot, 0 while the phase has not completed yet.
+ */
+struct boot_stats {
+  uint32_t usb_ready_us;   /* Host configured the USB MIDI interface */
+  uint32_t ble_us;         /* BLE MIDI transport up */
+  uint32_t adc_settled_us; /* Pedal readings stopped drifting */
+  uint32_t first_event_us; /* First MIDI event published */
+};
+
+/**
+ * @brief Negotiated BLE link parameters
+ *
+ * Turnaround runs from the oldest message of a BLE MIDI packet being queued
+ * to its notification completing.
+ */
+struct ble_link_stats {
+  bool connected;
+  uint32_t interval_us;       /* Connection interval */
+  uint16_t latency;           /* Peripheral latency, intervals */
+  uint8_t tx_phy;             /* BT_GAP_LE_PHY_* */
+  uint8_t rx_phy;             /* BT_GAP_LE_PHY_* */
+  uint16_t mtu;               /* ATT MTU */
+  uint16_t tx_octets;         /* LL data length */
+  uint32_t rejects;           /* Our interval requests refused or ignored */
+  uint32_t turnaround_avg_us; /* Running mean */
+  uint32_t turnaround_max_us;
+};
+
+/**
+ * @brief DIN MIDI wire usage
+ *
+ * busy_us is the wire time of the bytes written (320 us per byte at 31250
+ * baud); its growth over elapsed time is the link utilization.
+ */
+struct din_link_stats {
+  uint32_t bytes;   /* Bytes written */
+  uint32_t busy_us; /* Wire time of those bytes */
+};
+
+/**
+ * @brief Latency percentiles of one pipeline probe
+ *
+ * Microseconds since the scan was captured. Percentiles are the upper edge
+ * of the histogram bin that holds them (bins are at most 25% wide).
+ */
+struct latency_stats {
+  uint32_t count; /* Samples recorded */
+  uint32_t p50_us;
+  uint32_t p90_us;
+  uint32_t p99_us;
+  uint32_t max_us;
+};
+
+/**
+ * @brief Cycle cost of one profiled stage
+ *
+ * Cycles of the profiler clock (CPU cycles with the DWT counter, else
+ * kernel clock cycles).
+ */
+struct profiler_stage_stats {
+  uint32_t count; /* Runs accounted */
+  uint32_t min_cycles;
+  uint32_t mean_cycles;
+  uint32_t max_cycles;
+};
+
+/**
+ * @brief CPU load and sampling deadline statistics
+ *
+ * A deadline miss is a reader wakeup whose acquisition and processing took
+ * longer than its block period.
+ */
+struct profiler_stats {
+  uint32_t cycles_per_sec;      /* Profiler clock rate */
+  uint32_t cpu_load_permille;   /* Non-idle share over the last second */
+  uint32_t blocks;              /* Reader wakeups accounted */
+  uint32_t deadline_misses;     /* Wakeups over their period */
+  uint32_t budget_max_permille; /* Worst wakeup, share of its period */
 };
 
 /**
  * @brief Global MIDAL statistics
  */
 struct midal_stats {
-  uint32_t total_events;      /* Total MIDI events published to zbus */
-  struct transport_stats usb; /* USB MIDI transport stats */
-  struct transport_stats ble; /* BLE MIDI transport stats */
+  uint32_t total_events;        /* Total MIDI events published to zbus */
+  struct transport_stats usb;   /* USB MIDI transport stats */
+  struct transport_stats ble;   /* BLE MIDI transport stats */
+  struct ble_link_stats ble_link; /* Negotiated BLE link parameters */
+  struct transport_stats din;   /* DIN MIDI transport stats */
+  struct din_link_stats din_link; /* DIN MIDI wire usage */
+  struct pedal_rate_stats rate; /* Pedal sampling scheduler stats */
+  struct sample_clock_stats clock; /* Pedal sampling clock stats */
+  struct pedal_filter_stats filter; /* Pedal filter kernel cost */
+  struct boot_stats boot; /* Boot phase timestamps */
+  struct pedal_noise_stats noise[MIDAL_NUM_PEDALS]; /* Per pedal dead band */
 };
 
 /**
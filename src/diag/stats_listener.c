@@ -19,24 +19,25 @@ static atomic_t total_midi_events = ATOMIC_INIT(0);
 /**
  * @brief Stats listener callback - counts MIDI events
  *
- * This is a synchronous listener that simply increments a counter.
- * It's very fast (just an atomic increment) and doesn't block.
+ * This is a synchronous listener that adds the number of changed pedals in
+ * the published frame to a counter. It's very fast (one atomic add) and
+ * doesn't block.
  */
 static void stats_listener_callback(const struct zbus_channel *chan) {
-  ARG_UNUSED(chan);
+  const pedal_frame_t *frame = zbus_chan_const_msg(chan);
 
-  /* Just count - no processing */
-  atomic_inc(&total_midi_events);
+  /* One MIDI event per changed pedal - no processing */
+  atomic_add(&total_midi_events, __builtin_popcount(frame->changed));
 }
 
 /* Define the zbus listener */
 ZBUS_LISTENER_DEFINE(stats_listener, stats_listener_callback);
 
 int stats_listener_init(void) {
-  /* Add stats listener to MIDI event channel */
-  int ret = zbus_chan_add_obs(&midi_event_chan, &stats_listener, K_MSEC(100));
+  /* Add stats listener to pedal frame channel */
+  int ret = zbus_chan_add_obs(&pedal_frame_chan, &stats_listener, K_MSEC(100));
   if (ret != 0) {
-    LOG_ERR("Failed to add stats listener to midi_event_chan: %d", ret);
+    LOG_ERR("Failed to add stats listener to pedal_frame_chan: %d", ret);
     return ret;
   }
 
@@ -7,14 +7,14 @@
  * @brief MIDI event statistics listener
  *
  * This module implements a zbus listener that counts all MIDI events
- * published to the midi_event_chan. It provides a global view of
- * system activity.
+ * published on pedal_frame_chan (one per changed pedal in each frame).
+ * It provides a global view of system activity.
  */
 
 /**
  * @brief Initialize the stats listener
  *
- * Subscribes the stats listener to the MIDI event channel.
+ * Subscribes the stats listener to the pedal frame channel.
  *
  * @return 0 on success, negative error code on failure
  */
@@ -0,0 +1,279 @@
+#include "telemetry.h"
+#include "diag/heartbeat.h"
+#include "diag/latency.h"
+#include "diag/profiler.h"
+#include "diag/stats.h"
+#include "transports/transport_ble_midi.h"
+#include "transports/transport_usb_midi.h"
+#include "zbus_channels.h"
+
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+LOG_MODULE_REGISTER(telemetry, LOG_LEVEL_INF);
+
+BUILD_ASSERT(DT_HAS_CHOSEN(midal_telemetry_uart),
+             "CONFIG_MIDAL_TELEMETRY needs a UART chosen as "
+             "midal,telemetry-uart (boards/telemetry.overlay on the Pro "
+             "Micro)");
+
+#define TLM_PERIOD_MS (1000U / CONFIG_MIDAL_TELEMETRY_RATE_HZ)
+#define TLM_CRC_SEED 0xFFFFU
+
+/* Largest record, its CRC, COBS overhead and the delimiter */
+#define TLM_REC_MAX                                                            \
+  MAX(sizeof(struct telemetry_stats),                                          \
+      sizeof(struct telemetry_latency) +                                       \
+          (LATENCY_PROBE_COUNT * sizeof(struct telemetry_latency_probe)))
+#define TLM_FRAME_MAX ((TLM_REC_MAX + 2U) + ((TLM_REC_MAX + 2U) / 254U) + 2U)
+
+static const struct device *const s_uart =
+    DEVICE_DT_GET(DT_CHOSEN(midal_telemetry_uart));
+
+RING_BUF_DECLARE(s_tx_ring, CONFIG_MIDAL_TELEMETRY_TX_BUF_SIZE);
+
+static uint16_t s_seq;
+static atomic_t s_dropped;
+
+/* Latest pedal frame, copied by the bus listener (sequence lock) */
+static pedal_frame_t s_frame;
+static atomic_t s_frame_seq;
+
+static void tlm_frame_listener(const struct zbus_channel *chan) {
+  const pedal_frame_t *frame = zbus_chan_const_msg(chan);
+
+  /* Odd while the copy is in progress */
+  atomic_inc(&s_frame_seq);
+  s_frame = *frame;
+  atomic_inc(&s_frame_seq);
+}
+
+ZBUS_LISTENER_DEFINE(telemetry_listener, tlm_frame_listener);
+
+static bool tlm_read_frame(pedal_frame_t *out) {
+  for (int tries = 0; tries < 4; tries++) {
+    atomic_val_t seq = atomic_get(&s_frame_seq);
+    if ((seq & 1) != 0) {
+      continue;
+    }
+    *out = s_frame;
+    if (atomic_get(&s_frame_seq) == seq) {
+      return seq != 0;
+    }
+  }
+  return false;
+}
+
+static void tlm_uart_isr(const struct device *dev, void *user_data) {
+  ARG_UNUSED(user_data);
+
+  while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+    if (!uart_irq_tx_ready(dev)) {
+      continue;
+    }
+
+    uint8_t *data;
+    uint32_t len = ring_buf_get_claim(&s_tx_ring, &data, UINT32_MAX);
+    if (len == 0U) {
+      uart_irq_tx_disable(dev);
+      break;
+    }
+
+    int sent = uart_fifo_fill(dev, data, (int)len);
+    ring_buf_get_finish(&s_tx_ring, (uint32_t)MAX(sent, 0));
+  }
+}
+
+/* Host side has the port open (always true where DTR is not reported) */
+static bool tlm_port_open(void) {
+#if IS_ENABLED(CONFIG_UART_LINE_CTRL)
+  uint32_t dtr = 0U;
+
+  if (uart_line_ctrl_get(s_uart, UART_LINE_CTRL_DTR, &dtr) == 0) {
+    return dtr != 0U;
+  }
+#endif
+  return true;
+}
+
+/* COBS-encode rec followed by its CRC, then the 0x00 delimiter */
+static size_t tlm_frame(const uint8_t *rec, size_t len, uint8_t *out) {
+  const uint16_t crc = crc16_ccitt(TLM_CRC_SEED, rec, len);
+  const uint8_t tail[2] = {(uint8_t)(crc & 0xFFU), (uint8_t)(crc >> 8)};
+  size_t code_at = 0U;
+  size_t n = 1U;
+  uint8_t code = 1U;
+
+  for (size_t i = 0; i < len + sizeof(tail); i++) {
+    const uint8_t b = (i < len) ? rec[i] : tail[i - len];
+
+    if (b != 0U) {
+      out[n++] = b;
+      code++;
+    }
+    if (b == 0U || code == 0xFFU) {
+      out[code_at] = code;
+      code_at = n++;
+      code = 1U;
+    }
+  }
+  out[code_at] = code;
+  out[n++] = 0U;
+  return n;
+}
+
+/* Queue one record whole, or count it as dropped */
+static void tlm_send(void *rec, size_t len, telemetry_rec_t type) {
+  static uint8_t frame[TLM_FRAME_MAX];
+  struct telemetry_hdr *hdr = rec;
+
+  hdr->type = (uint8_t)type;
+  hdr->version = TELEMETRY_VERSION;
+  hdr->seq = s_seq++;
+  hdr->t_ms = k_uptime_get_32();
+
+  size_t n = tlm_frame(rec, len, frame);
+  if (ring_buf_space_get(&s_tx_ring) < n) {
+    atomic_inc(&s_dropped);
+    return;
+  }
+
+  (void)ring_buf_put(&s_tx_ring, frame, n);
+  uart_irq_tx_enable(s_uart);
+}
+
+static void tlm_send_pedals(void) {
+  struct telemetry_pedals rec = {.count = MIDAL_NUM_PEDALS};
+  pedal_frame_t frame;
+
+  if (!tlm_read_frame(&frame)) {
+    return; /* Nothing published yet, or the sampler kept writing */
+  }
+
+  rec.changed = frame.changed;
+  rec.timestamp_us = frame.timestamp_us;
+  memcpy(rec.values, frame.values, sizeof(rec.values));
+  tlm_send(&rec, sizeof(rec), TELEMETRY_REC_PEDALS);
+}
+
+/* The record is packed: copy instead of writing through member pointers */
+static void tlm_counters(void *out, const struct transport_stats *tx) {
+  const uint32_t c[4] = {tx->sent, tx->coalesced, tx->aged, tx->dropped};
+
+  memcpy(out, c, sizeof(c));
+}
+
+static void tlm_send_stats(void) {
+  struct telemetry_stats rec = {0};
+  struct midal_stats stats;
+
+  midal_get_stats(&stats);
+
+  if (transport_usb_ready()) {
+    rec.flags |= TELEMETRY_FLAG_USB_READY;
+  }
+  if (IS_ENABLED(CONFIG_MIDAL_BLE_TRANSPORT) && transport_ble_midi_ready()) {
+    rec.flags |= TELEMETRY_FLAG_BLE_READY;
+  }
+  if (stats.rate.idle) {
+    rec.flags |= TELEMETRY_FLAG_IDLE_RATE;
+  }
+
+  rec.events = stats.total_events;
+  tlm_counters(rec.usb, &stats.usb);
+  tlm_counters(rec.ble, &stats.ble);
+  tlm_counters(rec.din, &stats.din);
+  rec.clock_ticks = stats.clock.ticks;
+  rec.clock_overruns = stats.clock.overruns;
+  rec.jitter_min_ns = stats.clock.jitter_min_ns;
+  rec.jitter_max_ns = stats.clock.jitter_max_ns;
+  rec.filter_cycles_avg = stats.filter.cycles_avg;
+  rec.filter_cycles_max = stats.filter.cycles_max;
+
+#if IS_ENABLED(CONFIG_MIDAL_PROFILER)
+  struct profiler_stats ps;
+
+  profiler_get_stats(&ps);
+  rec.cpu_load_permille = ps.cpu_load_permille;
+  rec.deadline_misses = ps.deadline_misses;
+#endif
+
+  rec.telemetry_dropped = (uint32_t)atomic_get(&s_dropped);
+  tlm_send(&rec, sizeof(rec), TELEMETRY_REC_STATS);
+}
+
+#if IS_ENABLED(CONFIG_MIDAL_LATENCY)
+static void tlm_send_latency(void) {
+  static uint8_t buf[sizeof(struct telemetry_latency) +
+                     (LATENCY_PROBE_COUNT *
+                      sizeof(struct telemetry_latency_probe))];
+  struct telemetry_latency *rec = (struct telemetry_latency *)buf;
+
+  memset(buf, 0, sizeof(buf));
+  rec->count = LATENCY_PROBE_COUNT;
+  for (size_t p = 0; p < LATENCY_PROBE_COUNT; p++) {
+    struct latency_stats st;
+
+    latency_get_stats((latency_probe_t)p, &st);
+    rec->probes[p].p50_us = st.p50_us;
+    rec->probes[p].p99_us = st.p99_us;
+    rec->probes[p].max_us = st.max_us;
+  }
+  tlm_send(rec, sizeof(buf), TELEMETRY_REC_LATENCY);
+}
+#endif
+
+static void tlm_work_handler(struct k_work *work) {
+  ARG_UNUSED(work);
+
+  if (!tlm_port_open()) {
+    return;
+  }
+
+  tlm_send_pedals();
+  tlm_send_stats();
+#if IS_ENABLED(CONFIG_MIDAL_LATENCY)
+  tlm_send_latency();
+#endif
+}
+
+static K_WORK_DEFINE(s_tlm_work, tlm_work_handler);
+
+static void tlm_timer_cb(struct k_timer *timer) {
+  ARG_UNUSED(timer);
+  (void)k_work_submit_to_queue(heartbeat_work_queue(), &s_tlm_work);
+}
+
+static K_TIMER_DEFINE(s_tlm_timer, tlm_timer_cb, NULL);
+
+int telemetry_start(void) {
+  if (!device_is_ready(s_uart)) {
+    LOG_ERR("Telemetry UART %s not ready", s_uart->name);
+    return -ENODEV;
+  }
+
+  int ret = uart_irq_callback_user_data_set(s_uart, tlm_uart_isr, NULL);
+  if (ret != 0) {
+    LOG_ERR("Telemetry UART has no interrupt-driven API: %d", ret);
+    return ret;
+  }
+
+  ret = zbus_chan_add_obs(&pedal_frame_chan, &telemetry_listener, K_MSEC(100));
+  if (ret != 0) {
+    LOG_ERR("Failed to add telemetry listener to pedal_frame_chan: %d", ret);
+    return ret;
+  }
+
+  k_timer_start(&s_tlm_timer, K_MSEC(TLM_PERIOD_MS), K_MSEC(TLM_PERIOD_MS));
+  LOG_INF("Telemetry on %s every %u ms", s_uart->name, TLM_PERIOD_MS);
+  return 0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "midal_conf.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+
+/**
+ * @file telemetry.h
+ * @brief Binary telemetry stream
+ *
+ * Fixed-layout records streamed at CONFIG_MIDAL_TELEMETRY_RATE_HZ on the
+ * UART chosen as "midal,telemetry-uart" (a second CDC-ACM port on the
+ * board). Gathering and framing run on the heartbeat work queue; the UART
+ * is fed from its TX interrupt.
+ *
+ * Framing: each record is followed by its CRC-16/CCITT (Zephyr's
+ * crc16_ccitt(), seed 0xFFFF, little-endian), COBS-encoded and terminated
+ * by a 0x00 byte, so a decoder resynchronizes at the next zero. All fields
+ * are little-endian. tools/midal_telemetry.py decodes the stream.
+ *
+ * Keep the layouts below and the decoder in sync; bump TELEMETRY_VERSION
+ * on any change.
+ */
+
+#define TELEMETRY_VERSION 1U
+
+typedef enum {
+  TELEMETRY_REC_PEDALS = 1,  /* struct telemetry_pedals */
+  TELEMETRY_REC_STATS = 2,   /* struct telemetry_stats */
+  TELEMETRY_REC_LATENCY = 3, /* struct telemetry_latency */
+} telemetry_rec_t;
+
+struct telemetry_hdr {
+  uint8_t type;    /* telemetry_rec_t */
+  uint8_t version; /* TELEMETRY_VERSION */
+  uint16_t seq;    /* Per stream, gaps are lost records */
+  uint32_t t_ms;   /* Uptime when gathered */
+} __packed;
+
+/* Latest published pedal frame */
+struct telemetry_pedals {
+  struct telemetry_hdr hdr;
+  uint8_t count;   /* MIDAL_NUM_PEDALS */
+  uint8_t changed; /* Change mask of that frame */
+  uint32_t timestamp_us;
+  uint16_t values[MIDAL_NUM_PEDALS];
+} __packed;
+
+#define TELEMETRY_FLAG_USB_READY BIT(0)
+#define TELEMETRY_FLAG_BLE_READY BIT(1)
+#define TELEMETRY_FLAG_IDLE_RATE BIT(2)
+
+/* Counters, as in the text heartbeat */
+struct telemetry_stats {
+  struct telemetry_hdr hdr;
+  uint32_t flags; /* TELEMETRY_FLAG_* */
+  uint32_t events;
+  uint32_t usb[4]; /* sent, coalesced, aged, dropped */
+  uint32_t ble[4];
+  uint32_t din[4];
+  uint32_t clock_ticks;
+  uint32_t clock_overruns;
+  int32_t jitter_min_ns;
+  int32_t jitter_max_ns;
+  uint32_t filter_cycles_avg;
+  uint32_t filter_cycles_max;
+  uint32_t cpu_load_permille; /* 0 without CONFIG_MIDAL_PROFILER */
+  uint32_t deadline_misses;   /* 0 without CONFIG_MIDAL_PROFILER */
+  uint32_t telemetry_dropped; /* Records that found the TX ring full */
+} __packed;
+
+struct telemetry_latency_probe {
+  uint32_t p50_us;
+  uint32_t p99_us;
+  uint32_t max_us;
+} __packed;
+
+/* Every latency probe, in latency_probe_t order */
+struct telemetry_latency {
+  struct telemetry_hdr hdr;
+  uint8_t count; /* Probes that follow */
+  uint8_t reserved[3];
+  struct telemetry_latency_probe probes[];
+} __packed;
+
+/* Start streaming; call after heartbeat_start() */
+int telemetry_start(void);
@@ -1,7 +1,7 @@
+#include "boot.h"
 #include "diag/heartbeat.h"
 #include "diag/stats.h"
 #include "pedal/pedal.h"
-#include "transports/transport_ble_midi.h"
 #include "transports/transport_usb_midi.h"
 #include "usbd/midi.h"
 #include "usbd/usbd.h"
@@ -18,6 +18,30 @@ LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 #include "diag/saadc_selftest.h"
 #endif
 
+#if IS_ENABLED(CONFIG_MIDAL_DIN_MIDI)
+#include "transports/transport_din_midi.h"
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_FILTER_BENCH)
+#include "diag/filter_bench.h"
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_BUS_BENCH)
+#include "diag/bus_bench.h"
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_CODEC_BENCH)
+#include "diag/codec_bench.h"
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_PROFILER)
+#include "diag/profiler.h"
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_TELEMETRY)
+#include "diag/telemetry.h"
+#endif
+
 // For testing
 #include <zephyr/drivers/gpio.h>
 /* The devicetree node identifier for the "led0" alias. */
@@ -43,6 +67,7 @@ int main(void) {
 #if IS_ENABLED(CONFIG_MIDAL_ACQ_SELFTEST)
   saadc_selftest_run();
 #else
+  boot_mark(BOOT_PHASE_USB);
 
   ret = usbd_midi_init();
 
@@ -58,6 +83,16 @@ int main(void) {
     return -ENODEV;
   }
 
+  /*
+   * BLE bring-up (blocking bt_enable) runs on the boot work queue, in
+   * parallel with USB enumeration and the ADC settling below
+   */
+  ret = boot_start_background();
+  if (ret != 0) {
+    LOG_ERR("Boot work queue start failed: %d", ret);
+    return ret;
+  }
+
   /* Initialize USB MIDI transport - subscribes to zbus directly */
   ret = transport_usb_midi_init();
   if (ret != 0) {
@@ -65,21 +100,44 @@ int main(void) {
     return -ENODEV;
   }
 
-#if IS_ENABLED(CONFIG_BLE_MIDI)
-  /* Initialize BLE MIDI transport - subscribes to zbus directly */
-  ret = transport_ble_midi_init();
+#if IS_ENABLED(CONFIG_MIDAL_DIN_MIDI)
+  ret = transport_din_midi_init();
   if (ret != 0) {
-    LOG_WRN("BLE MIDI transport init failed: %d", ret);
+    LOG_WRN("DIN MIDI transport init failed: %d", ret);
   }
 #endif
 
+#if IS_ENABLED(CONFIG_MIDAL_PROFILER)
+  profiler_init();
+#endif
+
   heartbeat_start();
 
+#if IS_ENABLED(CONFIG_MIDAL_TELEMETRY)
+  ret = telemetry_start();
+  if (ret != 0) {
+    LOG_WRN("Telemetry start failed: %d", ret);
+  }
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_FILTER_BENCH)
+  filter_bench_run();
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_BUS_BENCH)
+  bus_bench_run();
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_CODEC_BENCH)
+  codec_bench_run();
+#endif
+
   ret = pedal_reader_start();
   if (ret != 0) {
     LOG_ERR("Failed to initialize pedal subsystem: %d", ret);
     return ret;
   }
+  boot_mark(BOOT_PHASE_PEDALS);
 
 #endif
 
@@ -4,6 +4,11 @@
 
 #define MIDAL_NUM_PEDALS 3
 
+/* Pedal indices (order of pedal_configs[] in pedal_sampler.c) */
+#define MIDAL_PEDAL_SUSTAIN 0
+#define MIDAL_PEDAL_SOSTENUTO 1
+#define MIDAL_PEDAL_SOFT 2
+
 #define MIDAL_CH_PEDAL_SUSTAIN 0
 #define MIDAL_CH_PEDAL_SOSTENUTO 0
 #define MIDAL_CH_PEDAL_SOFT 0
@@ -11,4 +16,9 @@
 /* MIDI CC номера по умолчанию */
 #define MIDAL_CC_SUSTAIN 64
 #define MIDAL_CC_SOSTENUTO 66
-#define MIDAL_CC_SOFT 67
\ No newline at end of file
+#define MIDAL_CC_SOFT 67
+
+/* Transport send order under congestion (0 = first): damper ahead */
+#define MIDAL_PRIO_PEDAL_SUSTAIN 0
+#define MIDAL_PRIO_PEDAL_SOSTENUTO 1
+#define MIDAL_PRIO_PEDAL_SOFT 1
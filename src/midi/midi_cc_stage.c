@@ -0,0 +1,196 @@
+#include "midi_cc_stage.h"
+
+#include <stdlib.h>
+#include <zephyr/sys/util.h>
+
+/* Rank of a stale update: after every fresh one */
+#define STAGE_RANK_STALE UINT32_MAX
+
+void midi_cc_stage_init(midi_cc_stage_t *st, uint32_t max_age_us) {
+  for (size_t i = 0; i < MIDI_CC_STAGE_SLOTS; i++) {
+    st->slots[i].used = false;
+    st->slots[i].pending = false;
+    st->slots[i].delivered = false;
+  }
+  st->by_delta = false;
+  st->value_shift = 0U;
+  st->max_age_us = max_age_us;
+  st->next = 0U;
+  st->cur = 0U;
+  st->pending = 0U;
+  atomic_clear(&st->coalesced);
+  atomic_clear(&st->aged);
+  atomic_clear(&st->lost);
+}
+
+void midi_cc_stage_order_by_delta(midi_cc_stage_t *st, uint8_t value_shift) {
+  st->by_delta = true;
+  st->value_shift = value_shift;
+}
+
+static midi_cc_slot_t *stage_slot(midi_cc_stage_t *st, uint8_t ch,
+                                  uint8_t cc) {
+  midi_cc_slot_t *free_slot = NULL;
+
+  for (size_t i = 0; i < MIDI_CC_STAGE_SLOTS; i++) {
+    midi_cc_slot_t *s = &st->slots[i];
+
+    if (!s->used) {
+      free_slot = (free_slot == NULL) ? s : free_slot;
+    } else if (s->ev.cc.ch == ch && s->ev.cc.cc == cc) {
+      return s;
+    }
+  }
+
+  if (free_slot != NULL) {
+    free_slot->used = true;
+    free_slot->pending = false;
+    free_slot->delivered = false;
+  }
+  return free_slot;
+}
+
+static void stage_put(midi_cc_stage_t *st, const midi_event_t *ev,
+                      uint8_t prio) {
+  if (ev->type != MIDI_EV_CC) {
+    return;
+  }
+
+  midi_cc_slot_t *s = stage_slot(st, ev->cc.ch & 0x0F, ev->cc.cc & 0x7F);
+  if (s == NULL) {
+    atomic_inc(&st->lost);
+    return;
+  }
+
+  if (s->pending) {
+    atomic_inc(&st->coalesced);
+  } else {
+    s->pending = true;
+    st->pending++;
+  }
+  s->ev = *ev;
+  s->ev.cc.ch &= 0x0F;
+  s->ev.cc.cc &= 0x7F;
+  s->prio = prio;
+
+  if (st->value_shift != 0U) {
+    uint32_t v = ((uint32_t)ev->cc.value + BIT(st->value_shift - 1U)) >>
+                 st->value_shift;
+    s->ev.cc.value = (uint16_t)MIN(v, 0x3FFFU >> st->value_shift);
+  }
+}
+
+void midi_cc_stage_put(midi_cc_stage_t *st, const midi_event_t *ev) {
+  stage_put(st, ev, MIDI_CC_STAGE_PRIO_DEFAULT);
+}
+
+void midi_cc_stage_put_frame(midi_cc_stage_t *st, const pedal_frame_t *frame) {
+  uint8_t changed = frame->changed;
+
+  while (changed != 0U) {
+    size_t i = (size_t)__builtin_ctz(changed);
+    midi_event_t ev;
+
+    changed &= (uint8_t)(changed - 1U);
+    pedal_frame_event(frame, i, &ev);
+    stage_put(st, &ev, pedal_frame_priority(i));
+  }
+}
+
+/* Change against the delivered value; never delivered counts as largest */
+static uint32_t slot_delta(const midi_cc_slot_t *s) {
+  if (!s->delivered) {
+    return UINT16_MAX;
+  }
+  return (uint32_t)abs((int32_t)s->ev.cc.value - (int32_t)s->sent_value);
+}
+
+static void slot_unpend(midi_cc_stage_t *st, midi_cc_slot_t *s) {
+  if (s->pending) {
+    s->pending = false;
+    st->pending--;
+  }
+}
+
+const midi_event_t *midi_cc_stage_next(midi_cc_stage_t *st, uint32_t now_us) {
+  size_t best = MIDI_CC_STAGE_SLOTS;
+  uint32_t best_rank = 0U;
+
+  if (st->pending == 0U) {
+    return NULL;
+  }
+
+  /* Scanning from the round-robin position keeps equal ranks fair */
+  for (size_t n = 0; n < MIDI_CC_STAGE_SLOTS; n++) {
+    size_t i = (st->next + n) % MIDI_CC_STAGE_SLOTS;
+    midi_cc_slot_t *s = &st->slots[i];
+
+    if (!s->pending) {
+      continue;
+    }
+
+    /* Lower ranks go first */
+    uint32_t rank = s->prio;
+    if (st->by_delta) {
+      uint32_t delta = slot_delta(s);
+      if (delta == 0U) {
+        /* Moved and came back before it could be sent */
+        slot_unpend(st, s);
+        atomic_inc(&st->coalesced);
+        continue;
+      }
+      /* Priority class first, the largest change within it */
+      rank = ((uint32_t)s->prio << 16) | (UINT16_MAX - delta);
+    }
+    if (st->max_age_us != 0U &&
+        (now_us - s->ev.timestamp_us) > st->max_age_us) {
+      if (s->delivered && s->sent_value == s->ev.cc.value) {
+        /* Receiver already has this value: the excursion is history */
+        slot_unpend(st, s);
+        atomic_inc(&st->aged);
+        continue;
+      }
+      rank = STAGE_RANK_STALE;
+    }
+
+    if (best == MIDI_CC_STAGE_SLOTS || rank < best_rank) {
+      best = i;
+      best_rank = rank;
+    }
+  }
+
+  if (best == MIDI_CC_STAGE_SLOTS) {
+    return NULL;
+  }
+  st->cur = best;
+  return &st->slots[best].ev;
+}
+
+static void stage_clear_cur(midi_cc_stage_t *st) {
+  slot_unpend(st, &st->slots[st->cur]);
+  st->next = (st->cur + 1U) % MIDI_CC_STAGE_SLOTS;
+}
+
+void midi_cc_stage_sent(midi_cc_stage_t *st) {
+  midi_cc_slot_t *s = &st->slots[st->cur];
+
+  s->sent_value = s->ev.cc.value;
+  s->delivered = true;
+  stage_clear_cur(st);
+}
+
+void midi_cc_stage_drop(midi_cc_stage_t *st) {
+  stage_clear_cur(st);
+  atomic_inc(&st->lost);
+}
+
+void midi_cc_stage_undeliver(midi_cc_stage_t *st) {
+  midi_cc_slot_t *s = &st->slots[st->cur];
+
+  /* A newer value may already be pending; either way it goes out again */
+  s->delivered = false;
+  if (!s->pending) {
+    s->pending = true;
+    st->pending++;
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "midal_conf.h"
+#include "midi_types.h"
+#include "pedal/pedal_frame.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+/*
+ * Latest-value-wins staging of CC updates for one transport. Every
+ * (channel, controller) pair owns one slot: a new value replaces a pending
+ * one, so a link under backpressure only ever sends current state and the
+ * last value it delivers is the newest one published.
+ *
+ * Under backpressure the stage sends in priority order (lowest number first,
+ * round-robin among equals). Links that can only carry a fraction of the
+ * updates break ties within a priority by the largest change since the last
+ * delivered value instead. A staged
+ * value older than the age budget is never sent as a live update: if the
+ * receiver already has that value it is shed, otherwise it still carries the
+ * controller's current state and goes out as a refresh after all fresh
+ * updates.
+ *
+ * Owned by the transport thread (no locking); the counters may be read from
+ * anywhere.
+ */
+
+/* One slot per pedal controller */
+#define MIDI_CC_STAGE_SLOTS MIDAL_NUM_PEDALS
+
+/* Priority of updates staged with midi_cc_stage_put() */
+#define MIDI_CC_STAGE_PRIO_DEFAULT 0xFEU
+
+typedef struct {
+  midi_event_t ev;
+  uint16_t sent_value; /* Last value delivered for this controller */
+  uint8_t prio;
+  bool used;
+  bool pending;
+  bool delivered; /* sent_value is valid */
+} midi_cc_slot_t;
+
+typedef struct {
+  midi_cc_slot_t slots[MIDI_CC_STAGE_SLOTS];
+  bool by_delta;       /* Largest change first instead of priority */
+  uint8_t value_shift; /* Staged values are reduced by this many bits */
+  uint32_t max_age_us; /* Age budget, 0 = unlimited */
+  size_t next;         /* Round-robin drain position */
+  size_t cur;          /* Slot returned by midi_cc_stage_next() */
+  size_t pending;
+  atomic_t coalesced; /* Updates replaced by a newer value before sending */
+  atomic_t aged;      /* Updates shed for exceeding the age budget */
+  atomic_t lost;      /* Updates that never went out (send error, no slot) */
+} midi_cc_stage_t;
+
+void midi_cc_stage_init(midi_cc_stage_t *st, uint32_t max_age_us);
+
+/*
+ * Within a priority, drain the largest change since the last delivered
+ * value first, on values reduced (rounded) by value_shift bits as they are
+ * staged. An update equal to the delivered value is not sent again (counted
+ * as coalesced).
+ */
+void midi_cc_stage_order_by_delta(midi_cc_stage_t *st, uint8_t value_shift);
+
+/* Stage ev; a value still pending for the same controller is replaced */
+void midi_cc_stage_put(midi_cc_stage_t *st, const midi_event_t *ev);
+
+/* Stage the update of every pedal flagged as changed in frame */
+void midi_cc_stage_put_frame(midi_cc_stage_t *st, const pedal_frame_t *frame);
+
+static inline bool midi_cc_stage_pending(const midi_cc_stage_t *st) {
+  return st->pending > 0U;
+}
+
+/*
+ * Next update to send at now_us (same clock as midi_event_t.timestamp_us),
+ * or NULL. Stays staged until midi_cc_stage_sent() or midi_cc_stage_drop();
+ * on backpressure just leave it and retry later.
+ */
+const midi_event_t *midi_cc_stage_next(midi_cc_stage_t *st, uint32_t now_us);
+
+/* The update from midi_cc_stage_next() went out */
+void midi_cc_stage_sent(midi_cc_stage_t *st);
+
+/* The update from midi_cc_stage_next() failed for good; counted as lost */
+void midi_cc_stage_drop(midi_cc_stage_t *st);
+
+/*
+ * The update last passed to midi_cc_stage_sent() never reached the receiver
+ * (transfer aborted): stage the controller's value again so it is resent.
+ * Call before the next midi_cc_stage_next().
+ */
+void midi_cc_stage_undeliver(midi_cc_stage_t *st);
@@ -2,30 +2,189 @@
 #include "midi_codec.h"
 
 #include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
 
-/* Encodes an event into MIDI 1.0 bytes (7-bit or 14-bit CC). Returns length. */
-size_t midi_codec_encode_cc(uint8_t *out, size_t cap, const midi_event_t *ev,
-                            bool use14bit) {
-  if (cap < 3) {
-    return 0;
+#define MIDI_STATUS_CC 0xB0U
+#define MIDI_CC_LSB_OFFSET 32U
+/* UMP message types and the MIDI 1.0 / 2.0 Control Change opcode */
+#define UMP_MT_MIDI1_CV 0x2U
+#define UMP_MT_MIDI2_CV 0x4U
+#define UMP_OPCODE_CC 0xBU
+/* Data 64 message type and its SysEx7 packet positions */
+#define UMP_MT_DATA64 0x3U
+#define UMP_SYSEX7_COMPLETE 0x0U
+#define UMP_SYSEX7_START 0x1U
+#define UMP_SYSEX7_CONTINUE 0x2U
+#define UMP_SYSEX7_END 0x3U
+
+void midi_codec_init(midi_codec_t *c, uint8_t flags) {
+  c->flags = flags;
+  c->running_status = 0U;
+}
+
+static inline bool codec_14bit(const midi_codec_t *c) {
+  return (c->flags & MIDI_CODEC_14BIT) != 0U;
+}
+
+/* The event goes out as an MSB/LSB pair */
+static inline bool codec_pair(const midi_codec_t *c, const midi_event_t *ev) {
+  return (c->flags & (MIDI_CODEC_14BIT | MIDI_CODEC_LSB)) ==
+             (MIDI_CODEC_14BIT | MIDI_CODEC_LSB) &&
+         (ev->cc.cc & 0x7F) < MIDI_CC_LSB_OFFSET;
+}
+
+uint8_t midi_codec_value7(const midi_codec_t *c, uint16_t value) {
+  if (codec_14bit(c)) {
+    uint32_t v = ((uint32_t)MIN(value, 16383U) + 0x40U) >> 7;
+    return (uint8_t)MIN(v, 127U);
+  }
+  return (uint8_t)MIN(value, 127U);
+}
+
+uint16_t midi_codec_value14(const midi_codec_t *c, uint16_t value) {
+  if (codec_14bit(c)) {
+    return MIN(value, 16383U);
   }
+  return (uint16_t)(MIN(value, 127U) << 7);
+}
+
+uint16_t midi_codec_value16(const midi_codec_t *c, uint16_t value) {
+  const uint32_t max = codec_14bit(c) ? 16383U : 127U;
+  uint32_t v = MIN((uint32_t)value, max);
 
-  uint8_t status = 0xB0 | (ev->cc.ch & 0x0F);
+  /* Full range onto 0..65535 with rounding */
+  return (uint16_t)((v * 65535U + (max / 2U)) / max);
+}
 
-  out[0] = status;
-  out[1] = ev->cc.cc;
-  out[2] = (uint8_t)(ev->cc.value & 0x7F);
+/* Bytes of the event: its messages as [status] controller value */
+static size_t midi1_put(midi_codec_t *c, const midi_event_t *ev, uint8_t *out,
+                        size_t cap) {
+  const uint8_t status = MIDI_STATUS_CC | (ev->cc.ch & 0x0F);
+  const uint8_t controller = ev->cc.cc & 0x7F;
+  const bool pair = codec_pair(c, ev);
+  const bool rs = (c->flags & MIDI_CODEC_RUNNING_STATUS) != 0U;
+  const bool first_status = !rs || status != c->running_status;
+  size_t need = (first_status ? 3U : 2U) + (pair ? (rs ? 2U : 3U) : 0U);
+  size_t n = 0U;
 
-  size_t n = 3;
+  if (need > cap) {
+    return 0U;
+  }
 
-  if (use14bit) {
-    if (cap < 6) {
-      return n;
+  if (first_status) {
+    out[n++] = status;
+  }
+  out[n++] = controller;
+  if (pair) {
+    uint16_t v14 = midi_codec_value14(c, ev->cc.value);
+    out[n++] = (uint8_t)(v14 >> 7);
+    if (!rs) {
+      out[n++] = status;
     }
-    out[3] = status;
-    out[4] = (uint8_t)(ev->cc.cc + 32);
-    out[5] = (uint8_t)((ev->cc.value >> 7) & 0x7F);
-    n = 6;
+    out[n++] = (uint8_t)(controller + MIDI_CC_LSB_OFFSET);
+    out[n++] = (uint8_t)(v14 & 0x7F);
+  } else {
+    out[n++] = midi_codec_value7(c, ev->cc.value);
   }
+
+  if (rs) {
+    c->running_status = status;
+  }
+  return n;
+}
+
+size_t midi_codec_midi1(midi_codec_t *c, const midi_event_t *ev, uint8_t *out,
+                        size_t cap) {
+  if (ev->type != MIDI_EV_CC) {
+    return 0U;
+  }
+  return midi1_put(c, ev, out, cap);
+}
+
+static inline uint32_t ump_midi1_word(uint8_t group, uint8_t ch, uint8_t cc,
+                                      uint8_t value) {
+  return ((uint32_t)UMP_MT_MIDI1_CV << 28) | (((uint32_t)group & 0x0F) << 24) |
+         ((uint32_t)UMP_OPCODE_CC << 20) | (((uint32_t)ch & 0x0F) << 16) |
+         (((uint32_t)cc & 0x7F) << 8) | ((uint32_t)value & 0x7F);
+}
+
+size_t midi_codec_ump_midi1(const midi_codec_t *c, const midi_event_t *ev,
+                            uint8_t group, uint32_t *out, size_t cap) {
+  if (ev->type != MIDI_EV_CC) {
+    return 0U;
+  }
+
+  const uint8_t controller = ev->cc.cc & 0x7F;
+
+  if (codec_pair(c, ev)) {
+    if (cap < 2U) {
+      return 0U;
+    }
+    uint16_t v14 = midi_codec_value14(c, ev->cc.value);
+    out[0] = ump_midi1_word(group, ev->cc.ch, controller, (uint8_t)(v14 >> 7));
+    out[1] = ump_midi1_word(group, ev->cc.ch,
+                            (uint8_t)(controller + MIDI_CC_LSB_OFFSET),
+                            (uint8_t)(v14 & 0x7F));
+    return 2U;
+  }
+
+  if (cap < 1U) {
+    return 0U;
+  }
+  out[0] = ump_midi1_word(group, ev->cc.ch, controller,
+                          midi_codec_value7(c, ev->cc.value));
+  return 1U;
+}
+
+size_t midi_codec_ump_midi2(const midi_codec_t *c, const midi_event_t *ev,
+                            uint8_t group, uint32_t *out, size_t cap) {
+  if (ev->type != MIDI_EV_CC || cap < 2U) {
+    return 0U;
+  }
+
+  out[0] = ((uint32_t)UMP_MT_MIDI2_CV << 28) |
+           (((uint32_t)group & 0x0F) << 24) | ((uint32_t)UMP_OPCODE_CC << 20) |
+           (((uint32_t)ev->cc.ch & 0x0F) << 16) |
+           (((uint32_t)ev->cc.cc & 0x7F) << 8);
+  /* Data in the MSBs */
+  out[1] = (uint32_t)midi_codec_value16(c, ev->cc.value) << 16;
+  return 2U;
+}
+
+size_t midi_codec_ump_sysex7(uint8_t group, const uint8_t *data, size_t len,
+                             uint32_t *out, size_t cap) {
+  const size_t words = MIDI_CODEC_SYSEX7_WORDS(len);
+  size_t n = 0U;
+
+  if (words > cap) {
+    return 0U;
+  }
+
+  for (size_t off = 0; n < words; off += 6U) {
+    const size_t k = MIN(len - off, 6U);
+    uint8_t b[6] = {0};
+    uint32_t status;
+
+    if (words == 2U) {
+      status = UMP_SYSEX7_COMPLETE;
+    } else if (off == 0U) {
+      status = UMP_SYSEX7_START;
+    } else if (n + 2U == words) {
+      status = UMP_SYSEX7_END;
+    } else {
+      status = UMP_SYSEX7_CONTINUE;
+    }
+
+    for (size_t i = 0; i < k; i++) {
+      b[i] = data[off + i] & 0x7F;
+    }
+
+    out[n++] = ((uint32_t)UMP_MT_DATA64 << 28) |
+               (((uint32_t)group & 0x0F) << 24) | (status << 20) |
+               ((uint32_t)k << 16) | ((uint32_t)b[0] << 8) | b[1];
+    out[n++] = ((uint32_t)b[2] << 24) | ((uint32_t)b[3] << 16) |
+               ((uint32_t)b[4] << 8) | b[5];
+  }
+
   return n;
-}
\ No newline at end of file
+}
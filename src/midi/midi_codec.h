@@ -4,7 +4,68 @@
 #include "midi_types.h"
 
 #include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
 
-/* Encodes an event into MIDI 1.0 bytes (7-bit or 14-bit CC). Returns length. */
-size_t midi_codec_encode_cc(uint8_t *out, size_t cap, const midi_event_t *ev,
-                            bool use14bit);
+/*
+ * CC encoders for every output format: MIDI 1.0 bytes (DIN, and the whole
+ * messages handed to the BLE MIDI module, which frames and stamps its own
+ * packets), MIDI 1.0 Channel Voice UMPs and MIDI 2.0 UMPs. All of them write
+ * into caller buffers, never allocate, and encode an event whole or not at
+ * all, so a transport can stop at the first one that does not fit and retry
+ * it later.
+ *
+ * Value reduction is the same everywhere: a 7-bit output of a 14-bit value is
+ * rounded to nearest, an MSB/LSB pair splits it exactly, and MIDI 2.0 spans
+ * the event's full range onto 0..65535.
+ */
+
+/* Event values are 0..16383 (CONFIG_MIDAL_USE_14BIT_CC), else 0..127 */
+#define MIDI_CODEC_14BIT BIT(0)
+/* Controllers 0..31 go out as MSB/LSB pairs (with MIDI_CODEC_14BIT) */
+#define MIDI_CODEC_LSB BIT(1)
+/* Omit a status byte equal to the previous one (MIDI 1.0 byte stream) */
+#define MIDI_CODEC_RUNNING_STATUS BIT(2)
+
+/* Largest encoding of one CC event, per format */
+#define MIDI_CODEC_MIDI1_MAX 6 /* Bytes: two full messages */
+#define MIDI_CODEC_UMP_MAX 2   /* Words: MSB/LSB pair, or one MIDI 2.0 UMP */
+
+typedef struct {
+  uint8_t flags;
+  uint8_t running_status; /* Last status byte written, 0 = none */
+} midi_codec_t;
+
+void midi_codec_init(midi_codec_t *c, uint8_t flags);
+
+/* Make the next message carry its status byte (after a gap or an error) */
+static inline void midi_codec_reset_status(midi_codec_t *c) {
+  c->running_status = 0U;
+}
+
+/* Event value as a 7-bit, 14-bit or 16-bit CC value */
+uint8_t midi_codec_value7(const midi_codec_t *c, uint16_t value);
+uint16_t midi_codec_value14(const midi_codec_t *c, uint16_t value);
+uint16_t midi_codec_value16(const midi_codec_t *c, uint16_t value);
+
+/* MIDI 1.0 bytes of one event; 0 if it is not a CC or does not fit */
+size_t midi_codec_midi1(midi_codec_t *c, const midi_event_t *ev, uint8_t *out,
+                        size_t cap);
+
+/* MIDI 1.0 Channel Voice UMPs of one event; returns words written, or 0 */
+size_t midi_codec_ump_midi1(const midi_codec_t *c, const midi_event_t *ev,
+                            uint8_t group, uint32_t *out, size_t cap);
+
+/* MIDI 2.0 Channel Voice UMP of one event; returns words written, or 0 */
+size_t midi_codec_ump_midi2(const midi_codec_t *c, const midi_event_t *ev,
+                            uint8_t group, uint32_t *out, size_t cap);
+
+/* Words of the Data 64 UMPs carrying a System Exclusive body of len bytes */
+#define MIDI_CODEC_SYSEX7_WORDS(len) (2U * MAX(DIV_ROUND_UP((len), 6U), 1U))
+
+/*
+ * Data 64 (SysEx7) UMPs of one System Exclusive message. data is the body
+ * between F0 and F7, 7-bit bytes. Returns words written, or 0 if the whole
+ * message does not fit.
+ */
+size_t midi_codec_ump_sysex7(uint8_t group, const uint8_t *data, size_t len,
+                             uint32_t *out, size_t cap);
@@ -0,0 +1,211 @@
+#include "pedal_calstore.h"
+#include "diag/heartbeat.h"
+#include "pedal_sampler.h"
+
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(pedal_calstore, LOG_LEVEL_INF);
+
+#define CALSTORE_SUBTREE "midal/cal"
+#define CALSTORE_NAME "range"
+#define CALSTORE_KEY CALSTORE_SUBTREE "/" CALSTORE_NAME
+
+/* Bump when the record layout changes; older records are ignored */
+#define CALSTORE_VERSION 1U
+
+#define CALSTORE_MIN_DELTA                                                     \
+  ((int32_t)CONFIG_MIDAL_CAL_SAVE_MIN_DELTA_LSB << PEDAL_RAW_FRAC_BITS)
+#define CALSTORE_INTERVAL_MS (CONFIG_MIDAL_CAL_SAVE_INTERVAL_S * 1000U)
+
+typedef struct {
+  uint8_t version;
+  uint8_t frac_bits; /* PEDAL_RAW_FRAC_BITS the ranges are expressed in */
+  uint8_t pedals;
+  uint8_t valid;     /* Bit per pedal with a learned range */
+  uint16_t min_adc[MIDAL_NUM_PEDALS];
+  uint16_t max_adc[MIDAL_NUM_PEDALS];
+} calstore_record_t;
+
+/* Filled by the settings handler during pedal_calstore_load() */
+static calstore_record_t s_loaded;
+static bool s_have_loaded;
+
+/* Last record in flash, in current units (work queue only after load) */
+static calstore_record_t s_saved;
+static uint32_t s_saved_ms;
+static bool s_saved_once;
+
+static void calstore_save_work(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(s_save_work, calstore_save_work);
+
+static int calstore_set(const char *key, size_t len, settings_read_cb read_cb,
+                        void *cb_arg) {
+  const char *next;
+
+  if (!settings_name_steq(key, CALSTORE_NAME, &next) || next != NULL) {
+    return -ENOENT;
+  }
+  if (len != sizeof(s_loaded)) {
+    LOG_WRN("Saved calibration has size %u, expected %u", (unsigned)len,
+            (unsigned)sizeof(s_loaded));
+    return -EINVAL;
+  }
+
+  ssize_t rc = read_cb(cb_arg, &s_loaded, sizeof(s_loaded));
+  if (rc < 0) {
+    return (int)rc;
+  }
+
+  s_have_loaded = true;
+  return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(midal_cal, CALSTORE_SUBTREE, NULL, calstore_set,
+                               NULL, NULL);
+
+/* Ranges saved with another decimator setting, in current raw units */
+static uint16_t calstore_rescale(uint16_t v, uint8_t frac_bits) {
+  if (frac_bits > PEDAL_RAW_FRAC_BITS) {
+    return (uint16_t)(v >> (frac_bits - PEDAL_RAW_FRAC_BITS));
+  }
+  return (uint16_t)MIN((uint32_t)v << (PEDAL_RAW_FRAC_BITS - frac_bits),
+                       (uint32_t)PEDAL_RAW_MAX);
+}
+
+int pedal_calstore_load(pedal_calibration_t cal[MIDAL_NUM_PEDALS]) {
+  int err = settings_subsys_init();
+  if (err != 0) {
+    LOG_ERR("Settings init failed: %d", err);
+    return err;
+  }
+
+  s_have_loaded = false;
+  err = settings_load_subtree(CALSTORE_SUBTREE);
+  if (err != 0) {
+    LOG_ERR("Loading calibration failed: %d", err);
+    return err;
+  }
+
+  if (!s_have_loaded) {
+    LOG_INF("No saved calibration, learning from pedal motion");
+    return 0;
+  }
+  if (s_loaded.version != CALSTORE_VERSION ||
+      s_loaded.pedals != MIDAL_NUM_PEDALS) {
+    LOG_WRN("Ignoring saved calibration (version %u, %u pedals)",
+            s_loaded.version, s_loaded.pedals);
+    return 0;
+  }
+
+  s_saved = (calstore_record_t){
+      .version = CALSTORE_VERSION,
+      .frac_bits = PEDAL_RAW_FRAC_BITS,
+      .pedals = MIDAL_NUM_PEDALS,
+  };
+
+  int restored = 0;
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    uint16_t min = calstore_rescale(s_loaded.min_adc[i], s_loaded.frac_bits);
+    uint16_t max = calstore_rescale(s_loaded.max_adc[i], s_loaded.frac_bits);
+
+    if ((s_loaded.valid & BIT(i)) == 0U || min >= max) {
+      continue;
+    }
+
+    cal[i] = (pedal_calibration_t){
+        .min_adc = min,
+        .max_adc = max,
+        .initialized = true,
+    };
+    s_saved.min_adc[i] = min;
+    s_saved.max_adc[i] = max;
+    s_saved.valid |= BIT(i);
+    restored++;
+    LOG_INF("Pedal %u calibration restored: %u-%u", (unsigned)i, min, max);
+  }
+
+  s_saved_once = true;
+  s_saved_ms = k_uptime_get_32();
+  return restored;
+}
+
+/* Diagnostics queue: a slow flash write never holds up the system queue */
+static void calstore_schedule(uint32_t delay_ms) {
+  (void)k_work_reschedule_for_queue(heartbeat_work_queue(), &s_save_work,
+                                    K_MSEC(delay_ms));
+}
+
+void pedal_calstore_notify(void) {
+  /* Restarts the delay: a learning sweep ends up as a single write */
+  calstore_schedule(CONFIG_MIDAL_CAL_SAVE_DELAY_MS);
+}
+
+/* Worth a flash write: a range appeared, vanished or moved noticeably */
+static bool calstore_moved(const calstore_record_t *rec) {
+  if (!s_saved_once || rec->valid != s_saved.valid) {
+    return true;
+  }
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    if (abs((int32_t)rec->min_adc[i] - (int32_t)s_saved.min_adc[i]) >=
+            CALSTORE_MIN_DELTA ||
+        abs((int32_t)rec->max_adc[i] - (int32_t)s_saved.max_adc[i]) >=
+            CALSTORE_MIN_DELTA) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void calstore_save_work(struct k_work *work) {
+  ARG_UNUSED(work);
+
+  /* Flash writes stall the CPU: wait until no pedal output has moved */
+  const uint32_t idle = pedal_sampler_idle_ms();
+  if (idle < CONFIG_MIDAL_CAL_SAVE_DELAY_MS) {
+    calstore_schedule(CONFIG_MIDAL_CAL_SAVE_DELAY_MS - idle);
+    return;
+  }
+
+  const uint32_t since = k_uptime_get_32() - s_saved_ms;
+  if (s_saved_once && since < CALSTORE_INTERVAL_MS) {
+    calstore_schedule(CALSTORE_INTERVAL_MS - since);
+    return;
+  }
+
+  calstore_record_t rec = {
+      .version = CALSTORE_VERSION,
+      .frac_bits = PEDAL_RAW_FRAC_BITS,
+      .pedals = MIDAL_NUM_PEDALS,
+  };
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    pedal_calibration_t cal;
+
+    pedal_filter_get_calibration(i, &cal);
+    if (cal.initialized) {
+      rec.min_adc[i] = cal.min_adc;
+      rec.max_adc[i] = cal.max_adc;
+      rec.valid |= BIT(i);
+    }
+  }
+
+  if (!calstore_moved(&rec)) {
+    return;
+  }
+
+  int err = settings_save_one(CALSTORE_KEY, &rec, sizeof(rec));
+  if (err != 0) {
+    LOG_WRN("Saving calibration failed: %d", err);
+    calstore_schedule(CALSTORE_INTERVAL_MS);
+    return;
+  }
+
+  s_saved = rec;
+  s_saved_ms = k_uptime_get_32();
+  s_saved_once = true;
+  LOG_INF("Calibration saved");
+}
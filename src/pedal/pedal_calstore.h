@@ -0,0 +1,30 @@
+#pragma once
+
+#include "midal_conf.h"
+#include "pedal_filter.h"
+
+#include <zephyr/kernel.h>
+
+/*
+ * Learned pedal calibration kept in flash through the settings subsystem
+ * (NVS on the storage partition, the flash simulator on native_sim).
+ *
+ * Saves run on the diagnostics work queue (heartbeat_work_queue()) once
+ * calibration has stopped moving and no pedal output has changed for
+ * CONFIG_MIDAL_CAL_SAVE_DELAY_MS, at most once per
+ * CONFIG_MIDAL_CAL_SAVE_INTERVAL_S, and only when a range moved by at least
+ * CONFIG_MIDAL_CAL_SAVE_MIN_DELTA_LSB since the last write.
+ */
+
+/*
+ * Read the saved calibration into cal[]; pedals without a saved range are
+ * left untouched. Call before the first sample. Returns the number of pedals
+ * restored or a negative errno.
+ */
+int pedal_calstore_load(pedal_calibration_t cal[MIDAL_NUM_PEDALS]);
+
+/*
+ * Calibration of the live filter changed: (re)arm the debounced save.
+ * Cheap; safe from the sampling thread.
+ */
+void pedal_calstore_notify(void);
@@ -0,0 +1,336 @@
+#include "pedal_curve.h"
+
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(pedal_curve, LOG_LEVEL_INF);
+
+/*
+ * Entries filled per work item run. An entry costs at most one logf() and a
+ * few float operations (~300 cycles on the Cortex-M4F), so a chunk stays
+ * within ~300 us at 64 MHz.
+ */
+#define CURVE_BUILD_CHUNK 64U
+/* Retry period while the sampling thread may still read the spare table */
+#define CURVE_RETRY_MS 1
+/*
+ * Calibration extends on every new extreme while a pedal moves: start at
+ * most one rebuild per period and fold the requests made meanwhile into it.
+ */
+#define CURVE_REQUEST_MS 100
+
+/* Preemptible and below the transports, unlike the system work queue */
+#define CURVE_WQ_STACK_SIZE 1024
+#define CURVE_WQ_PRIORITY K_LOWEST_APPLICATION_THREAD_PRIO
+
+/* Log curve: y = ln(1 + k x) / ln(1 + k) */
+#define CURVE_LOG_K 15.0F
+
+#ifndef CONFIG_MIDAL_HALF_PEDAL_CENTER_PCT
+#define CONFIG_MIDAL_HALF_PEDAL_CENTER_PCT 50
+#endif
+#ifndef CONFIG_MIDAL_HALF_PEDAL_WIDTH_PCT
+#define CONFIG_MIDAL_HALF_PEDAL_WIDTH_PCT 30
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_CURVE_SUSTAIN_LOG)
+#define CURVE_DEFAULT_SUSTAIN PEDAL_CURVE_LOG
+#elif IS_ENABLED(CONFIG_MIDAL_CURVE_SUSTAIN_S)
+#define CURVE_DEFAULT_SUSTAIN PEDAL_CURVE_S
+#elif IS_ENABLED(CONFIG_MIDAL_CURVE_SUSTAIN_HALF_PEDAL)
+#define CURVE_DEFAULT_SUSTAIN PEDAL_CURVE_HALF_PEDAL
+#else
+#define CURVE_DEFAULT_SUSTAIN PEDAL_CURVE_LINEAR
+#endif
+
+#if IS_ENABLED(CONFIG_MIDAL_CURVE_OTHER_LOG)
+#define CURVE_DEFAULT_OTHER PEDAL_CURVE_LOG
+#elif IS_ENABLED(CONFIG_MIDAL_CURVE_OTHER_S)
+#define CURVE_DEFAULT_OTHER PEDAL_CURVE_S
+#else
+#define CURVE_DEFAULT_OTHER PEDAL_CURVE_LINEAR
+#endif
+
+typedef struct {
+  uint16_t min_raw;
+  uint16_t span;
+  pedal_curve_t curve;
+  bool invert;
+} curve_req_t;
+
+/* One table per pedal plus a spare the builder fills before swapping */
+static uint16_t s_pool[MIDAL_NUM_PEDALS + 1][PEDAL_CURVE_LUT_SIZE];
+static atomic_ptr_t s_lut[MIDAL_NUM_PEDALS];
+static uint16_t *s_spare;
+
+/*
+ * Scan counter of the sampling thread. A table swapped out at epoch E may
+ * still be read by the scan in progress at E, so it becomes the new spare
+ * only once the epoch has moved on.
+ */
+static atomic_t s_epoch;
+static atomic_val_t s_swap_epoch;
+static bool s_swap_pending;
+
+/* Requested parameters per pedal and the pedals needing a rebuild */
+static struct k_spinlock s_lock;
+static curve_req_t s_req[MIDAL_NUM_PEDALS];
+static atomic_t s_dirty;
+
+/* Build in progress (work queue only) */
+static struct {
+  int pedal; /* -1 when idle */
+  curve_req_t req;
+  float inv_span;
+  uint32_t next;
+} s_build = {.pedal = -1};
+
+static void curve_build_work(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(s_build_work, curve_build_work);
+
+static K_THREAD_STACK_DEFINE(s_curve_wq_stack, CURVE_WQ_STACK_SIZE);
+static struct k_work_q s_curve_wq;
+static bool s_curve_wq_started;
+
+/* 1 / ln(1 + k) of the log curve */
+static float s_log_norm;
+
+/* Piecewise-linear curve giving the half-pedal zone twice its travel */
+static float curve_half_pedal(float x) {
+  const float c = (float)CONFIG_MIDAL_HALF_PEDAL_CENTER_PCT / 100.0F;
+  const float w = (float)CONFIG_MIDAL_HALF_PEDAL_WIDTH_PCT / 100.0F;
+  const float z0 = fmaxf(c - (w / 2.0F), 0.01F);
+  const float z1 = fminf(c + (w / 2.0F), 0.99F);
+  const float y0 = fmaxf(c - w, z0 / 2.0F);
+  const float y1 = fminf(c + w, (1.0F + z1) / 2.0F);
+
+  if (x < z0) {
+    return x * y0 / z0;
+  }
+  if (x <= z1) {
+    return y0 + ((x - z0) * (y1 - y0) / (z1 - z0));
+  }
+  return y1 + ((x - z1) * (1.0F - y1) / (1.0F - z1));
+}
+
+static float curve_shape(pedal_curve_t curve, float x) {
+  switch (curve) {
+  case PEDAL_CURVE_LOG:
+    return logf(1.0F + (CURVE_LOG_K * x)) * s_log_norm;
+  case PEDAL_CURVE_S:
+    return x * x * (3.0F - (2.0F * x));
+  case PEDAL_CURVE_HALF_PEDAL:
+    return curve_half_pedal(x);
+  case PEDAL_CURVE_LINEAR:
+  default:
+    return x;
+  }
+}
+
+/* Same normalization as the computed filter path, then the curve */
+static uint16_t curve_entry(const curve_req_t *req, float inv_span,
+                            uint32_t idx) {
+  int32_t num = CLAMP((int32_t)(idx << PEDAL_RAW_FRAC_BITS) -
+                          (int32_t)req->min_raw,
+                      0, (int32_t)req->span);
+  float v = (float)num * inv_span;
+
+  /* Endpoint hold: snap very close values to exact 0/1 to avoid chatter */
+  const float eps = IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? (1.0F / 16383.0F)
+                                                          : (1.0F / 127.0F);
+  if (v < eps) {
+    v = 0.0F;
+  } else if (v > 1.0F - eps) {
+    v = 1.0F;
+  }
+
+  if (req->invert) {
+    v = 1.0F - v;
+  }
+
+  float y = curve_shape(req->curve, v);
+  return (uint16_t)CLAMP((int32_t)((y * (float)PEDAL_CURVE_ONE) + 0.5F), 0,
+                         (int32_t)PEDAL_CURVE_ONE);
+}
+
+static void curve_fill(uint16_t *lut, const curve_req_t *req, float inv_span,
+                       uint32_t from, uint32_t to) {
+  for (uint32_t idx = from; idx < to; idx++) {
+    lut[idx] = curve_entry(req, inv_span, idx);
+  }
+}
+
+static void curve_begin(int pedal) {
+  atomic_clear_bit(&s_dirty, pedal);
+
+  k_spinlock_key_t key = k_spin_lock(&s_lock);
+  s_build.req = s_req[pedal];
+  k_spin_unlock(&s_lock, key);
+
+  s_build.pedal = pedal;
+  s_build.inv_span = 1.0F / (float)s_build.req.span;
+  s_build.next = 0U;
+}
+
+static void curve_build_work(struct k_work *work) {
+  ARG_UNUSED(work);
+
+  if (s_build.pedal < 0) {
+    atomic_val_t dirty = atomic_get(&s_dirty);
+    if (dirty == 0) {
+      return;
+    }
+
+    if (s_swap_pending) {
+      if (atomic_get(&s_epoch) == s_swap_epoch) {
+        k_work_reschedule_for_queue(&s_curve_wq, &s_build_work,
+                                    K_MSEC(CURVE_RETRY_MS));
+        return;
+      }
+      s_swap_pending = false;
+    }
+
+    curve_begin(u32_count_trailing_zeros((uint32_t)dirty));
+  }
+
+  /*
+   * Parameters that move mid-build leave the pedal dirty: this table is
+   * still published, and the next one starts after the request period.
+   */
+  uint32_t to = MIN(s_build.next + CURVE_BUILD_CHUNK, PEDAL_CURVE_LUT_SIZE);
+  curve_fill(s_spare, &s_build.req, s_build.inv_span, s_build.next, to);
+  s_build.next = to;
+
+  if (s_build.next < PEDAL_CURVE_LUT_SIZE) {
+    k_work_reschedule_for_queue(&s_curve_wq, &s_build_work, K_NO_WAIT);
+    return;
+  }
+
+  /* Publish, and keep the old table as the next spare once released */
+  s_spare = atomic_ptr_set(&s_lut[s_build.pedal], s_spare);
+  s_swap_epoch = atomic_get(&s_epoch);
+  s_swap_pending = true;
+  LOG_DBG("Pedal %d table rebuilt (min %u span %u curve %d)", s_build.pedal,
+          s_build.req.min_raw, s_build.req.span, s_build.req.curve);
+  s_build.pedal = -1;
+
+  if (atomic_get(&s_dirty) != 0) {
+    k_work_reschedule_for_queue(&s_curve_wq, &s_build_work,
+                                K_MSEC(CURVE_REQUEST_MS));
+  }
+}
+
+void pedal_curve_init(const uint16_t min_raw[MIDAL_NUM_PEDALS],
+                      const uint16_t span[MIDAL_NUM_PEDALS],
+                      const bool invert[MIDAL_NUM_PEDALS]) {
+  if (!s_curve_wq_started) {
+    const struct k_work_queue_config cfg = {.name = "pedal_curve"};
+
+    k_work_queue_start(&s_curve_wq, s_curve_wq_stack,
+                       K_THREAD_STACK_SIZEOF(s_curve_wq_stack),
+                       CURVE_WQ_PRIORITY, &cfg);
+    s_curve_wq_started = true;
+  }
+
+  (void)k_work_cancel_delayable(&s_build_work);
+  atomic_clear(&s_dirty);
+  s_build.pedal = -1;
+  s_swap_pending = false;
+  s_log_norm = 1.0F / logf(1.0F + CURVE_LOG_K);
+
+  for (int i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    s_req[i] = (curve_req_t){
+        .min_raw = min_raw[i],
+        .span = span[i],
+        .curve = (i == MIDAL_PEDAL_SUSTAIN) ? CURVE_DEFAULT_SUSTAIN
+                                            : CURVE_DEFAULT_OTHER,
+        .invert = invert[i],
+    };
+    curve_fill(s_pool[i], &s_req[i], 1.0F / (float)span[i], 0U,
+               PEDAL_CURVE_LUT_SIZE);
+    atomic_ptr_set(&s_lut[i], s_pool[i]);
+  }
+  s_spare = s_pool[MIDAL_NUM_PEDALS];
+
+  LOG_INF("Response curves: sustain %s, others %s",
+          pedal_curve_name(CURVE_DEFAULT_SUSTAIN),
+          pedal_curve_name(CURVE_DEFAULT_OTHER));
+}
+
+const char *pedal_curve_name(pedal_curve_t curve) {
+  static const char *const names[PEDAL_CURVE_COUNT] = {
+      [PEDAL_CURVE_LINEAR] = "linear",
+      [PEDAL_CURVE_LOG] = "log",
+      [PEDAL_CURVE_S] = "s-curve",
+      [PEDAL_CURVE_HALF_PEDAL] = "half-pedal",
+  };
+
+  return (curve < PEDAL_CURVE_COUNT) ? names[curve] : "?";
+}
+
+static void curve_schedule(uint8_t pedal_id) {
+  atomic_set_bit(&s_dirty, pedal_id);
+  /* No-op while a build, retry or earlier request is already queued */
+  (void)k_work_schedule_for_queue(&s_curve_wq, &s_build_work,
+                                  K_MSEC(CURVE_REQUEST_MS));
+}
+
+int pedal_curve_set(uint8_t pedal_id, pedal_curve_t curve) {
+  if (pedal_id >= MIDAL_NUM_PEDALS || curve >= PEDAL_CURVE_COUNT) {
+    return -EINVAL;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&s_lock);
+  s_req[pedal_id].curve = curve;
+  k_spin_unlock(&s_lock, key);
+
+  curve_schedule(pedal_id);
+  return 0;
+}
+
+pedal_curve_t pedal_curve_get(uint8_t pedal_id) {
+  if (pedal_id >= MIDAL_NUM_PEDALS) {
+    return PEDAL_CURVE_LINEAR;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&s_lock);
+  pedal_curve_t curve = s_req[pedal_id].curve;
+  k_spin_unlock(&s_lock, key);
+  return curve;
+}
+
+int pedal_curve_set_invert(uint8_t pedal_id, bool invert) {
+  if (pedal_id >= MIDAL_NUM_PEDALS) {
+    return -EINVAL;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&s_lock);
+  s_req[pedal_id].invert = invert;
+  k_spin_unlock(&s_lock, key);
+
+  curve_schedule(pedal_id);
+  return 0;
+}
+
+void pedal_curve_request(uint8_t pedal_id, uint16_t min_raw, uint16_t span) {
+  if (pedal_id >= MIDAL_NUM_PEDALS || span == 0U) {
+    return;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&s_lock);
+  s_req[pedal_id].min_raw = min_raw;
+  s_req[pedal_id].span = span;
+  k_spin_unlock(&s_lock, key);
+
+  curve_schedule(pedal_id);
+}
+
+const uint16_t *pedal_curve_lut(uint8_t pedal_id) {
+  return atomic_ptr_get(&s_lut[pedal_id]);
+}
+
+void pedal_curve_scan_done(void) { atomic_inc(&s_epoch); }
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "midal_conf.h"
+#include "pedal_filter.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+/*
+ * Per-pedal raw-to-position lookup tables with response curves.
+ *
+ * Each table has one entry per 12-bit ADC code and holds the normalized,
+ * endpoint-snapped, polarity-corrected and curve-shaped position in Q16
+ * (0xFFFF = fully pressed). Tables are rebuilt on a low-priority work queue
+ * of their own when the calibration or the curve of a pedal changes, at
+ * most one rebuild start per 100 ms, and published with a pointer swap; the
+ * sampling thread only loads from them.
+ */
+
+#define PEDAL_CURVE_LUT_SIZE 4096U
+#define PEDAL_CURVE_ONE 0xFFFFU
+
+typedef enum {
+  PEDAL_CURVE_LINEAR = 0,
+  PEDAL_CURVE_LOG,        /* Fast rise at the start of the travel */
+  PEDAL_CURVE_S,          /* Smoothstep: fine control at both ends */
+  PEDAL_CURVE_HALF_PEDAL, /* Expanded damper half-pedal zone */
+  PEDAL_CURVE_COUNT
+} pedal_curve_t;
+
+/*
+ * Build the tables for the Kconfig curves and the given per-pedal
+ * calibration (raw filter input units, spans already limited to the
+ * calibration minimum) and polarity. Synchronous; call before the sampling
+ * thread starts.
+ */
+void pedal_curve_init(const uint16_t min_raw[MIDAL_NUM_PEDALS],
+                      const uint16_t span[MIDAL_NUM_PEDALS],
+                      const bool invert[MIDAL_NUM_PEDALS]);
+
+/* Select the curve of a pedal; the table is rebuilt in the background */
+int pedal_curve_set(uint8_t pedal_id, pedal_curve_t curve);
+pedal_curve_t pedal_curve_get(uint8_t pedal_id);
+
+/* Reverse the polarity of a pedal; the table is rebuilt in the background */
+int pedal_curve_set_invert(uint8_t pedal_id, bool invert);
+
+/*
+ * Calibration of a pedal moved: rebuild its table for [min_raw, min_raw +
+ * span]. Cheap; safe from any thread.
+ */
+void pedal_curve_request(uint8_t pedal_id, uint16_t min_raw, uint16_t span);
+
+const char *pedal_curve_name(pedal_curve_t curve);
+
+/* Current table of a pedal. Load once per scan. */
+const uint16_t *pedal_curve_lut(uint8_t pedal_id);
+
+/*
+ * Sampling thread finished a scan: tables it loaded before may be reused
+ * by the builder.
+ */
+void pedal_curve_scan_done(void);
+
+/* Position in Q16 for a raw filter input, interpolating fractional bits */
+static inline uint16_t pedal_curve_lookup(const uint16_t *lut, uint16_t raw) {
+  const uint32_t idx = (uint32_t)raw >> PEDAL_RAW_FRAC_BITS;
+#if PEDAL_RAW_FRAC_BITS > 0
+  const int32_t frac = (int32_t)(raw & BIT_MASK(PEDAL_RAW_FRAC_BITS));
+  const int32_t a = lut[idx];
+  const int32_t b = lut[MIN(idx + 1U, PEDAL_CURVE_LUT_SIZE - 1U)];
+  return (uint16_t)(a + (((b - a) * frac) >> PEDAL_RAW_FRAC_BITS));
+#else
+  return lut[idx];
+#endif
+}
@@ -0,0 +1,107 @@
+#include "pedal_decim.h"
+#include "pedal_filter.h"
+
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_MIDAL_DECIM)
+
+BUILD_ASSERT((PEDAL_DECIM_RATIO & (PEDAL_DECIM_RATIO - 1)) == 0,
+             "MIDAL_DECIM_RATIO must be a power of two");
+
+/* log2(R) for the power-of-two ratios allowed by Kconfig */
+#define DECIM_RATIO_LOG2                                                       \
+  ((PEDAL_DECIM_RATIO >= 16) ? 4 : (PEDAL_DECIM_RATIO >= 8) ? 3 : 2)
+
+/* CIC DC gain is R^K = 2^(K*log2 R); keep PEDAL_RAW_FRAC_BITS of it */
+#define DECIM_GAIN_BITS (PEDAL_DECIM_ORDER * DECIM_RATIO_LOG2)
+
+BUILD_ASSERT(12 + DECIM_GAIN_BITS <= 31, "CIC register width exceeds 32 bits");
+
+typedef struct {
+  /* Integrator and comb delay registers; wrap-around arithmetic is intended */
+  uint32_t integ[PEDAL_DECIM_ORDER];
+  uint32_t comb[PEDAL_DECIM_ORDER];
+} decim_channel_t;
+
+static decim_channel_t s_ch[MIDAL_NUM_PEDALS];
+static uint8_t s_phase;
+static uint8_t s_warmup;
+
+void pedal_decim_reset(void) {
+  memset(s_ch, 0, sizeof(s_ch));
+  s_phase = 0U;
+  /* The comb chain needs K outputs before it reflects a settled input */
+  s_warmup = PEDAL_DECIM_ORDER;
+}
+
+static inline uint16_t decim_scale(uint32_t acc) {
+#if DECIM_GAIN_BITS >= PEDAL_RAW_FRAC_BITS
+#if DECIM_GAIN_BITS > PEDAL_RAW_FRAC_BITS
+  acc = (acc + BIT(DECIM_GAIN_BITS - PEDAL_RAW_FRAC_BITS - 1)) >>
+        (DECIM_GAIN_BITS - PEDAL_RAW_FRAC_BITS);
+#endif
+#else
+  acc <<= (PEDAL_RAW_FRAC_BITS - DECIM_GAIN_BITS);
+#endif
+  return (uint16_t)MIN(acc, (uint32_t)PEDAL_RAW_MAX);
+}
+
+bool pedal_decim_push(const uint16_t in[MIDAL_NUM_PEDALS],
+                      uint16_t out[MIDAL_NUM_PEDALS]) {
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    decim_channel_t *ch = &s_ch[i];
+    uint32_t acc = in[i];
+
+    for (size_t k = 0; k < PEDAL_DECIM_ORDER; k++) {
+      ch->integ[k] += acc;
+      acc = ch->integ[k];
+    }
+  }
+
+  if (++s_phase < PEDAL_DECIM_RATIO) {
+    return false;
+  }
+  s_phase = 0U;
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    decim_channel_t *ch = &s_ch[i];
+    uint32_t acc = ch->integ[PEDAL_DECIM_ORDER - 1];
+
+    for (size_t k = 0; k < PEDAL_DECIM_ORDER; k++) {
+      uint32_t prev = ch->comb[k];
+      ch->comb[k] = acc;
+      acc -= prev;
+    }
+
+    out[i] = decim_scale(acc);
+  }
+
+  if (s_warmup > 0U) {
+    s_warmup--;
+    return false;
+  }
+
+  return true;
+}
+
+uint32_t pedal_decim_group_delay_us(void) {
+  /* K * (R - 1) / 2 input scans */
+  const uint32_t scan_us = 1000000U / (CONFIG_MIDAL_POLL_HZ * PEDAL_DECIM_RATIO);
+  return (PEDAL_DECIM_ORDER * (PEDAL_DECIM_RATIO - 1U) * scan_us) / 2U;
+}
+
+#else /* !CONFIG_MIDAL_DECIM */
+
+void pedal_decim_reset(void) {}
+
+bool pedal_decim_push(const uint16_t in[MIDAL_NUM_PEDALS],
+                      uint16_t out[MIDAL_NUM_PEDALS]) {
+  memcpy(out, in, sizeof(uint16_t) * MIDAL_NUM_PEDALS);
+  return true;
+}
+
+uint32_t pedal_decim_group_delay_us(void) {
+  return 0U;
+}
+
+#endif
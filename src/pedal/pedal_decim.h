@@ -0,0 +1,33 @@
+#pragma once
+
+#include "midal_conf.h"
+
+#include <zephyr/kernel.h>
+
+/*
+ * CIC decimator between the oversampled SAADC scans and pedal_filter_apply_all().
+ *
+ * Each channel runs CONFIG_MIDAL_DECIM_CIC_ORDER integrator/comb stages and
+ * emits one value per CONFIG_MIDAL_DECIM_RATIO input scans. Outputs carry
+ * PEDAL_RAW_FRAC_BITS fractional bits below the 12-bit ADC LSB.
+ */
+
+#if IS_ENABLED(CONFIG_MIDAL_DECIM)
+#define PEDAL_DECIM_RATIO CONFIG_MIDAL_DECIM_RATIO
+#define PEDAL_DECIM_ORDER CONFIG_MIDAL_DECIM_CIC_ORDER
+#else
+#define PEDAL_DECIM_RATIO 1
+#define PEDAL_DECIM_ORDER 0
+#endif
+
+void pedal_decim_reset(void);
+
+/*
+ * Push one 12-bit scan (values already clamped to 0..4095). Returns true and
+ * fills out[] when a decimated output is ready.
+ */
+bool pedal_decim_push(const uint16_t in[MIDAL_NUM_PEDALS],
+                      uint16_t out[MIDAL_NUM_PEDALS]);
+
+/* Group delay of the decimator in microseconds at the configured rates */
+uint32_t pedal_decim_group_delay_us(void);
@@ -1,178 +1,1162 @@
 #include "pedal_filter.h"
+#include "pedal_calstore.h"
+#include "pedal_curve.h"
+#include "pedal_params.h"
+#include "diag/profiler.h"
+#include "diag/stats.h"
 #include "midal_conf.h"
 
 #include <math.h>
 #include <stdlib.h>
 #include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/util.h>
 
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define FILTER_USE_SIMD 1
+#else
+#define FILTER_USE_SIMD 0
+#endif
+
+#if FILTER_USE_SIMD || IS_ENABLED(CONFIG_CORTEX_M_DWT)
+#include <cmsis_core.h>
+#endif
+
 #ifndef CONFIG_MIDAL_CAL_MARGIN_LSB
 #define CONFIG_MIDAL_CAL_MARGIN_LSB 4
 #endif
 #ifndef CONFIG_MIDAL_CAL_MIN_SPAN_LSB
 #define CONFIG_MIDAL_CAL_MIN_SPAN_LSB 32
 #endif
-#define CAL_MARGIN ((uint16_t)CONFIG_MIDAL_CAL_MARGIN_LSB)
-#define CAL_MIN_SPAN ((uint16_t)CONFIG_MIDAL_CAL_MIN_SPAN_LSB)
+#define CAL_MARGIN ((uint16_t)(CONFIG_MIDAL_CAL_MARGIN_LSB << PEDAL_RAW_FRAC_BITS))
+#define CAL_MIN_SPAN                                                           \
+  ((uint16_t)(CONFIG_MIDAL_CAL_MIN_SPAN_LSB << PEDAL_RAW_FRAC_BITS))
+#define CAL_DEFAULT_MIN ((uint16_t)(500U << PEDAL_RAW_FRAC_BITS))
+
+#ifndef CONFIG_MIDAL_FILTER_TAU_MS
+#define CONFIG_MIDAL_FILTER_TAU_MS 5
+#endif
+#ifndef CONFIG_MIDAL_FILTER_ALPHA_MILLIPCT
+#define CONFIG_MIDAL_FILTER_ALPHA_MILLIPCT 200
+#endif
+#ifndef CONFIG_MIDAL_FILTER_ALPHA_UP_MIN_MILLIPCT
+#define CONFIG_MIDAL_FILTER_ALPHA_UP_MIN_MILLIPCT 40000
+#endif
+#ifndef CONFIG_MIDAL_FILTER_ALPHA_DOWN_MAX_MILLIPCT
+#define CONFIG_MIDAL_FILTER_ALPHA_DOWN_MAX_MILLIPCT 20000
+#endif
+
+/* Wait for the sampling thread to release the spare coefficient set */
+#define COEF_RELEASE_MS 100U
+
+#ifndef CONFIG_MIDAL_FILTER_1E_MIN_CUTOFF_MHZ
+#define CONFIG_MIDAL_FILTER_1E_MIN_CUTOFF_MHZ 1000
+#endif
+#ifndef CONFIG_MIDAL_FILTER_1E_BETA_MILLI
+#define CONFIG_MIDAL_FILTER_1E_BETA_MILLI 10000
+#endif
+#ifndef CONFIG_MIDAL_FILTER_1E_DCUTOFF_MHZ
+#define CONFIG_MIDAL_FILTER_1E_DCUTOFF_MHZ 10000
+#endif
+#define ONE_EURO_MIN_CUTOFF_MHZ ((uint32_t)CONFIG_MIDAL_FILTER_1E_MIN_CUTOFF_MHZ)
+#define ONE_EURO_BETA_MILLI ((uint32_t)CONFIG_MIDAL_FILTER_1E_BETA_MILLI)
+
+#ifndef CONFIG_MIDAL_PREDICT_LEAD_US
+#define CONFIG_MIDAL_PREDICT_LEAD_US 2000
+#endif
+#ifndef CONFIG_MIDAL_PREDICT_ALPHA_MILLI
+#define CONFIG_MIDAL_PREDICT_ALPHA_MILLI 700
+#endif
+#ifndef CONFIG_MIDAL_PREDICT_GATE_PCT_S
+#define CONFIG_MIDAL_PREDICT_GATE_PCT_S 20
+#endif
+
+#ifndef CONFIG_MIDAL_FILTER_HYST_NOISE_K_TENTHS
+#define CONFIG_MIDAL_FILTER_HYST_NOISE_K_TENTHS 80
+#endif
+#ifndef CONFIG_MIDAL_FILTER_HYST_MIN_LSB
+#define CONFIG_MIDAL_FILTER_HYST_MIN_LSB 1
+#endif
+
+/*
+ * Noise tracker: pre-quantization output in 1/256 LSB, statistics over
+ * blocks of NOISE_BLOCK samples. A block is still when its mean moved less
+ * than twice its spread from the previous block's (a ramp across a block
+ * moves the mean by sqrt(12) times its spread). A move starting late in a
+ * block only shows as spread, so a block counts as rest once the next one
+ * is still too.
+ */
+#define NOISE_FRAC_BITS 8
+#define NOISE_BLOCK_SHIFT 6
+#define NOISE_BLOCK BIT(NOISE_BLOCK_SHIFT)
+#define NOISE_REST_BLOCKS 2U
+/* Mean drift per block still taken as rest, (1/4 LSB)^2 in Q16 */
+#define NOISE_DRIFT_FLOOR ((uint64_t)BIT((2 * NOISE_FRAC_BITS) - 4))
+#define NOISE_VAR_UNSET UINT32_MAX
+
+/* Fixed-point kernel scales: normalized value and EMA state in Q30 */
+#define Q30_ONE ((int32_t)BIT(30))
+#define FILTER_OUT_BITS (IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? 14 : 7)
+#define FILTER_OUT_MAX ((int32_t)BIT_MASK(FILTER_OUT_BITS))
+/* Smallest Q30 value the float path would not snap to 0 (v >= 1/out_max) */
+#define Q30_EPS ((int32_t)DIV_ROUND_UP(Q30_ONE, FILTER_OUT_MAX))
+
+/* Last output sentinel: far enough from any output to defeat hysteresis */
+#define LAST_OUT_UNSET INT16_MIN
+
+#define TWO_PI 6.28318531F
 
 typedef struct {
-  float alpha; // 0..1
-  float s_alpha_up;
-  float s_alpha_down;
-  uint8_t hysteresis_cc; // hysteresis in 7-bit CC steps (config units)
-  uint16_t hysteresis_lsb; // hysteresis in output LSBs (auto-scaled)
+  float s_alpha_up[MIDAL_NUM_PEDALS];
+  float s_alpha_down[MIDAL_NUM_PEDALS];
+  int32_t q_alpha_up[MIDAL_NUM_PEDALS];   // s_alpha_up in Q31 (fixed-point kernel)
+  int32_t q_alpha_down[MIDAL_NUM_PEDALS]; // s_alpha_down in Q31
+  uint16_t hysteresis_lsb[MIDAL_NUM_PEDALS]; // hysteresis in output LSBs
+  bool invert[MIDAL_NUM_PEDALS]; // polarity reversed after calibration
+  uint32_t fs_hz; // output sample rate the coefficients are for
+  float oe_alpha_d; // One Euro: speed estimate smoothing
+  int32_t q_oe_alpha_d; // oe_alpha_d in Q31
+  uint32_t q_oe_k; // One Euro: 2*pi/(1000*fs) in Q36, cutoff mHz -> Q20
+  float pr_alpha; // Predictor position gain
+  float pr_beta;  // Predictor velocity gain
+  float pr_lead;  // Predictor lead in samples
+  float pr_gate;  // Predictor off below this speed (full scale per sample)
+  int32_t q_pr_alpha; // pr_alpha in Q31
+  int32_t q_pr_beta;  // pr_beta in Q31
+  uint32_t q_pr_lead; // pr_lead in Q16
+  int32_t q_pr_gate;  // pr_gate in Q30
   bool use14bit; // send CC+LSB
 } pedal_filter_cfg_t;
 
-static pedal_filter_cfg_t g_cfg;
-static float s_state[MIDAL_NUM_PEDALS];
-static int16_t s_last_out[MIDAL_NUM_PEDALS];
-static pedal_calibration_t s_calibration[MIDAL_NUM_PEDALS];
+/*
+ * A parameter set and the coefficients derived from it at the active and
+ * idle rates. Builders fill the spare and publish it with a pointer swap;
+ * the sampling thread loads the pointer once per scan and never derives
+ * anything itself.
+ */
+typedef struct {
+  pedal_filter_params_t params;
+  pedal_filter_cfg_t active;
+  pedal_filter_cfg_t idle; /* Same as active without CONFIG_MIDAL_ADAPTIVE_RATE */
+} filter_coef_set_t;
 
-void pedal_filter_init(void) {
+/*
+ * Per-pedal state in struct-of-arrays layout so each kernel walks all
+ * channels in one pass. Both kernels share the calibration fields.
+ */
+typedef struct {
+  uint16_t cal_min[MIDAL_NUM_PEDALS];
+  uint16_t cal_max[MIDAL_NUM_PEDALS];
+  bool cal_init[MIDAL_NUM_PEDALS];
+  uint16_t span[MIDAL_NUM_PEDALS];  /* max - min, at least CAL_MIN_SPAN */
+  uint32_t recip[MIDAL_NUM_PEDALS]; /* round(2^31 / span) */
+  float ema[MIDAL_NUM_PEDALS];
+  int32_t ema_q30[MIDAL_NUM_PEDALS];
+  float speed[MIDAL_NUM_PEDALS];       /* One Euro: smoothed change/sample */
+  int32_t speed_q30[MIDAL_NUM_PEDALS];
+  float pr_pos[MIDAL_NUM_PEDALS]; /* Predictor: tracked position */
+  float pr_vel[MIDAL_NUM_PEDALS]; /* Predictor: full scale per sample */
+  int32_t pr_pos_q30[MIDAL_NUM_PEDALS];
+  int32_t pr_vel_q30[MIDAL_NUM_PEDALS];
+  float pr_out[MIDAL_NUM_PEDALS]; /* Predictor: last output */
+  int32_t pr_out_q30[MIDAL_NUM_PEDALS];
+  int32_t nz_ref[MIDAL_NUM_PEDALS];  /* Noise: previous block mean */
+  int32_t nz_sum[MIDAL_NUM_PEDALS];  /* Noise: sum of x - nz_ref */
+  uint64_t nz_sq[MIDAL_NUM_PEDALS];  /* Noise: sum of (x - nz_ref)^2 */
+  uint32_t nz_var[MIDAL_NUM_PEDALS]; /* Noise at rest, Q16 LSB^2 */
+  uint32_t nz_prev_var[MIDAL_NUM_PEDALS]; /* Spread of the previous block */
+  uint32_t nz_steps[MIDAL_NUM_PEDALS]; /* Moving: output change in block */
+  uint16_t nz_moves[MIDAL_NUM_PEDALS];  /* Moving: output changes in block */
+  uint16_t nz_events[MIDAL_NUM_PEDALS]; /* Resting: output changes in block */
+  uint16_t nz_prev_events[MIDAL_NUM_PEDALS]; /* nz_events, previous block */
+  uint16_t hyst_rest[MIDAL_NUM_PEDALS]; /* Dead band at rest, LSBs */
+  uint8_t nz_n[MIDAL_NUM_PEDALS];     /* Samples in this block */
+  uint8_t nz_still[MIDAL_NUM_PEDALS]; /* Consecutive still blocks */
+  bool moving[MIDAL_NUM_PEDALS]; /* Output moved since the pedal came to rest */
+  int16_t last_out[MIDAL_NUM_PEDALS];
+  bool live; /* Drives the pedal_curve tables and the calibration store */
+} filter_bank_t;
+
+/* Live set plus a spare */
+static filter_coef_set_t s_coef_pool[2];
+static atomic_ptr_t s_coef;
+static filter_coef_set_t *s_coef_spare;
+
+/*
+ * Scans filtered. A set swapped out at epoch E may still be read by the scan
+ * in progress at E, so it becomes the spare only once the epoch has moved on.
+ */
+static atomic_t s_coef_epoch;
+static atomic_val_t s_coef_swap_epoch;
+static bool s_coef_swap_pending;
+/* Serializes builders; the sampling thread never takes it */
+static K_MUTEX_DEFINE(s_coef_lock);
+
+/* Output rate set by the sampling thread */
+static uint32_t s_fs_hz;
+/* Active poll rate of the set the latest scan loaded */
+static atomic_t s_poll_hz;
+static filter_bank_t s_bank;
+
+/* Per-call kernel options; the live filter derives them from Kconfig */
+typedef struct {
+  const pedal_filter_cfg_t *cfg; /* Coefficients for this scan */
+  bool hyst;      /* Output dead band of cfg->hysteresis_lsb per pedal */
+  bool hyst_auto; /* Dead band per pedal from its noise, hyst is the cap */
+  bool one_euro; /* Speed-adaptive cutoff instead of the asymmetric EMA */
+  bool predict;  /* Alpha-beta lead stage after the smoothing */
+} filter_opts_t;
+
+/* Scans filtered; the kernel cost is the profiler's PROF_FILTER stage */
+static atomic_t s_scans;
 
-  /* Initialize filter configuration from Kconfig/prj.conf */
-  g_cfg.use14bit = IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC);
-  g_cfg.hysteresis_cc = CONFIG_MIDAL_FILTER_HYST;
-  uint32_t hyst_steps = CONFIG_MIDAL_FILTER_HYST;
-  if (hyst_steps > 32U) {
-    hyst_steps = 32U;
-  }
-  g_cfg.hysteresis_lsb = hyst_steps * (g_cfg.use14bit ? 128U : 1U);
-
-  /* Base alpha: either manual from Kconfig or auto-computed below */
-#if !defined(CONFIG_MIDAL_FILTER_ALPHA_AUTO)
-  g_cfg.alpha = (float)CONFIG_MIDAL_FILTER_ALPHA_MILLIPCT / 100000.0F;
-  if (g_cfg.alpha < 0.0001F)
-    g_cfg.alpha = 0.0001F;
-  if (g_cfg.alpha > 1.0F)
-    g_cfg.alpha = 1.0F;
-  float a = g_cfg.alpha;
+/* Dead band accounting of the live filter, per pedal */
+static atomic_t s_nz_var[MIDAL_NUM_PEDALS];
+static atomic_t s_nz_hyst_rest[MIDAL_NUM_PEDALS];
+static atomic_t s_nz_moving[MIDAL_NUM_PEDALS];
+static atomic_t s_rest_ms[MIDAL_NUM_PEDALS];
+static atomic_t s_rest_events[MIDAL_NUM_PEDALS];
+static atomic_t s_motion_events[MIDAL_NUM_PEDALS];
+static atomic_t s_motion_steps[MIDAL_NUM_PEDALS];
+static uint32_t s_rest_us[MIDAL_NUM_PEDALS]; /* Below 1 ms, not yet counted */
+
+static inline uint32_t filter_cycles(void) {
+#if IS_ENABLED(CONFIG_CORTEX_M_DWT)
+  return DWT->CYCCNT;
 #else
-  float a = g_cfg.alpha; /* may be overwritten by AUTO block below */
+  return k_cycle_get_32();
 #endif
+}
 
-#if defined(CONFIG_MIDAL_FILTER_ALPHA_AUTO)
-  /* α = 1 - exp( -Ts / τ ) where Ts = 1/fs; τ in ms
-   * (CONFIG_MIDAL_FILTER_TAU_MS) */
-  const uint32_t fs = CONFIG_MIDAL_POLL_HZ;
-  const uint32_t tau_ms =
-#ifdef CONFIG_MIDAL_FILTER_TAU_MS
-      CONFIG_MIDAL_FILTER_TAU_MS;
-#else
-      5; /* default 5 ms if not provided */
-#endif
-  if (fs > 0) {
-    const float Ts = 1.0F / (float)fs;
-    const float tau = (float)tau_ms / 1000.0F;
-    float aa = 1.0F - expf(-Ts / tau);
-    aa = aa < 0.0001F ? 0.0001F : aa;
-    aa = aa > 1.0F ? 1.0F : aa;
-    a = g_cfg.alpha = aa;
+static void filter_cycles_init(void) {
+#if IS_ENABLED(CONFIG_CORTEX_M_DWT)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+static int32_t alpha_to_q31(float a) {
+  float q = (a * 2147483648.0F) + 0.5F;
+  return (q >= 2147483647.0F) ? INT32_MAX : (int32_t)q;
+}
+
+static void cal_update_span(filter_bank_t *b, size_t i) {
+  uint16_t span = (b->cal_max[i] > b->cal_min[i])
+                      ? (uint16_t)(b->cal_max[i] - b->cal_min[i])
+                      : 0U;
+  if (span < CAL_MIN_SPAN) {
+    span = CAL_MIN_SPAN;
+  }
+  b->span[i] = span;
+  b->recip[i] = (uint32_t)((BIT64(31) + (span / 2U)) / span);
+
+  if (IS_ENABLED(CONFIG_MIDAL_FILTER_LUT) && b->live) {
+    pedal_curve_request(i, b->cal_min[i], span);
+  }
+  if (IS_ENABLED(CONFIG_MIDAL_CAL_PERSIST) && b->live) {
+    pedal_calstore_notify();
+  }
+}
+
+static void cal_reset(filter_bank_t *b, size_t i) {
+  b->cal_min[i] = CAL_DEFAULT_MIN; // 0.5V starting point
+  b->cal_max[i] = PEDAL_RAW_MAX;   // Will be set on first reading
+  b->cal_init[i] = false;
+  cal_update_span(b, i);
+}
+
+/* Dynamic calibration with noise margin */
+static inline void cal_track(filter_bank_t *b, size_t i, uint16_t raw) {
+  bool moved = true;
+
+  if (!b->cal_init[i]) {
+    /* First sample defines provisional upper bound (pedal at rest/up) */
+    b->cal_max[i] = raw;
+    b->cal_init[i] = true;
   } else {
-    a = g_cfg.alpha = 1.0F; /* degenerate: no smoothing if fs is 0 */
+    moved = false;
+    if ((int32_t)raw + CAL_MARGIN < (int32_t)b->cal_min[i]) {
+      b->cal_min[i] = raw;
+      moved = true;
+    }
+    if ((int32_t)raw > (int32_t)b->cal_max[i] + CAL_MARGIN) {
+      b->cal_max[i] = raw;
+      moved = true;
+    }
   }
-#else
-  a = g_cfg.alpha;
-#endif
 
-  /* Asymmetric EMA: faster attack, softer release when enabled */
-#if defined(CONFIG_MIDAL_FILTER_ASYM)
-  /* Ensure attack is at least 0.40, release at most 0.20 by default */
-  g_cfg.s_alpha_up =
-#ifdef CONFIG_MIDAL_FILTER_ALPHA_UP_MIN_MILLIPCT
-      fmaxf(a, (float)CONFIG_MIDAL_FILTER_ALPHA_UP_MIN_MILLIPCT / 100000.0F);
-#else
-      fmaxf(a, 0.40F);
-#endif
+  if (moved) {
+    cal_update_span(b, i);
+  }
+}
 
-  g_cfg.s_alpha_down =
-#ifdef CONFIG_MIDAL_FILTER_ALPHA_DOWN_MAX_MILLIPCT
-      fminf(a, (float)CONFIG_MIDAL_FILTER_ALPHA_DOWN_MAX_MILLIPCT / 100000.0F);
-#else
-      fminf(a, 0.20F);
-#endif
+/* Start from the calibration saved by a previous run, if any */
+static void cal_restore(filter_bank_t *b) {
+  pedal_calibration_t cal[MIDAL_NUM_PEDALS] = {0};
+
+  if (pedal_calstore_load(cal) <= 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    if (cal[i].initialized) {
+      b->cal_min[i] = cal[i].min_adc;
+      b->cal_max[i] = cal[i].max_adc;
+      b->cal_init[i] = true;
+      cal_update_span(b, i);
+    }
+  }
+}
+
+static void bank_reset(filter_bank_t *b, const pedal_filter_cfg_t *cfg) {
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    cal_reset(b, i);
+    b->ema[i] = 0.0F;
+    b->ema_q30[i] = 0;
+    b->speed[i] = 0.0F;
+    b->speed_q30[i] = 0;
+    b->pr_pos[i] = 0.0F;
+    b->pr_vel[i] = 0.0F;
+    b->pr_pos_q30[i] = 0;
+    b->pr_vel_q30[i] = 0;
+    b->pr_out[i] = 0.0F;
+    b->pr_out_q30[i] = 0;
+    b->nz_ref[i] = 0;
+    b->nz_sum[i] = 0;
+    b->nz_sq[i] = 0U;
+    b->nz_var[i] = NOISE_VAR_UNSET;
+    b->nz_prev_var[i] = 0U;
+    b->nz_steps[i] = 0U;
+    b->nz_moves[i] = 0U;
+    b->nz_events[i] = 0U;
+    b->nz_prev_events[i] = 0U;
+    b->hyst_rest[i] = cfg->hysteresis_lsb[i];
+    b->nz_n[i] = 0U;
+    b->nz_still[i] = 0U;
+    b->moving[i] = false;
+    b->last_out[i] = LAST_OUT_UNSET;
+  }
+}
+
+/*
+ * Re-express a per-sample EMA coefficient derived at fs0 for another sample
+ * rate, keeping its time constant: 1 - a' = (1 - a)^(fs0/fs).
+ */
+static float alpha_for_rate(float a, uint32_t fs0, uint32_t fs) {
+  if (a >= 1.0F || fs == fs0) {
+    return a;
+  }
+  float aa = 1.0F - powf(1.0F - a, (float)fs0 / (float)fs);
+  return aa < 0.0001F ? 0.0001F : aa;
+}
+
+/* One-pole low-pass coefficient for cutoff fc: a = w / (w + fs), w = 2*pi*fc */
+static float lowpass_alpha(float fc_hz, uint32_t fs) {
+  const float w = TWO_PI * fc_hz;
+  return w / (w + (float)fs);
+}
+
+static void one_euro_for_rate(pedal_filter_cfg_t *cfg, uint32_t fs_hz) {
+  cfg->fs_hz = fs_hz;
+  cfg->oe_alpha_d = lowpass_alpha(
+      (float)CONFIG_MIDAL_FILTER_1E_DCUTOFF_MHZ / 1000.0F, fs_hz);
+  cfg->q_oe_alpha_d = alpha_to_q31(cfg->oe_alpha_d);
+  cfg->q_oe_k = (uint32_t)((TWO_PI * 68719476736.0F / (1000.0F * fs_hz)) +
+                           0.5F);
+}
+
+/*
+ * Alpha-beta tracker gains (per sample) and the lead and speed gate for the
+ * rate. beta = alpha^2 / (2 - alpha) (Benedict-Bordner) keeps the tracker
+ * critically damped enough not to ring on a stop.
+ */
+static void predict_for_rate(pedal_filter_cfg_t *cfg, uint32_t fs_hz) {
+  const float a = (float)CONFIG_MIDAL_PREDICT_ALPHA_MILLI / 1000.0F;
+
+  cfg->pr_alpha = a;
+  cfg->pr_beta = (a * a) / (2.0F - a);
+  cfg->pr_lead = (float)CONFIG_MIDAL_PREDICT_LEAD_US * (float)fs_hz / 1e6F;
+  cfg->pr_gate = (float)CONFIG_MIDAL_PREDICT_GATE_PCT_S / (100.0F * fs_hz);
+  cfg->q_pr_alpha = alpha_to_q31(cfg->pr_alpha);
+  cfg->q_pr_beta = alpha_to_q31(cfg->pr_beta);
+  cfg->q_pr_lead = (uint32_t)((cfg->pr_lead * 65536.0F) + 0.5F);
+  cfg->q_pr_gate = (int32_t)((cfg->pr_gate * (float)Q30_ONE) + 0.5F);
+}
+
+/* Base EMA alpha at fs: α = 1 − exp(−Ts/τ), or the fixed alpha when τ is 0 */
+static float tuning_alpha(const pedal_tuning_t *t, uint32_t fs) {
+  float a;
+
+  if (t->tau_ms > 0U) {
+    a = 1.0F - expf(-1000.0F / ((float)fs * (float)t->tau_ms));
+  } else {
+    a = (float)t->alpha_millipct / 100000.0F;
+  }
+  return CLAMP(a, 0.0001F, 1.0F);
+}
+
+/*
+ * Coefficients of a parameter set at output rate fs_hz. Attack and release
+ * bounds apply at the set's poll rate; other rates keep the time constants.
+ */
+static void cfg_build(pedal_filter_cfg_t *cfg, const pedal_filter_params_t *p,
+                      uint32_t fs_hz) {
+  *cfg = (pedal_filter_cfg_t){.use14bit = IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC)};
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    const pedal_tuning_t *t = &p->pedal[i];
+    const float a = tuning_alpha(t, p->poll_hz);
+    /* Asymmetric EMA: faster attack, softer release */
+    const float up = fmaxf(a, (float)t->up_min_millipct / 100000.0F);
+    const float down =
+        fmaxf(fminf(a, (float)t->down_max_millipct / 100000.0F), 0.0001F);
+
+    cfg->s_alpha_up[i] = alpha_for_rate(up, p->poll_hz, fs_hz);
+    cfg->s_alpha_down[i] = alpha_for_rate(down, p->poll_hz, fs_hz);
+    cfg->q_alpha_up[i] = alpha_to_q31(cfg->s_alpha_up[i]);
+    cfg->q_alpha_down[i] = alpha_to_q31(cfg->s_alpha_down[i]);
+    cfg->hysteresis_lsb[i] =
+        (uint16_t)(MIN(t->hyst_cc, 32U) * (cfg->use14bit ? 128U : 1U));
+    cfg->invert[i] = t->invert;
+  }
+
+  one_euro_for_rate(cfg, fs_hz);
+  predict_for_rate(cfg, fs_hz);
+}
+
+static void coef_build(filter_coef_set_t *set, const pedal_filter_params_t *p) {
+  set->params = *p;
+  cfg_build(&set->active, p, p->poll_hz);
+#if IS_ENABLED(CONFIG_MIDAL_ADAPTIVE_RATE)
+  cfg_build(&set->idle, p, CONFIG_MIDAL_IDLE_POLL_HZ);
 #else
-  /* Symmetric EMA */
-  g_cfg.s_alpha_up = g_cfg.s_alpha_down = a;
+  set->idle = set->active;
 #endif
+}
+
+static bool params_valid(const pedal_filter_params_t *p) {
+  if (p->poll_hz < PEDAL_FILTER_POLL_HZ_MIN ||
+      p->poll_hz > PEDAL_FILTER_POLL_HZ_MAX) {
+    return false;
+  }
 
-  for (int i = 0; i < MIDAL_NUM_PEDALS; i++) {
-    s_state[i] = 0.0F;
-    s_last_out[i] = -999;
-    s_calibration[i].min_adc = 500;  // 0.5V starting point
-    s_calibration[i].max_adc = 4095; // Will be set on first reading
-    s_calibration[i].initialized = false;
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    const pedal_tuning_t *t = &p->pedal[i];
+
+    if (t->tau_ms > PEDAL_FILTER_TAU_MS_MAX ||
+        t->alpha_millipct > 100000U || t->up_min_millipct > 100000U ||
+        t->down_max_millipct > 100000U ||
+        t->hyst_cc > PEDAL_FILTER_HYST_CC_MAX) {
+      return false;
+    }
   }
+  return true;
 }
 
-uint16_t pedal_filter_apply(uint8_t id, uint16_t raw12) {
-  if (id >= MIDAL_NUM_PEDALS) {
-    id = 0;
+void pedal_filter_default_params(pedal_filter_params_t *p) {
+  if (p == NULL) {
+    return;
   }
-  if (raw12 > 4095U) {
-    raw12 = 4095U;
+
+  *p = (pedal_filter_params_t){.poll_hz = CONFIG_MIDAL_POLL_HZ};
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    p->pedal[i] = (pedal_tuning_t){
+        .tau_ms = IS_ENABLED(CONFIG_MIDAL_FILTER_ALPHA_AUTO)
+                      ? CONFIG_MIDAL_FILTER_TAU_MS
+                      : 0U,
+        .alpha_millipct = CONFIG_MIDAL_FILTER_ALPHA_MILLIPCT,
+        .up_min_millipct = IS_ENABLED(CONFIG_MIDAL_FILTER_ASYM)
+                               ? CONFIG_MIDAL_FILTER_ALPHA_UP_MIN_MILLIPCT
+                               : 0U,
+        .down_max_millipct = IS_ENABLED(CONFIG_MIDAL_FILTER_ASYM)
+                                 ? CONFIG_MIDAL_FILTER_ALPHA_DOWN_MAX_MILLIPCT
+                                 : 100000U,
+        .hyst_cc = CONFIG_MIDAL_FILTER_HYST,
+        .invert = IS_ENABLED(CONFIG_MIDAL_INVERT_POLARITY),
+    };
   }
-  /* raw12 is unsigned, so no need to clamp below 0 */
+}
 
-  pedal_calibration_t *cal = &s_calibration[id];
+/* Response tables carry the polarity: rebuild those whose polarity moved */
+static void coef_sync_curves(const pedal_filter_params_t *old,
+                             const pedal_filter_params_t *p) {
+  if (!IS_ENABLED(CONFIG_MIDAL_FILTER_LUT)) {
+    return;
+  }
 
-  /* --- Dynamic calibration with noise margin --- */
-  if (!cal->initialized) {
-    /* First sample defines provisional upper bound (pedal at rest/up) */
-    cal->max_adc = raw12;
-    // cal->min_adc = raw12; /* will move down as we discover lower values */
-    cal->initialized = true;
-  } else {
-    if ((uint16_t)(raw12 + CAL_MARGIN) < cal->min_adc) {
-      cal->min_adc = raw12;
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    if (old->pedal[i].invert != p->pedal[i].invert) {
+      (void)pedal_curve_set_invert(i, p->pedal[i].invert);
     }
-    if (raw12 > (uint16_t)(cal->max_adc + CAL_MARGIN)) {
-      cal->max_adc = raw12;
+  }
+}
+
+int pedal_filter_configure(const pedal_filter_params_t *p) {
+  if (p == NULL || !params_valid(p)) {
+    return -EINVAL;
+  }
+
+  k_mutex_lock(&s_coef_lock, K_FOREVER);
+
+  /* The spare may be the set the sampling thread read before the last swap */
+  for (uint32_t waited = 0U; s_coef_swap_pending; waited++) {
+    if (atomic_get(&s_coef_epoch) != s_coef_swap_epoch) {
+      s_coef_swap_pending = false;
+    } else if (waited >= COEF_RELEASE_MS) {
+      k_mutex_unlock(&s_coef_lock);
+      return -EBUSY; /* Sampling thread stalled */
+    } else {
+      k_sleep(K_MSEC(1));
     }
   }
 
-  /* Compute safe span */
-  uint16_t span = (cal->max_adc > cal->min_adc)
-                      ? (uint16_t)(cal->max_adc - cal->min_adc)
-                      : 0U;
-  if (span < CAL_MIN_SPAN) {
-    span = CAL_MIN_SPAN;
+  const pedal_filter_params_t old =
+      ((const filter_coef_set_t *)atomic_ptr_get(&s_coef))->params;
+
+  coef_build(s_coef_spare, p);
+  s_coef_spare = atomic_ptr_set(&s_coef, s_coef_spare);
+  s_coef_swap_epoch = atomic_get(&s_coef_epoch);
+  s_coef_swap_pending = true;
+  coef_sync_curves(&old, p);
+
+  k_mutex_unlock(&s_coef_lock);
+  return 0;
+}
+
+void pedal_filter_get_params(pedal_filter_params_t *p) {
+  if (p == NULL) {
+    return;
   }
 
-  /* Normalize to 0..1 with current [min..max] */
-  int32_t num = (int32_t)raw12 - (int32_t)cal->min_adc;
-  if (num < 0) {
-    num = 0;
+  /* Builders only rewrite the spare, and only under the lock */
+  k_mutex_lock(&s_coef_lock, K_FOREVER);
+  *p = ((const filter_coef_set_t *)atomic_ptr_get(&s_coef))->params;
+  k_mutex_unlock(&s_coef_lock);
+}
+
+uint32_t pedal_filter_poll_hz(void) {
+  return (uint32_t)atomic_get(&s_poll_hz);
+}
+
+void pedal_filter_set_rate(uint32_t fs_hz) { s_fs_hz = fs_hz; }
+
+void pedal_filter_init(void) {
+  pedal_filter_params_t params;
+
+  /* Kconfig defaults, overridden by the saved parameter set if any */
+  pedal_filter_default_params(&params);
+  if (IS_ENABLED(CONFIG_MIDAL_PARAMS)) {
+    pedal_filter_params_t saved = params;
+
+    if (pedal_params_load(&saved) > 0 && params_valid(&saved)) {
+      params = saved;
+    }
+  }
+
+  /* The sampling thread is not running yet: build in place */
+  coef_build(&s_coef_pool[0], &params);
+  atomic_ptr_set(&s_coef, &s_coef_pool[0]);
+  s_coef_spare = &s_coef_pool[1];
+  s_coef_swap_pending = false;
+  s_fs_hz = params.poll_hz;
+  atomic_set(&s_poll_hz, (atomic_val_t)params.poll_hz);
+
+  const filter_coef_set_t *set = &s_coef_pool[0];
+
+  s_bank.live = false;
+  bank_reset(&s_bank, &set->active);
+  if (IS_ENABLED(CONFIG_MIDAL_CAL_PERSIST)) {
+    cal_restore(&s_bank);
+  }
+  if (IS_ENABLED(CONFIG_MIDAL_FILTER_LUT)) {
+    pedal_curve_init(s_bank.cal_min, s_bank.span, set->active.invert);
+  }
+  s_bank.live = true;
+
+  filter_cycles_init();
+  atomic_set(&s_scans, 0);
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    atomic_set(&s_nz_var[i], (atomic_val_t)NOISE_VAR_UNSET);
+    atomic_set(&s_nz_hyst_rest[i], (atomic_val_t)set->active.hysteresis_lsb[i]);
+    atomic_set(&s_nz_moving[i], 0);
+    atomic_set(&s_rest_ms[i], 0);
+    atomic_set(&s_rest_events[i], 0);
+    atomic_set(&s_motion_events[i], 0);
+    atomic_set(&s_motion_steps[i], 0);
+    s_rest_us[i] = 0U;
+  }
+}
+
+/* floor(sqrt(v)), block rate only */
+static uint32_t isqrt32(uint32_t v) {
+  uint32_t r = 0U;
+
+  for (uint32_t bit = BIT(30); bit != 0U; bit >>= 2) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+  }
+  return r;
+}
+
+/*
+ * Dead band for a resting pedal: one LSB for the quantizer plus K sigma of
+ * the pre-quantization noise, so the output cannot flip between two codes.
+ */
+static uint16_t noise_hyst_rest(uint32_t var_q16, int32_t h_max) {
+  uint32_t k_sigma = (isqrt32(var_q16) *
+                      (uint32_t)CONFIG_MIDAL_FILTER_HYST_NOISE_K_TENTHS) /
+                     10U;
+  int32_t h = 1 + (int32_t)DIV_ROUND_UP(k_sigma, BIT(NOISE_FRAC_BITS));
+
+  return (uint16_t)CLAMP(h, CONFIG_MIDAL_FILTER_HYST_MIN_LSB, h_max);
+}
+
+/* Classify the block that just ended; learn the noise from resting ones */
+static void noise_block_end(filter_bank_t *b, const pedal_filter_cfg_t *cfg,
+                            size_t i, int32_t h_max) {
+  const int32_t mean = b->nz_sum[i] / (int32_t)NOISE_BLOCK;
+  const uint64_t m2 = (uint64_t)((int64_t)mean * mean);
+  const uint64_t msq = b->nz_sq[i] >> NOISE_BLOCK_SHIFT;
+  const uint64_t var = (msq > m2) ? (msq - m2) : 0U;
+  const bool still = m2 <= (4U * var) + NOISE_DRIFT_FLOOR;
+
+  b->nz_ref[i] += mean;
+  b->nz_sum[i] = 0;
+  b->nz_sq[i] = 0U;
+  b->nz_n[i] = 0U;
+
+  /* The previous block rested: learn from it and restore the dead band */
+  b->nz_still[i] = still ? MIN(b->nz_still[i] + 1U, NOISE_REST_BLOCKS) : 0U;
+  const bool rest = b->nz_still[i] >= NOISE_REST_BLOCKS;
+  if (rest) {
+    const uint32_t v = b->nz_prev_var[i];
+
+    b->nz_var[i] = (b->nz_var[i] == NOISE_VAR_UNSET)
+                       ? v
+                       : (uint32_t)((int64_t)b->nz_var[i] +
+                                    (((int64_t)v - b->nz_var[i]) / 4));
+    b->hyst_rest[i] = noise_hyst_rest(b->nz_var[i], h_max);
+    b->moving[i] = false;
+  }
+
+  if (b->live) {
+    /* Changes through the rest dead band elsewhere are starts of moves */
+    if (rest) {
+      uint32_t us = s_rest_us[i] + ((NOISE_BLOCK * 1000000U) / cfg->fs_hz);
+      atomic_add(&s_rest_ms[i], (atomic_val_t)(us / 1000U));
+      s_rest_us[i] = us % 1000U;
+      atomic_add(&s_rest_events[i], (atomic_val_t)b->nz_prev_events[i]);
+    }
+    atomic_add(&s_motion_events[i], (atomic_val_t)b->nz_moves[i]);
+    atomic_add(&s_motion_steps[i], (atomic_val_t)b->nz_steps[i]);
+    atomic_set(&s_nz_var[i], (atomic_val_t)b->nz_var[i]);
+    atomic_set(&s_nz_hyst_rest[i], (atomic_val_t)b->hyst_rest[i]);
+    atomic_set(&s_nz_moving[i], b->moving[i] ? 1 : 0);
+  }
+  b->nz_prev_var[i] = (uint32_t)MIN(var, (uint64_t)UINT32_MAX - 1U);
+  b->nz_prev_events[i] = b->nz_events[i];
+  b->nz_events[i] = 0U;
+  b->nz_moves[i] = 0U;
+  b->nz_steps[i] = 0U;
+}
+
+/*
+ * Noise-adaptive dead band for one sample x (output in 1/256 LSB, before
+ * quantization): the learned rest value, or the minimum once the output has
+ * moved, until the pedal rests again. h_max until the noise is known.
+ */
+static inline int32_t noise_hyst(filter_bank_t *b,
+                                 const pedal_filter_cfg_t *cfg, size_t i,
+                                 int32_t x, int32_t h_max) {
+  if (h_max == 0) {
+    return 0;
+  }
+  if (b->last_out[i] == LAST_OUT_UNSET) {
+    b->nz_ref[i] = x;
+  }
+
+  const int32_t d = x - b->nz_ref[i];
+  b->nz_sum[i] += d;
+  b->nz_sq[i] += (uint64_t)((int64_t)d * d);
+  if (++b->nz_n[i] == NOISE_BLOCK) {
+    noise_block_end(b, cfg, i, h_max);
+  }
+
+  return b->moving[i] ? MIN(CONFIG_MIDAL_FILTER_HYST_MIN_LSB, h_max)
+                      : MIN((int32_t)b->hyst_rest[i], h_max);
+}
+
+/* An output change past the dead band: the pedal is (still) moving */
+static inline void noise_event(filter_bank_t *b, size_t i, int32_t prev,
+                               int32_t q) {
+  if (prev == LAST_OUT_UNSET || q == prev) {
+    return;
+  }
+  if (b->moving[i]) {
+    b->nz_moves[i]++;
+    b->nz_steps[i] += (uint32_t)abs(q - prev);
+  } else {
+    b->nz_events[i]++;
+    b->moving[i] = true;
+  }
+}
+
+/*
+ * One Euro filter coefficient: the cutoff rises from the minimum with the
+ * smoothed speed of the pedal (change per sample, times fs for per second).
+ */
+static inline float one_euro_alpha_f(filter_bank_t *b,
+                                     const pedal_filter_cfg_t *cfg, size_t i,
+                                     float v) {
+  const float fs = (float)cfg->fs_hz;
+
+  b->speed[i] += cfg->oe_alpha_d * ((v - b->ema[i]) - b->speed[i]);
+  float fc = ((float)ONE_EURO_MIN_CUTOFF_MHZ +
+              ((float)ONE_EURO_BETA_MILLI * fabsf(b->speed[i]) * fs)) /
+             1000.0F;
+  return lowpass_alpha(fminf(fc, fs / 2.0F), cfg->fs_hz);
+}
+
+/*
+ * Predictor: alpha-beta tracker on the smoothed position z, extrapolated by
+ * the lead time. Safeguards:
+ * - below the speed gate z passes through, so rest and the endpoint snap
+ *   are untouched;
+ * - while the pedal decelerates against the model (a stop coming), no new
+ *   lead is added: the last output holds until z catches up with it, so a
+ *   stop does not overshoot and the output never steps back;
+ * - the result never leaves 0..1.
+ */
+static inline float predict_f(filter_bank_t *b, const pedal_filter_cfg_t *cfg,
+                              size_t i, float z) {
+  if (b->last_out[i] == LAST_OUT_UNSET) {
+    b->pr_pos[i] = z;
+    b->pr_vel[i] = 0.0F;
+    b->pr_out[i] = z;
+    return z;
   }
-  if (num > (int32_t)span) {
-    num = (int32_t)span;
+
+  const float xp = b->pr_pos[i] + b->pr_vel[i];
+  const float r = z - xp;
+  const float v = b->pr_vel[i] + (cfg->pr_beta * r);
+  b->pr_pos[i] = xp + (cfg->pr_alpha * r);
+  b->pr_vel[i] = v;
+
+  float y;
+  if (fabsf(v) < cfg->pr_gate) {
+    y = z;
+  } else if (r * v < 0.0F) {
+    y = ((b->pr_out[i] - z) * v > 0.0F) ? b->pr_out[i] : z;
+  } else {
+    y = CLAMP(b->pr_pos[i] + (v * cfg->pr_lead), 0.0F, 1.0F);
   }
-  float v = (float)num / (float)span; /* 0..1 */
+  b->pr_out[i] = y;
+  return y;
+}
+
+/* Calibrated position 0..1, endpoint-snapped and polarity-corrected */
+static inline float norm_float(const filter_bank_t *b,
+                               const pedal_filter_cfg_t *cfg, size_t i,
+                               uint16_t r) {
+  /* Normalize to 0..1 with current [min..max] */
+  int32_t num = CLAMP((int32_t)r - (int32_t)b->cal_min[i], 0,
+                      (int32_t)b->span[i]);
+  float v = (float)num / (float)b->span[i]; /* 0..1 */
 
   /* Endpoint hold: snap very close values to exact 0/1 to avoid chatter */
-  const float eps = g_cfg.use14bit ? (1.0F / 16383.0F) : (1.0F / 127.0F);
+  const float eps = cfg->use14bit ? (1.0F / 16383.0F) : (1.0F / 127.0F);
   if (v < eps) {
     v = 0.0F;
   } else if (v > 1.0F - eps) {
     v = 1.0F;
   }
 
-#if IS_ENABLED(CONFIG_MIDAL_INVERT_POLARITY)
-  v = 1.0F - v;
+  if (cfg->invert[i]) {
+    v = 1.0F - v;
+  }
+  return v;
+}
+
+/* Reference kernel: float normalization, EMA and quantization */
+static __maybe_unused void filter_float_run(filter_bank_t *b,
+                                            const uint16_t raw[],
+                                            uint16_t out[],
+                                            const filter_opts_t *opt) {
+  const pedal_filter_cfg_t *cfg = opt->cfg;
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    /* raw is unsigned, so no need to clamp below 0 */
+    uint16_t r = MIN(raw[i], (uint16_t)PEDAL_RAW_MAX);
+
+    cal_track(b, i, r);
+
+    float v;
+    if (IS_ENABLED(CONFIG_MIDAL_FILTER_LUT) && b->live) {
+      v = (float)pedal_curve_lookup(pedal_curve_lut(i), r) *
+          (1.0F / (float)PEDAL_CURVE_ONE);
+    } else {
+      v = norm_float(b, cfg, i, r);
+    }
+    if (b->last_out[i] == LAST_OUT_UNSET) {
+      /* Start settled: with a restored calibration the first CC is right */
+      b->ema[i] = v;
+    }
+
+    float alpha;
+    if (opt->one_euro) {
+      alpha = one_euro_alpha_f(b, cfg, i, v);
+    } else {
+      alpha = (v > b->ema[i]) ? cfg->s_alpha_up[i] : cfg->s_alpha_down[i];
+    }
+    b->ema[i] = (alpha * v) + ((1.0F - alpha) * b->ema[i]);
+    float y = opt->predict ? predict_f(b, cfg, i, b->ema[i]) : b->ema[i];
+    uint16_t span_out = cfg->use14bit ? 16383 : 127;
+    int32_t q = (int32_t)((y * (float)span_out) + 0.5F);
+    int32_t h = opt->hyst ? (int32_t)cfg->hysteresis_lsb[i] : 0;
+    if (opt->hyst_auto) {
+      h = noise_hyst(b, cfg, i,
+                     (int32_t)((y * (float)span_out * 256.0F) + 0.5F), h);
+    }
+    if (b->last_out[i] != LAST_OUT_UNSET) {
+      if (abs(q - b->last_out[i]) < h) {
+        q = b->last_out[i];
+      }
+    }
+    if (opt->hyst_auto) {
+      noise_event(b, i, b->last_out[i], q);
+    }
+    b->last_out[i] = (int16_t)q;
+    out[i] = (uint16_t)q;
+  }
+}
+
+/*
+ * Hysteresis for all channels: keep the last output unless the new one moved
+ * by at least h[i]. Pairs of channels go through packed 16-bit
+ * lanes on cores with the DSP extension.
+ */
+static __maybe_unused void filter_fixed_hysteresis(filter_bank_t *b,
+                                                   const int16_t q[],
+                                                   uint16_t out[],
+                                                   const int16_t h[]) {
+  size_t i = 0;
+
+#if FILTER_USE_SIMD
+  for (; i + 1U < MIDAL_NUM_PEDALS; i += 2U) {
+    uint32_t hm1 = (uint16_t)(h[i] - 1) |
+                   ((uint32_t)(uint16_t)(h[i + 1U] - 1) << 16);
+    uint32_t qq = (uint16_t)q[i] | ((uint32_t)(uint16_t)q[i + 1U] << 16);
+    uint32_t last = (uint16_t)b->last_out[i] |
+                    ((uint32_t)(uint16_t)b->last_out[i + 1U] << 16);
+    /* Saturating so the LAST_OUT_UNSET sentinel reads as a large move */
+    uint32_t d = __QSUB16(qq, last);
+    (void)__SSUB16(hm1, d); /* GE per lane where d <= h - 1 */
+    uint32_t r = __SEL(last, qq);
+    (void)__SADD16(hm1, d); /* GE per lane where d >= 1 - h */
+    r = __SEL(r, qq);
+    b->last_out[i] = (int16_t)(r & 0xFFFFU);
+    b->last_out[i + 1U] = (int16_t)(r >> 16);
+  }
+#endif
+
+  for (; i < MIDAL_NUM_PEDALS; i++) {
+    int32_t d = (int32_t)q[i] - (int32_t)b->last_out[i];
+    if (d >= h[i] || d <= -h[i]) {
+      b->last_out[i] = q[i];
+    }
+  }
+
+  for (i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    out[i] = (uint16_t)b->last_out[i];
+  }
+}
+
+/* num / den in Q31 for num < den < 2^23: three 8-bit long-division steps */
+static inline int32_t q31_ratio(uint32_t num, uint32_t den) {
+  uint32_t q = 0U;
+
+  for (int k = 0; k < 3; k++) {
+    num <<= 8;
+    uint32_t d = num / den;
+    num -= d * den;
+    q = (q << 8) | d;
+  }
+  return (int32_t)(q << 7);
+}
+
+/* Fixed-point one_euro_alpha_f(): a = r / (1 + r), r = 2*pi*fc/fs in Q20 */
+static inline int32_t one_euro_alpha_q(filter_bank_t *b,
+                                       const pedal_filter_cfg_t *cfg, size_t i,
+                                       int32_t v) {
+  const uint32_t fs = cfg->fs_hz;
+
+  b->speed_q30[i] += (int32_t)(((int64_t)((v - b->ema_q30[i]) -
+                                          b->speed_q30[i]) *
+                                cfg->q_oe_alpha_d) >>
+                               31);
+  uint64_t fc_mhz =
+      ONE_EURO_MIN_CUTOFF_MHZ +
+      (((uint64_t)abs(b->speed_q30[i]) * fs * ONE_EURO_BETA_MILLI) >> 30);
+  fc_mhz = MIN(fc_mhz, (uint64_t)fs * 500U);
+
+  uint32_t r = (uint32_t)((fc_mhz * cfg->q_oe_k) >> 16);
+  return q31_ratio(r, r + BIT(20));
+}
+
+/* a and b non-zero with opposite signs */
+static inline bool opposite_sign(int64_t a, int32_t b) {
+  return (a < 0) ? (b > 0) : ((a > 0) && (b < 0));
+}
+
+/* predict_f() in Q30 */
+static inline int32_t predict_q(filter_bank_t *b, const pedal_filter_cfg_t *cfg,
+                                size_t i, int32_t z) {
+  if (b->last_out[i] == LAST_OUT_UNSET) {
+    b->pr_pos_q30[i] = z;
+    b->pr_vel_q30[i] = 0;
+    b->pr_out_q30[i] = z;
+    return z;
+  }
+
+  const int32_t xp = b->pr_pos_q30[i] + b->pr_vel_q30[i];
+  const int64_t r = (int64_t)z - xp;
+  const int32_t v =
+      b->pr_vel_q30[i] + (int32_t)((r * cfg->q_pr_beta) >> 31);
+  b->pr_pos_q30[i] = xp + (int32_t)((r * cfg->q_pr_alpha) >> 31);
+  b->pr_vel_q30[i] = v;
+
+  int32_t y;
+  if (abs(v) < cfg->q_pr_gate) {
+    y = z;
+  } else if (opposite_sign(r, v)) {
+    y = opposite_sign((int64_t)z - b->pr_out_q30[i], v) ? b->pr_out_q30[i]
+                                                         : z;
+  } else {
+    int64_t e = (int64_t)b->pr_pos_q30[i] +
+                (((int64_t)v * cfg->q_pr_lead) >> 16);
+    y = (int32_t)CLAMP(e, 0, (int64_t)Q30_ONE);
+  }
+  b->pr_out_q30[i] = y;
+  return y;
+}
+
+/* norm_float() in Q30, with no divide */
+static inline int32_t norm_q30(const filter_bank_t *b,
+                               const pedal_filter_cfg_t *cfg, size_t i,
+                               uint16_t r) {
+  /* num <= span, so num * round(2^31 / span) stays below 2^32 */
+  uint32_t num = (uint32_t)CLAMP((int32_t)r - (int32_t)b->cal_min[i], 0,
+                                 (int32_t)b->span[i]);
+  int32_t v = (int32_t)MIN((num * b->recip[i]) >> 1, (uint32_t)Q30_ONE);
+
+  if (v < Q30_EPS) {
+    v = 0;
+  } else if (v > Q30_ONE - Q30_EPS) {
+    v = Q30_ONE;
+  }
+
+  if (cfg->invert[i]) {
+    v = Q30_ONE - v;
+  }
+  return v;
+}
+
+/*
+ * Fixed-point kernel: same chain as filter_float_run() with the normalized
+ * value and EMA state in Q30 and coefficients in Q31. The EMA mode needs no
+ * divide per sample (the reciprocal of the span is refreshed only when
+ * calibration moves).
+ */
+static __maybe_unused void filter_fixed_run(filter_bank_t *b,
+                                            const uint16_t raw[],
+                                            uint16_t out[],
+                                            const filter_opts_t *opt) {
+  int16_t q[MIDAL_NUM_PEDALS];
+  int16_t h[MIDAL_NUM_PEDALS];
+  int16_t prev[MIDAL_NUM_PEDALS];
+  const pedal_filter_cfg_t *cfg = opt->cfg;
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    uint16_t r = MIN(raw[i], (uint16_t)PEDAL_RAW_MAX);
+
+    cal_track(b, i, r);
+
+    int32_t v;
+    if (IS_ENABLED(CONFIG_MIDAL_FILTER_LUT) && b->live) {
+      /* Q16 with 0xFFFF = 1.0 to Q30 */
+      uint32_t y = pedal_curve_lookup(pedal_curve_lut(i), r);
+      v = (int32_t)((y << 14) + (y >> 2) + (y >> 15));
+    } else {
+      v = norm_q30(b, cfg, i, r);
+    }
+    if (b->last_out[i] == LAST_OUT_UNSET) {
+      b->ema_q30[i] = v;
+    }
+
+    int32_t alpha;
+    if (opt->one_euro) {
+      alpha = one_euro_alpha_q(b, cfg, i, v);
+    } else {
+      alpha = (v > b->ema_q30[i]) ? cfg->q_alpha_up[i] : cfg->q_alpha_down[i];
+    }
+    b->ema_q30[i] +=
+        (int32_t)(((int64_t)(v - b->ema_q30[i]) * alpha) >> 31);
+    int32_t y =
+        opt->predict ? predict_q(b, cfg, i, b->ema_q30[i]) : b->ema_q30[i];
+
+    int32_t o = (int32_t)(((int64_t)y * FILTER_OUT_MAX +
+                           (int64_t)BIT(29)) >>
+                          30);
+#if FILTER_USE_SIMD
+    q[i] = (int16_t)__USAT(o, FILTER_OUT_BITS);
+#else
+    q[i] = (int16_t)CLAMP(o, 0, FILTER_OUT_MAX);
 #endif
 
-  const float alpha = (v > s_state[id]) ? g_cfg.s_alpha_up : g_cfg.s_alpha_down;
-  s_state[id] = (alpha * v) + ((1.0F - alpha) * s_state[id]);
-  uint16_t span_out = g_cfg.use14bit ? 16383 : 127;
-  int32_t q = (int32_t)((s_state[id] * (float)span_out) + 0.5F);
-  if (s_last_out[id] != -999) {
-    if (abs(q - s_last_out[id]) < (int32_t)g_cfg.hysteresis_lsb) {
-      q = s_last_out[id];
+    h[i] = opt->hyst ? (int16_t)cfg->hysteresis_lsb[i] : 0;
+    if (opt->hyst_auto) {
+      int32_t x = (int32_t)(((int64_t)y * FILTER_OUT_MAX) >>
+                            (30 - NOISE_FRAC_BITS));
+      h[i] = (int16_t)noise_hyst(b, cfg, i, x, h[i]);
+      prev[i] = b->last_out[i];
+    }
+  }
+
+  filter_fixed_hysteresis(b, q, out, h);
+
+  if (opt->hyst_auto) {
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      noise_event(b, i, prev[i], b->last_out[i]);
     }
   }
-  s_last_out[id] = (int16_t)q;
-  return (uint16_t)q;
+}
+
+static inline void filter_run(filter_bank_t *b, const pedal_filter_cfg_t *cfg,
+                              const uint16_t raw[], uint16_t out[]) {
+  const filter_opts_t opt = {
+      .cfg = cfg,
+      .hyst = true,
+      .hyst_auto = IS_ENABLED(CONFIG_MIDAL_FILTER_HYST_AUTO),
+      .one_euro = IS_ENABLED(CONFIG_MIDAL_FILTER_MODE_ONE_EURO),
+      .predict = IS_ENABLED(CONFIG_MIDAL_PREDICT),
+  };
+
+#if IS_ENABLED(CONFIG_MIDAL_FILTER_FIXED)
+  filter_fixed_run(b, raw, out, &opt);
+#else
+  filter_float_run(b, raw, out, &opt);
+#endif
+}
+
+void pedal_filter_apply_all(const uint16_t raw[MIDAL_NUM_PEDALS],
+                            uint16_t out[MIDAL_NUM_PEDALS]) {
+  /* One load per scan; the set stays valid until the epoch moves on */
+  const filter_coef_set_t *set = atomic_ptr_get(&s_coef);
+  const pedal_filter_cfg_t *cfg =
+      (s_fs_hz == set->idle.fs_hz && s_fs_hz != set->active.fs_hz)
+          ? &set->idle
+          : &set->active;
+
+  filter_run(&s_bank, cfg, raw, out);
+  atomic_set(&s_poll_hz, (atomic_val_t)set->params.poll_hz);
+
+  atomic_inc(&s_coef_epoch);
+  if (IS_ENABLED(CONFIG_MIDAL_FILTER_LUT)) {
+    pedal_curve_scan_done();
+  }
+  atomic_inc(&s_scans);
+}
+
+#if IS_ENABLED(CONFIG_MIDAL_FILTER_BENCH) ||                                   \
+    IS_ENABLED(CONFIG_MIDAL_PROFILER)
+static filter_bank_t s_bench_bank[PEDAL_FILTER_KERNEL_COUNT]
+                                  [PEDAL_FILTER_MODE_COUNT];
+/* Live coefficients at the active rate, copied when a trace starts */
+static pedal_filter_cfg_t s_bench_cfg;
+
+uint32_t pedal_filter_bench_kernel(pedal_filter_kernel_t kernel,
+                                   pedal_filter_mode_t mode, bool reset,
+                                   pedal_filter_hyst_t hyst,
+                                   const uint16_t raw[MIDAL_NUM_PEDALS],
+                                   uint16_t out[MIDAL_NUM_PEDALS]) {
+  if (kernel >= PEDAL_FILTER_KERNEL_COUNT || mode >= PEDAL_FILTER_MODE_COUNT ||
+      hyst >= PEDAL_FILTER_HYST_COUNT) {
+    return 0U;
+  }
+
+  filter_bank_t *b = &s_bench_bank[kernel][mode];
+  if (reset) {
+    s_bench_cfg = ((const filter_coef_set_t *)atomic_ptr_get(&s_coef))->active;
+    bank_reset(b, &s_bench_cfg);
+  }
+
+  const filter_opts_t opt = {
+      .cfg = &s_bench_cfg,
+      .hyst = (hyst != PEDAL_FILTER_HYST_OFF),
+      .hyst_auto = (hyst == PEDAL_FILTER_HYST_ADAPTIVE),
+      .one_euro = (mode == PEDAL_FILTER_MODE_ONE_EURO),
+      .predict = (mode == PEDAL_FILTER_MODE_EMA_PREDICT),
+  };
+
+  uint32_t t0 = filter_cycles();
+  if (kernel == PEDAL_FILTER_KERNEL_FIXED) {
+    filter_fixed_run(b, raw, out, &opt);
+  } else {
+    filter_float_run(b, raw, out, &opt);
+  }
+  return filter_cycles() - t0;
+}
+#endif
+
+void pedal_filter_get_stats(struct pedal_filter_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  stats->scans = (uint32_t)atomic_get(&s_scans);
+  stats->cycles_avg = 0U;
+  stats->cycles_max = 0U;
+#if IS_ENABLED(CONFIG_MIDAL_PROFILER)
+  struct profiler_stage_stats cost;
+
+  profiler_get_stage_stats(PROF_FILTER, &cost);
+  stats->cycles_avg = cost.mean_cycles;
+  stats->cycles_max = cost.max_cycles;
+#endif
+  stats->fixed_point = IS_ENABLED(CONFIG_MIDAL_FILTER_FIXED);
+}
+
+void pedal_filter_get_noise_stats(uint8_t pedal_id,
+                                  struct pedal_noise_stats *stats) {
+  if (pedal_id >= MIDAL_NUM_PEDALS || stats == NULL) {
+    return;
+  }
+
+  const uint32_t var = (uint32_t)atomic_get(&s_nz_var[pedal_id]);
+  const uint32_t events = (uint32_t)atomic_get(&s_motion_events[pedal_id]);
+  const uint32_t steps = (uint32_t)atomic_get(&s_motion_steps[pedal_id]);
+
+  /* sqrt(Q16) is Q8; 1/256 LSB to 1/1000 */
+  stats->noise_milli = (var == NOISE_VAR_UNSET)
+                           ? 0U
+                           : (isqrt32(var) * 1000U) >> NOISE_FRAC_BITS;
+  stats->hyst_rest = (uint16_t)atomic_get(&s_nz_hyst_rest[pedal_id]);
+  stats->moving = atomic_get(&s_nz_moving[pedal_id]) != 0;
+  stats->hyst = stats->moving
+                    ? (uint16_t)MIN(CONFIG_MIDAL_FILTER_HYST_MIN_LSB,
+                                    stats->hyst_rest)
+                    : stats->hyst_rest;
+  stats->rest_ms = (uint32_t)atomic_get(&s_rest_ms[pedal_id]);
+  stats->rest_events = (uint32_t)atomic_get(&s_rest_events[pedal_id]);
+  stats->motion_events = events;
+  stats->motion_levels =
+      (steps > 0U) ? (uint32_t)(((uint64_t)FILTER_OUT_MAX * events) / steps)
+                   : 0U;
 }
 
 void pedal_filter_reset_calibration(uint8_t pedal_id) {
@@ -180,10 +1164,7 @@ void pedal_filter_reset_calibration(uint8_t pedal_id) {
     return;
   }
 
-  pedal_calibration_t *cal = &s_calibration[pedal_id];
-  cal->min_adc = 500;  // 0.5V starting point
-  cal->max_adc = 4095; // Will be set on first reading
-  cal->initialized = false;
+  cal_reset(&s_bank, pedal_id);
 }
 
 void pedal_filter_get_calibration(uint8_t pedal_id, pedal_calibration_t *cal) {
@@ -191,5 +1172,7 @@ void pedal_filter_get_calibration(uint8_t pedal_id, pedal_calibration_t *cal) {
     return;
   }
 
-  *cal = s_calibration[pedal_id];
+  cal->min_adc = s_bank.cal_min[pedal_id];
+  cal->max_adc = s_bank.cal_max[pedal_id];
+  cal->initialized = s_bank.cal_init[pedal_id];
 }
@@ -1,16 +1,138 @@
 #pragma once
 
+#include "diag/stats.h"
+#include "midal_conf.h"
+#include "pedal_decim.h"
+#include "pedal_sampler.h"
+
 #include <zephyr/kernel.h>
 
+/*
+ * Raw filter input scale: 12-bit SAADC counts with PEDAL_RAW_FRAC_BITS extra
+ * fractional bits when the oversampling decimator is enabled.
+ */
+#if IS_ENABLED(CONFIG_MIDAL_DECIM)
+#define PEDAL_RAW_FRAC_BITS 4
+#else
+#define PEDAL_RAW_FRAC_BITS 0
+#endif
+#define PEDAL_RAW_MAX ((4096U << PEDAL_RAW_FRAC_BITS) - 1U)
+
+/* Learned range, in raw filter input units (see PEDAL_RAW_FRAC_BITS) */
 typedef struct {
     uint16_t min_adc;
     uint16_t max_adc;
     bool initialized;
 } pedal_calibration_t;
 
+/* Limits of the runtime parameters; every oversampled scan must fit */
+#define PEDAL_FILTER_POLL_HZ_MIN 250U
+#define PEDAL_FILTER_POLL_HZ_MAX                                               \
+  MIN(4000U, PEDAL_SCAN_MAX_HZ / PEDAL_DECIM_RATIO)
+#define PEDAL_FILTER_TAU_MS_MAX 100U
+#define PEDAL_FILTER_HYST_CC_MAX 10U
+
+/* Tuning of one pedal; alphas in millipercent (100000 = 1.0) */
+typedef struct {
+    uint16_t tau_ms;            /* EMA time constant, 0 = use alpha_millipct */
+    uint32_t alpha_millipct;    /* Fixed EMA alpha when tau_ms is 0 */
+    uint32_t up_min_millipct;   /* Attack alpha lower bound */
+    uint32_t down_max_millipct; /* Release alpha upper bound */
+    uint8_t hyst_cc;            /* Dead band in 7-bit CC steps */
+    bool invert;                /* Reverse polarity after calibration */
+} pedal_tuning_t;
+
+/* Runtime filter and sampling parameters, defaults from Kconfig */
+typedef struct {
+    uint32_t poll_hz; /* Output rate while pedals move */
+    pedal_tuning_t pedal[MIDAL_NUM_PEDALS];
+} pedal_filter_params_t;
+
+/*
+ * Build the coefficients from the saved parameter set (CONFIG_MIDAL_PARAMS)
+ * or the Kconfig defaults and reset the filter state. Call before the
+ * sampling thread starts.
+ */
 void pedal_filter_init(void);
-uint16_t pedal_filter_apply(uint8_t pedal_id,
-                            uint16_t raw12bit); // -> 0..127/16383
+
+void pedal_filter_default_params(pedal_filter_params_t *params);
+
+/*
+ * Derive the coefficients of a new parameter set on the calling thread and
+ * publish them to the sampling thread with a pointer swap; the next scan
+ * uses them. Returns -EINVAL for an out-of-range parameter, -EBUSY when the
+ * sampling thread has not released the previous set within 100 ms. Not for
+ * the sampling thread.
+ */
+int pedal_filter_configure(const pedal_filter_params_t *params);
+
+/* Parameter set in use */
+void pedal_filter_get_params(pedal_filter_params_t *params);
+
+/*
+ * Active poll rate of the parameter set the latest scan used. Copied out
+ * under the scan's epoch, so it is safe from any thread; a new set shows up
+ * here one scan after pedal_filter_configure().
+ */
+uint32_t pedal_filter_poll_hz(void);
+
+/*
+ * Filter one scan of all pedals: raw[i] in raw filter input units, out[i] in
+ * 0..127/16383. Uses the kernel selected by CONFIG_MIDAL_FILTER_FIXED.
+ */
+void pedal_filter_apply_all(const uint16_t raw[MIDAL_NUM_PEDALS],
+                            uint16_t out[MIDAL_NUM_PEDALS]);
+
+/*
+ * Select the coefficients derived for a new output sample rate (the active
+ * poll rate or CONFIG_MIDAL_IDLE_POLL_HZ) so the filter time constants stay
+ * the same. Call from the sampling thread only.
+ */
+void pedal_filter_set_rate(uint32_t fs_hz);
 
 void pedal_filter_reset_calibration(uint8_t pedal_id);
-void pedal_filter_get_calibration(uint8_t pedal_id, pedal_calibration_t *cal);
\ No newline at end of file
+void pedal_filter_get_calibration(uint8_t pedal_id, pedal_calibration_t *cal);
+
+/* Filter kernel cost per scan, in CPU cycles (DWT) or kernel clock cycles */
+void pedal_filter_get_stats(struct pedal_filter_stats *stats);
+
+/*
+ * Measured noise and dead band of one pedal (CONFIG_MIDAL_FILTER_HYST_AUTO),
+ * with the output changes counted at rest and while moving.
+ */
+void pedal_filter_get_noise_stats(uint8_t pedal_id,
+                                  struct pedal_noise_stats *stats);
+
+#if IS_ENABLED(CONFIG_MIDAL_FILTER_BENCH) ||                                   \
+    IS_ENABLED(CONFIG_MIDAL_PROFILER)
+typedef enum {
+    PEDAL_FILTER_KERNEL_FLOAT = 0,
+    PEDAL_FILTER_KERNEL_FIXED,
+    PEDAL_FILTER_KERNEL_COUNT
+} pedal_filter_kernel_t;
+
+typedef enum {
+    PEDAL_FILTER_MODE_EMA = 0,
+    PEDAL_FILTER_MODE_ONE_EURO,
+    PEDAL_FILTER_MODE_EMA_PREDICT, /* EMA followed by the predictor */
+    PEDAL_FILTER_MODE_COUNT
+} pedal_filter_mode_t;
+
+typedef enum {
+    PEDAL_FILTER_HYST_OFF = 0,
+    PEDAL_FILTER_HYST_STATIC,   /* CONFIG_MIDAL_FILTER_HYST on every pedal */
+    PEDAL_FILTER_HYST_ADAPTIVE, /* Sized from each pedal's measured noise */
+    PEDAL_FILTER_HYST_COUNT
+} pedal_filter_hyst_t;
+
+/*
+ * Run one scan through the given kernel and mode on private state (the live
+ * filter is untouched). reset starts a new trace; hyst selects the output
+ * dead band. Returns the cycles spent.
+ */
+uint32_t pedal_filter_bench_kernel(pedal_filter_kernel_t kernel,
+                                   pedal_filter_mode_t mode, bool reset,
+                                   pedal_filter_hyst_t hyst,
+                                   const uint16_t raw[MIDAL_NUM_PEDALS],
+                                   uint16_t out[MIDAL_NUM_PEDALS]);
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "midal_conf.h"
+#include "midi/midi_types.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+/*
+ * One filtered pedal scan as published on pedal_frame_chan: every pedal's
+ * current value plus a mask of the pedals that changed in this scan. A
+ * single publish per scan replaces one midi_event_t publish per pedal.
+ */
+typedef struct {
+  uint32_t timestamp_us;             /* Capture time of the scan */
+  uint16_t values[MIDAL_NUM_PEDALS]; /* 0..16383 (or 0..127 in 7-bit) */
+  uint8_t changed;                   /* BIT(i) set if pedal i changed */
+} pedal_frame_t;
+
+BUILD_ASSERT(MIDAL_NUM_PEDALS <= 8, "pedal_frame_t.changed holds 8 pedals");
+
+/* The CC update pedal i carries in frame (channel/controller from config) */
+void pedal_frame_event(const pedal_frame_t *frame, size_t i, midi_event_t *ev);
+
+/* Transport send priority of pedal i under congestion, 0 = first */
+uint8_t pedal_frame_priority(size_t i);
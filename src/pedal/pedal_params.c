@@ -0,0 +1,324 @@
+#include "pedal_params.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+LOG_MODULE_REGISTER(pedal_params, LOG_LEVEL_INF);
+
+#define PARAMS_SUBTREE "midal/params"
+#define PARAMS_NAME "set"
+#define PARAMS_KEY PARAMS_SUBTREE "/" PARAMS_NAME
+
+/* Bump when the record layout changes; older records are ignored */
+#define PARAMS_VERSION 1U
+
+typedef struct {
+  uint8_t version;
+  uint8_t pedals;
+  uint8_t reserved[2];
+  pedal_filter_params_t params;
+} params_record_t;
+
+/* Filled by the settings handler during pedal_params_load() */
+static params_record_t s_loaded;
+static bool s_have_loaded;
+
+static int params_set(const char *key, size_t len, settings_read_cb read_cb,
+                      void *cb_arg) {
+  const char *next;
+
+  if (!settings_name_steq(key, PARAMS_NAME, &next) || next != NULL) {
+    return -ENOENT;
+  }
+  if (len != sizeof(s_loaded)) {
+    LOG_WRN("Saved parameters have size %u, expected %u", (unsigned)len,
+            (unsigned)sizeof(s_loaded));
+    return -EINVAL;
+  }
+
+  ssize_t rc = read_cb(cb_arg, &s_loaded, sizeof(s_loaded));
+  if (rc < 0) {
+    return (int)rc;
+  }
+
+  s_have_loaded = true;
+  return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(midal_params, PARAMS_SUBTREE, NULL, params_set,
+                               NULL, NULL);
+
+int pedal_params_load(pedal_filter_params_t *params) {
+  if (params == NULL) {
+    return -EINVAL;
+  }
+
+  int err = settings_subsys_init();
+  if (err != 0) {
+    LOG_ERR("Settings init failed: %d", err);
+    return err;
+  }
+
+  s_have_loaded = false;
+  err = settings_load_subtree(PARAMS_SUBTREE);
+  if (err != 0) {
+    LOG_ERR("Loading parameters failed: %d", err);
+    return err;
+  }
+
+  if (!s_have_loaded) {
+    return 0;
+  }
+  if (s_loaded.version != PARAMS_VERSION ||
+      s_loaded.pedals != MIDAL_NUM_PEDALS) {
+    LOG_WRN("Ignoring saved parameters (version %u, %u pedals)",
+            s_loaded.version, s_loaded.pedals);
+    return 0;
+  }
+
+  *params = s_loaded.params;
+  LOG_INF("Filter parameters restored (poll %u Hz)", params->poll_hz);
+  return 1;
+}
+
+int pedal_params_save(void) {
+  params_record_t rec = {
+      .version = PARAMS_VERSION,
+      .pedals = MIDAL_NUM_PEDALS,
+  };
+
+  pedal_filter_get_params(&rec.params);
+
+  int err = settings_save_one(PARAMS_KEY, &rec, sizeof(rec));
+  if (err != 0) {
+    LOG_WRN("Saving parameters failed: %d", err);
+  }
+  return err;
+}
+
+int pedal_params_clear(void) {
+  int err = settings_delete(PARAMS_KEY);
+  if (err != 0) {
+    LOG_WRN("Deleting saved parameters failed: %d", err);
+  }
+  return err;
+}
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+typedef enum {
+  PARAM_POLL_HZ, /* Global */
+  PARAM_TAU_MS,
+  PARAM_ALPHA,
+  PARAM_UP_MIN,
+  PARAM_DOWN_MAX,
+  PARAM_HYST,
+  PARAM_INVERT,
+  PARAM_COUNT
+} param_id_t;
+
+static const struct {
+  const char *name;
+  uint32_t min;
+  uint32_t max;
+} s_params[PARAM_COUNT] = {
+    [PARAM_POLL_HZ] = {"poll_hz", PEDAL_FILTER_POLL_HZ_MIN,
+                       PEDAL_FILTER_POLL_HZ_MAX},
+    [PARAM_TAU_MS] = {"tau_ms", 0U, PEDAL_FILTER_TAU_MS_MAX},
+    [PARAM_ALPHA] = {"alpha", 0U, 100000U},
+    [PARAM_UP_MIN] = {"up_min", 0U, 100000U},
+    [PARAM_DOWN_MAX] = {"down_max", 0U, 100000U},
+    [PARAM_HYST] = {"hyst", 0U, PEDAL_FILTER_HYST_CC_MAX},
+    [PARAM_INVERT] = {"invert", 0U, 1U},
+};
+
+/* In MIDAL_PEDAL_* order */
+static const char *const s_pedal_names[] = {"sustain", "sostenuto", "soft"};
+BUILD_ASSERT(ARRAY_SIZE(s_pedal_names) == MIDAL_NUM_PEDALS,
+             "Name every pedal");
+
+static uint32_t param_get(const pedal_tuning_t *t, param_id_t id) {
+  switch (id) {
+  case PARAM_TAU_MS:
+    return t->tau_ms;
+  case PARAM_ALPHA:
+    return t->alpha_millipct;
+  case PARAM_UP_MIN:
+    return t->up_min_millipct;
+  case PARAM_DOWN_MAX:
+    return t->down_max_millipct;
+  case PARAM_HYST:
+    return t->hyst_cc;
+  case PARAM_INVERT:
+    return t->invert ? 1U : 0U;
+  default:
+    return 0U;
+  }
+}
+
+static void param_put(pedal_tuning_t *t, param_id_t id, uint32_t v) {
+  switch (id) {
+  case PARAM_TAU_MS:
+    t->tau_ms = (uint16_t)v;
+    break;
+  case PARAM_ALPHA:
+    t->alpha_millipct = v;
+    break;
+  case PARAM_UP_MIN:
+    t->up_min_millipct = v;
+    break;
+  case PARAM_DOWN_MAX:
+    t->down_max_millipct = v;
+    break;
+  case PARAM_HYST:
+    t->hyst_cc = (uint8_t)v;
+    break;
+  case PARAM_INVERT:
+    t->invert = (v != 0U);
+    break;
+  default:
+    break;
+  }
+}
+
+static int cmd_param_show(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  pedal_filter_params_t p;
+
+  pedal_filter_get_params(&p);
+  shell_print(sh, "poll_hz %u", p.poll_hz);
+  shell_print(sh, "%-10s %6s %6s %6s %8s %4s %6s", "pedal", "tau_ms",
+              "alpha", "up_min", "down_max", "hyst", "invert");
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    const pedal_tuning_t *t = &p.pedal[i];
+
+    shell_print(sh, "%-10s %6u %6u %6u %8u %4u %6u", s_pedal_names[i],
+                t->tau_ms, t->alpha_millipct, t->up_min_millipct,
+                t->down_max_millipct, t->hyst_cc, t->invert ? 1U : 0U);
+  }
+  shell_print(sh, "alphas in 1/100000; tau_ms 0 uses alpha");
+  return 0;
+}
+
+/* Pedal argument: a name, an index, or "all" (-1) */
+static int param_pedal(const char *arg) {
+  if (strcmp(arg, "all") == 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    if (strcmp(arg, s_pedal_names[i]) == 0) {
+      return (int)i;
+    }
+  }
+
+  char *end;
+  unsigned long i = strtoul(arg, &end, 10);
+  return (*end == '\0' && i < MIDAL_NUM_PEDALS) ? (int)i : -2;
+}
+
+static int cmd_param_set(const struct shell *sh, size_t argc, char **argv) {
+  param_id_t id = PARAM_COUNT;
+
+  for (size_t n = 0; n < PARAM_COUNT; n++) {
+    if (strcmp(argv[1], s_params[n].name) == 0) {
+      id = (param_id_t)n;
+    }
+  }
+  if (id == PARAM_COUNT) {
+    shell_error(sh, "unknown parameter %s", argv[1]);
+    return -EINVAL;
+  }
+
+  char *end;
+  unsigned long v = strtoul(argv[2], &end, 10);
+  if (*end != '\0' || v < s_params[id].min || v > s_params[id].max) {
+    shell_error(sh, "%s: %u..%u", s_params[id].name, s_params[id].min,
+                s_params[id].max);
+    return -EINVAL;
+  }
+
+  const int pedal = (argc > 3) ? param_pedal(argv[3]) : -1;
+  if (pedal < -1) {
+    shell_error(sh, "unknown pedal %s", argv[3]);
+    return -EINVAL;
+  }
+
+  pedal_filter_params_t p;
+
+  pedal_filter_get_params(&p);
+  if (id == PARAM_POLL_HZ) {
+    p.poll_hz = (uint32_t)v;
+  } else {
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      if (pedal < 0 || (size_t)pedal == i) {
+        param_put(&p.pedal[i], id, (uint32_t)v);
+      }
+    }
+  }
+
+  int err = pedal_filter_configure(&p);
+  if (err != 0) {
+    shell_error(sh, "not applied: %d", err);
+    return err;
+  }
+  return 0;
+}
+
+static int cmd_param_save(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  int err = pedal_params_save();
+  if (err != 0) {
+    shell_error(sh, "save failed: %d", err);
+    return err;
+  }
+  shell_print(sh, "saved");
+  return 0;
+}
+
+static int cmd_param_defaults(const struct shell *sh, size_t argc,
+                              char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  pedal_filter_params_t p;
+
+  pedal_filter_default_params(&p);
+  int err = pedal_filter_configure(&p);
+  if (err == 0) {
+    err = pedal_params_clear();
+  }
+  if (err != 0) {
+    shell_error(sh, "failed: %d", err);
+    return err;
+  }
+  shell_print(sh, "Kconfig defaults restored, saved set deleted");
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    param_cmds,
+    SHELL_CMD_ARG(set, NULL,
+                  "Apply a parameter: set <name> <value> [pedal|all]",
+                  cmd_param_set, 3, 1),
+    SHELL_CMD(save, NULL, "Keep the parameters in use across reboots",
+              cmd_param_save),
+    SHELL_CMD(defaults, NULL, "Back to the Kconfig values, forget the saved set",
+              cmd_param_defaults),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((midal), param, &param_cmds, "Filter and sampling parameters",
+                 cmd_param_show, 1, 0);
+
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "midal_conf.h"
+#include "pedal_filter.h"
+
+#include <zephyr/kernel.h>
+
+/*
+ * Runtime filter and sampling parameters kept in flash through the settings
+ * subsystem, and the "midal param" shell command to tune them while playing.
+ *
+ * A change is applied at once through pedal_filter_configure() and written
+ * only on "midal param save", so trying values costs no flash wear.
+ */
+
+/*
+ * Read the saved parameter set into params; left untouched when there is
+ * none. Call before the first sample. Returns 1 when a set was restored, 0
+ * when none was saved, or a negative errno.
+ */
+int pedal_params_load(pedal_filter_params_t *params);
+
+/* Save the parameter set in use */
+int pedal_params_save(void);
+
+/* Forget the saved set; the next boot starts from the Kconfig defaults */
+int pedal_params_clear(void);
@@ -1,6 +1,15 @@
+#include "pedal_reader.h"
+#include "diag/flight_recorder.h"
+#include "diag/profiler.h"
+#include "diag/stats.h"
+#include "pedal_decim.h"
+#include "pedal_filter.h"
 #include "pedal_sampler.h"
+#include "sample_clock.h"
 
+#if IS_ENABLED(CONFIG_NRFX_SAADC)
 #include <nrfx_saadc.h>
+#endif
 #include <zephyr/drivers/adc.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
@@ -13,9 +22,33 @@ K_SEM_DEFINE(pedal_reader_sem, 0, 1);
 #define PEDAL_READER_THREAD_PRIORITY 6
 #define ADC_TIMEOUT_MS 5
 
+/* Scans acquired back-to-back by the ADC driver per reader wakeup */
+#define PEDAL_BLOCK_SCANS CONFIG_MIDAL_ACQ_BLOCK_SCANS
+
+BUILD_ASSERT(PEDAL_BLOCK_SCANS % PEDAL_DECIM_RATIO == 0,
+             "MIDAL_ACQ_BLOCK_SCANS must be a multiple of MIDAL_DECIM_RATIO");
+BUILD_ASSERT(CONFIG_MIDAL_POLL_HZ <= PEDAL_FILTER_POLL_HZ_MAX,
+             "MIDAL_POLL_HZ x MIDAL_DECIM_RATIO scans do not fit the SAADC "
+             "scan time rounded to kernel ticks");
+
+#if IS_ENABLED(CONFIG_MIDAL_ADAPTIVE_RATE)
+#define PEDAL_IDLE_POLL_HZ CONFIG_MIDAL_IDLE_POLL_HZ
+#else
+#define PEDAL_IDLE_POLL_HZ CONFIG_MIDAL_POLL_HZ
+#endif
+
+/*
+ * Block size per scheduler state. At idle every block is a single output
+ * sample so motion is seen within one idle period.
+ */
+static const uint32_t reader_block_scans[] = {
+    [PEDAL_RATE_ACTIVE] = PEDAL_BLOCK_SCANS,
+    [PEDAL_RATE_IDLE] = PEDAL_DECIM_RATIO,
+};
+
 typedef struct {
-  int16_t adc_raw[MIDAL_NUM_PEDALS];
-  pedal_raw_sample_t sample;
+  int16_t adc_raw[PEDAL_BLOCK_SCANS * MIDAL_NUM_PEDALS];
+  pedal_raw_sample_t samples[PEDAL_BLOCK_SCANS];
 } pedal_sample_slot_t;
 
 static struct k_thread pedal_reader_thread_data;
@@ -23,7 +56,6 @@ static K_THREAD_STACK_DEFINE(pedal_reader_thread_stack,
                              PEDAL_READER_THREAD_STACK_SIZE);
 static void pedal_reader_thread(void *p1, void *p2, void *p3);
 
-static struct k_timer poll_tmr;
 static struct k_poll_signal adc_signal;
 static struct k_poll_event adc_event;
 
@@ -31,18 +63,185 @@ static pedal_sampler_hw_t sampler_hw;
 static pedal_sample_slot_t sample_slots[2];
 static uint8_t slot_index;
 
-static void trigger_pedals_reading(struct k_timer *tmr) {
-  ARG_UNUSED(tmr);
+/* Current acquisition geometry, owned by the reader thread */
+static pedal_rate_t cur_rate;
+static uint32_t block_scans;
+static uint32_t scan_period_us;
+static uint32_t block_period_us;
+static uint32_t output_hz;
+static uint32_t last_motion_ms;
+
+/* Time spent per rate; the current stint is added on read */
+static atomic_t rate_ms[PEDAL_RATE_COUNT];
+static atomic_t rate_since_ms;
+static atomic_t rate_switches;
+
+static void trigger_pedals_reading(void) {
   k_sem_give(&pedal_reader_sem);
 }
 
+/* The active rate is a runtime filter parameter */
+static uint32_t reader_output_hz(pedal_rate_t rate) {
+  return (rate == PEDAL_RATE_ACTIVE) ? pedal_filter_poll_hz()
+                                     : PEDAL_IDLE_POLL_HZ;
+}
+
+static void reader_set_rate(pedal_rate_t rate) {
+  output_hz = reader_output_hz(rate);
+
+  const uint32_t now = k_uptime_get_32();
+
+  const uint32_t since = (uint32_t)atomic_get(&rate_since_ms);
+
+  atomic_add(&rate_ms[cur_rate], (atomic_val_t)(now - since));
+  atomic_set(&rate_since_ms, (atomic_val_t)now);
+  cur_rate = rate;
+  block_scans = reader_block_scans[rate];
+
+  /* One tick per block; the ADC driver paces the scans inside the block */
+  int err = sample_clock_start(output_hz, block_scans / PEDAL_DECIM_RATIO);
+  if (err != 0) {
+    LOG_ERR("Failed to start sample clock: %d", err);
+  }
+
+  /* Block period as rounded by the clock, not 1/output_hz */
+  const uint32_t block_ns = sample_clock_period_ns();
+  uint32_t interval_us = 0U;
+
+  block_period_us = DIV_ROUND_CLOSEST(block_ns, NSEC_PER_USEC);
+  scan_period_us = block_period_us;
+
+  if (block_scans > 1U) {
+    /*
+     * The driver spaces the scans with a kernel timer: round the spacing
+     * down to whole ticks so the block still fits its period. K_USEC()
+     * rounds up, so hand it the floor of the tick period.
+     */
+    const uint32_t scan_ticks =
+        MAX(1U, k_ns_to_ticks_floor32(block_ns / block_scans));
+
+    scan_period_us = k_ticks_to_us_near32(scan_ticks);
+    interval_us = k_ticks_to_us_floor32(scan_ticks);
+  }
+
+  /* Let the ADC driver repeat the scan into consecutive buffer rows */
+  sampler_hw.sequence_opts.interval_us = interval_us;
+  sampler_hw.sequence_opts.extra_samplings = (uint16_t)(block_scans - 1U);
+
+  /* Keep the filter time constants independent of the rate */
+  pedal_filter_set_rate(output_hz);
+}
+
 static void reader_timer_start(void) {
-  k_timer_init(&poll_tmr, trigger_pedals_reading, NULL);
+  last_motion_ms = k_uptime_get_32();
+  atomic_set(&rate_since_ms, (atomic_val_t)last_motion_ms);
+  reader_set_rate(PEDAL_RATE_ACTIVE);
+
+  LOG_INF("Pedal sensors polling started at %u Hz (x%d oversampling, %d scans "
+          "per block, %u us block, %u us scan)",
+          output_hz, PEDAL_DECIM_RATIO, PEDAL_BLOCK_SCANS, block_period_us,
+          scan_period_us);
+}
+
+static void reader_update_rate(bool motion) {
+  /* A new poll rate was configured: the next block runs at it */
+  if (cur_rate == PEDAL_RATE_ACTIVE &&
+      reader_output_hz(PEDAL_RATE_ACTIVE) != output_hz) {
+    reader_set_rate(PEDAL_RATE_ACTIVE);
+    LOG_INF("Pedal poll rate now %u Hz", output_hz);
+  }
+
+#if IS_ENABLED(CONFIG_MIDAL_ADAPTIVE_RATE)
+  const uint32_t now = k_uptime_get_32();
+
+  if (motion) {
+    last_motion_ms = now;
+    if (cur_rate != PEDAL_RATE_ACTIVE) {
+      reader_set_rate(PEDAL_RATE_ACTIVE);
+      atomic_inc(&rate_switches);
+      LOG_DBG("Pedal motion: %u Hz", output_hz);
+    }
+    return;
+  }
+
+  if (cur_rate == PEDAL_RATE_ACTIVE &&
+      now - last_motion_ms >= CONFIG_MIDAL_IDLE_ENTER_MS) {
+    reader_set_rate(PEDAL_RATE_IDLE);
+    atomic_inc(&rate_switches);
+    LOG_DBG("Pedals at rest: %d Hz", PEDAL_IDLE_POLL_HZ);
+  }
+#else
+  ARG_UNUSED(motion);
+#endif
+}
+
+static void reader_adc_abort(void) {
+#if IS_ENABLED(CONFIG_NRFX_SAADC)
+  nrfx_saadc_abort();
+#endif
+}
+
+static void reader_unpack_block(pedal_sample_slot_t *slot) {
+  /* Timestamp of the last scan; earlier scans are spaced by the interval */
+  uint32_t t_last = k_ticks_to_us_floor32(k_uptime_ticks());
+
+  for (size_t n = 0; n < block_scans; n++) {
+    const int16_t *scan = &slot->adc_raw[n * MIDAL_NUM_PEDALS];
+    pedal_raw_sample_t *sample = &slot->samples[n];
+
+    sample->timestamp_us =
+        t_last - (uint32_t)(block_scans - 1U - n) * scan_period_us;
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      sample->values[i] = scan[sampler_hw.result_offsets[i]];
+    }
+  }
+}
+
+static void reader_acquire_block(void) {
+  pedal_sample_slot_t *slot = &sample_slots[slot_index];
+  slot_index ^= 1U;
+
+  sampler_hw.sequence.buffer = slot->adc_raw;
+  sampler_hw.sequence.buffer_size =
+      block_scans * MIDAL_NUM_PEDALS * sizeof(slot->adc_raw[0]);
+
+  k_poll_signal_reset(&adc_signal);
+  adc_event.state = K_POLL_STATE_NOT_READY;
+
+  uint32_t t_adc = prof_cycles();
+  int err =
+      adc_read_async(sampler_hw.adc_dev, &sampler_hw.sequence, &adc_signal);
+  if (err == -EBUSY) {
+    LOG_WRN("ADC busy, skipping cycle");
+    return;
+  }
+
+  if (err < 0) {
+    LOG_ERR("ADC async read failed: %d", err);
+    return;
+  }
 
-  uint32_t period_us = DIV_ROUND_UP(1000000U, CONFIG_MIDAL_POLL_HZ);
-  k_timer_start(&poll_tmr, K_USEC(period_us), K_USEC(period_us));
+  int rc = k_poll(&adc_event, 1,
+                  K_USEC(ADC_TIMEOUT_MS * 1000U +
+                         (block_scans - 1U) * scan_period_us));
+  if (rc == -EAGAIN) {
+    LOG_ERR("ADC conversion timeout");
+    flight_rec_trigger(FLIGHT_REC_TRIG_ADC_TIMEOUT);
+    reader_adc_abort();
+    return;
+  }
+
+  if (rc < 0) {
+    LOG_ERR("ADC poll error: %d", rc);
+    return;
+  }
 
-  LOG_INF("Pedal sensors polling started at %d Hz", CONFIG_MIDAL_POLL_HZ);
+  k_poll_signal_reset(&adc_signal);
+  prof_end(PROF_ADC, t_adc);
+
+  reader_unpack_block(slot);
+  size_t changes = pedal_sampler_process_block(slot->samples, block_scans);
+  reader_update_rate(changes > 0U);
 }
 
 static void pedal_reader_thread(void *p1, void *p2, void *p3) {
@@ -64,47 +263,14 @@ static void pedal_reader_thread(void *p1, void *p2, void *p3) {
       LOG_DBG("Pedal reader thread heartbeat");
     }
 
-    pedal_sample_slot_t *slot = &sample_slots[slot_index];
-    slot_index ^= 1U;
-
-    sampler_hw.sequence.buffer = slot->adc_raw;
-    sampler_hw.sequence.buffer_size = sizeof(slot->adc_raw);
-
-    k_poll_signal_reset(&adc_signal);
-    adc_event.state = K_POLL_STATE_NOT_READY;
-
-    int err =
-        adc_read_async(sampler_hw.adc_dev, &sampler_hw.sequence, &adc_signal);
-    if (err == -EBUSY) {
-      LOG_WRN("ADC busy, skipping cycle");
-      continue;
-    }
-
-    if (err < 0) {
-      LOG_ERR("ADC async read failed: %d", err);
-      continue;
-    }
-
-    int rc = k_poll(&adc_event, 1, K_MSEC(ADC_TIMEOUT_MS));
-    if (rc == -EAGAIN) {
-      LOG_ERR("ADC conversion timeout");
-      nrfx_saadc_abort();
-      continue;
-    }
-
-    if (rc < 0) {
-      LOG_ERR("ADC poll error: %d", rc);
-      continue;
-    }
-
-    k_poll_signal_reset(&adc_signal);
-
-    slot->sample.timestamp_us = k_ticks_to_us_floor32(k_uptime_ticks());
-    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
-      slot->sample.values[i] = slot->adc_raw[sampler_hw.result_offsets[i]];
-    }
+    /* The block may switch rate: account it against its own period */
+    uint32_t t0 = prof_cycles();
+    uint32_t period_us = block_period_us;
 
-    pedal_sampler_process_sample(&slot->sample);
+    sample_clock_mark_start();
+    reader_acquire_block();
+    sample_clock_mark_done();
+    prof_block_end(t0, period_us);
   }
 }
 
@@ -113,6 +279,11 @@ int pedal_reader_init(const pedal_sampler_hw_t *hw) {
     return -EINVAL;
   }
 
+  int err = sample_clock_init(trigger_pedals_reading);
+  if (err != 0) {
+    return err;
+  }
+
   sampler_hw = *hw;
   sampler_hw.sequence.options = &sampler_hw.sequence_opts;
   sampler_hw.sequence.buffer = NULL;
@@ -136,3 +307,27 @@ int pedal_reader_init(const pedal_sampler_hw_t *hw) {
 
   return 0;
 }
+
+void pedal_reader_get_rate_stats(struct pedal_rate_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  const uint32_t since = (uint32_t)atomic_get(&rate_since_ms);
+  if (since == 0U) {
+    /* Reader not started yet */
+    *stats = (struct pedal_rate_stats){0};
+    return;
+  }
+
+  /* Include the ongoing stint in whichever rate is current */
+  const uint32_t stint = k_uptime_get_32() - since;
+  const pedal_rate_t rate = cur_rate;
+
+  stats->active_ms = (uint32_t)atomic_get(&rate_ms[PEDAL_RATE_ACTIVE]) +
+                     ((rate == PEDAL_RATE_ACTIVE) ? stint : 0U);
+  stats->idle_ms = (uint32_t)atomic_get(&rate_ms[PEDAL_RATE_IDLE]) +
+                   ((rate == PEDAL_RATE_IDLE) ? stint : 0U);
+  stats->switches = (uint32_t)atomic_get(&rate_switches);
+  stats->idle = (rate == PEDAL_RATE_IDLE);
+}
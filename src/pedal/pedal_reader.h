@@ -2,7 +2,23 @@
 
 #include "pedal_sampler.h"
 
+struct pedal_rate_stats;
+
+/* Sampling scheduler state (see CONFIG_MIDAL_ADAPTIVE_RATE) */
+typedef enum {
+  PEDAL_RATE_ACTIVE, // Poll rate parameter, CONFIG_MIDAL_POLL_HZ by default
+  PEDAL_RATE_IDLE,   // CONFIG_MIDAL_IDLE_POLL_HZ
+  PEDAL_RATE_COUNT
+} pedal_rate_t;
+
 /*
  * Initialize the pedals reading thread
  */
 int pedal_reader_init(const pedal_sampler_hw_t *hw);
+
+/**
+ * @brief Get time spent by the sampling pipeline in each rate
+ *
+ * @param stats Pointer to structure to fill with statistics
+ */
+void pedal_reader_get_rate_stats(struct pedal_rate_stats *stats);
@@ -1,17 +1,37 @@
 #include "pedal_sampler.h"
+#include "boot.h"
+#include "diag/flight_recorder.h"
+#include "diag/latency.h"
+#include "diag/profiler.h"
 #include "midal_conf.h"
 #include "midi/midi_types.h"
+#include "pedal_decim.h"
 #include "pedal_filter.h"
+#include "pedal_frame.h"
 #include "zbus_channels.h"
 
+#include <stdlib.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/adc.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/util.h>
 #include <zephyr/zbus/zbus.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(pedal_sampler, LOG_LEVEL_INF);
 
+#ifndef CONFIG_MIDAL_ADC_SETTLE_MAX_MS
+#define CONFIG_MIDAL_ADC_SETTLE_MAX_MS 2000
+#endif
+#ifndef CONFIG_MIDAL_ADC_SETTLE_TOL_LSB
+#define CONFIG_MIDAL_ADC_SETTLE_TOL_LSB 8
+#endif
+#ifndef CONFIG_MIDAL_ADC_SETTLE_READS
+#define CONFIG_MIDAL_ADC_SETTLE_READS 5
+#endif
+/* Spacing of the settling check reads */
+#define ADC_SETTLE_POLL_MS 10
+
 #if !DT_NODE_EXISTS(DT_PATH(zephyr_user)) ||                                   \
     !DT_NODE_HAS_PROP(DT_PATH(zephyr_user), io_channels)
 #error "No suitable devicetree overlay specified"
@@ -22,6 +42,7 @@ typedef struct {
   struct adc_dt_spec adc_spec;
   uint8_t midi_cc;
   uint8_t midi_channel;
+  uint8_t priority; /* Transport send order under congestion, 0 = first */
   const char *name;
 } pedal_config_t;
 
@@ -30,16 +51,19 @@ const pedal_config_t pedal_configs[] = {
     {.adc_spec = ADC_DT_SPEC_GET_BY_NAME(DT_PATH(zephyr_user), pedal_sustain),
      .midi_cc = MIDAL_CC_SUSTAIN,
      .midi_channel = MIDAL_CH_PEDAL_SUSTAIN,
+     .priority = MIDAL_PRIO_PEDAL_SUSTAIN,
      .name = "Sustain"},
 
     {.adc_spec = ADC_DT_SPEC_GET_BY_NAME(DT_PATH(zephyr_user), pedal_sostenuto),
      .midi_cc = MIDAL_CC_SOSTENUTO,
      .midi_channel = MIDAL_CH_PEDAL_SOSTENUTO,
+     .priority = MIDAL_PRIO_PEDAL_SOSTENUTO,
      .name = "Sostenuto"},
 
     {.adc_spec = ADC_DT_SPEC_GET_BY_NAME(DT_PATH(zephyr_user), pedal_soft),
      .midi_cc = MIDAL_CC_SOFT,
      .midi_channel = MIDAL_CH_PEDAL_SOFT,
+     .priority = MIDAL_PRIO_PEDAL_SOFT,
      .name = "Soft"}};
 
 const size_t pedals_count = ARRAY_SIZE(pedal_configs);
@@ -52,11 +76,29 @@ static uint16_t last_sent_cc[MIDAL_NUM_PEDALS];
 static uint32_t last_log_time[MIDAL_NUM_PEDALS] = {0};
 #endif
 
+/* Set once the first MIDI event has been published */
+static bool first_event_sent;
+
+/* Uptime of the last scan that changed a pedal output */
+static atomic_t s_last_change_ms;
+
 typedef struct {
   uint8_t pedal_idx;
   uint8_t channel_id;
 } channel_map_entry_t;
 
+void pedal_frame_event(const pedal_frame_t *frame, size_t i, midi_event_t *ev) {
+  *ev = (midi_event_t){
+      .type = MIDI_EV_CC,
+      .timestamp_us = frame->timestamp_us,
+      .cc = {.ch = pedal_configs[i].midi_channel,
+             .cc = pedal_configs[i].midi_cc,
+             .value = frame->values[i]},
+  };
+}
+
+uint8_t pedal_frame_priority(size_t i) { return pedal_configs[i].priority; }
+
 static void log_pedal_state(size_t pedal_idx, uint16_t raw, uint16_t filtered) {
 #if IS_ENABLED(CONFIG_MIDAL_PEDAL_LOG)
   uint32_t now = k_uptime_get_32();
@@ -76,39 +118,143 @@ static void log_pedal_state(size_t pedal_idx, uint16_t raw, uint16_t filtered) {
 #endif
 }
 
-void pedal_sampler_process_sample(const pedal_raw_sample_t *sample) {
-  if (sample == NULL) {
-    return;
-  }
+static size_t process_scan(const pedal_raw_sample_t *sample, bool log) {
+  uint16_t raw12[MIDAL_NUM_PEDALS];
+  uint16_t raw[MIDAL_NUM_PEDALS];
+
+  flight_rec_scan(sample);
 
   for (size_t i = 0; i < pedals_count; i++) {
-    int32_t raw = sample->values[i];
-    if (raw < 0) {
-      raw = 0;
+    int32_t v = sample->values[i];
+    if (v < 0) {
+      v = 0;
     }
-    if (raw > 4095) {
-      raw = 4095;
+    if (v > 4095) {
+      v = 4095;
     }
+    raw12[i] = (uint16_t)v;
+  }
+
+  /* Oversampled scans only reach the filter once per decimation period */
+  if (!pedal_decim_push(raw12, raw)) {
+    return 0U;
+  }
 
-    uint16_t filtered = pedal_filter_apply(i, (uint16_t)raw);
-    log_pedal_state(i, (uint16_t)raw, filtered);
+  pedal_frame_t frame = {.timestamp_us = sample->timestamp_us};
+  uint32_t t0 = prof_cycles();
+  pedal_filter_apply_all(raw, frame.values);
+  prof_end(PROF_FILTER, t0);
+  flight_rec_output(frame.values);
+  latency_record(LATENCY_FILTER, frame.timestamp_us);
+
+  for (size_t i = 0; i < pedals_count; i++) {
+    uint16_t filtered = frame.values[i];
+    if (log) {
+      t0 = prof_cycles();
+      log_pedal_state(i, raw[i], filtered);
+      prof_end(PROF_LOG, t0);
+    }
 
     if (last_sent_cc[i] != filtered) {
       last_sent_cc[i] = filtered;
-      midi_event_t ev = {
-          .type = MIDI_EV_CC,
-          .timestamp_us = sample->timestamp_us,
-          .cc = {.ch = pedal_configs[i].midi_channel,
-                 .cc = pedal_configs[i].midi_cc,
-                 .value = filtered},
-      };
-      /* Publish MIDI event to zbus channel (non-blocking) */
-      int ret = zbus_chan_pub(&midi_event_chan, &ev, K_NO_WAIT);
-      if (ret != 0) {
-        LOG_WRN("Failed to publish MIDI event for %s pedal: %d",
-                pedal_configs[i].name, ret);
+      frame.changed |= BIT(i);
+    }
+  }
+
+  if (frame.changed == 0U) {
+    return 0U;
+  }
+  atomic_set(&s_last_change_ms, (atomic_val_t)k_uptime_get_32());
+
+  /* One publish per scan, whatever the number of pedals that moved */
+  t0 = prof_cycles();
+  int ret = zbus_chan_pub(&pedal_frame_chan, &frame, K_NO_WAIT);
+  prof_end(PROF_PUBLISH, t0);
+  latency_record(LATENCY_PUBLISH, frame.timestamp_us);
+  if (ret != 0) {
+    LOG_WRN("Failed to publish pedal frame (mask 0x%02x): %d", frame.changed,
+            ret);
+  } else if (!first_event_sent) {
+    first_event_sent = true;
+    boot_mark(BOOT_PHASE_FIRST_EVENT);
+  }
+
+  return (size_t)__builtin_popcount(frame.changed);
+}
+
+uint32_t pedal_sampler_idle_ms(void) {
+  return k_uptime_get_32() - (uint32_t)atomic_get(&s_last_change_ms);
+}
+
+void pedal_sampler_process_sample(const pedal_raw_sample_t *sample) {
+  if (sample == NULL) {
+    return;
+  }
+
+  (void)process_scan(sample, true);
+}
+
+size_t pedal_sampler_process_block(const pedal_raw_sample_t *samples,
+                                   size_t count) {
+  if (samples == NULL || count == 0U) {
+    return 0U;
+  }
+
+  size_t changes = 0U;
+
+  /* Rate-limited logging only needs to look at the newest scan */
+  for (size_t n = 0; n + 1U < count; n++) {
+    changes += process_scan(&samples[n], false);
+  }
+  changes += process_scan(&samples[count - 1U], true);
+
+  return changes;
+}
+
+/*
+ * Wait until the pedal inputs stop drifting after power-up: consecutive
+ * reads CONFIG_MIDAL_ADC_SETTLE_READS times in a row within the tolerance
+ * on every channel, or CONFIG_MIDAL_ADC_SETTLE_MAX_MS at most.
+ */
+static int sampler_wait_settled(const pedal_sampler_hw_t *hw) {
+  int16_t buf[2][MIDAL_NUM_PEDALS];
+  struct adc_sequence seq = hw->sequence;
+  const uint32_t start = k_uptime_get_32();
+  uint32_t stable = 0U;
+  int step = 0;
+
+  seq.options = NULL;
+  seq.buffer_size = sizeof(buf[0]);
+
+  for (uint32_t n = 0;; n++) {
+    seq.buffer = buf[n & 1U];
+    int err = adc_read(hw->adc_dev, &seq);
+    if (err < 0) {
+      LOG_ERR("ADC settling read failed: %d", err);
+      return err;
+    }
+
+    if (n > 0U) {
+      step = 0;
+      for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+        step = MAX(step, abs((int32_t)buf[n & 1U][i] -
+                             (int32_t)buf[(n - 1U) & 1U][i]));
       }
+      stable = (step <= CONFIG_MIDAL_ADC_SETTLE_TOL_LSB) ? stable + 1U : 0U;
     }
+
+    const uint32_t elapsed = k_uptime_get_32() - start;
+    if (stable >= CONFIG_MIDAL_ADC_SETTLE_READS) {
+      LOG_INF("ADC settled after %u ms", elapsed);
+      return 0;
+    }
+    if (elapsed >= CONFIG_MIDAL_ADC_SETTLE_MAX_MS) {
+      LOG_WRN("ADC still drifting after %u ms (last step %d LSB)", elapsed,
+              step);
+      return 0;
+    }
+
+    k_sleep(K_MSEC(ADC_SETTLE_POLL_MS));
   }
 }
 
@@ -157,15 +303,6 @@ int pedal_sampler_prepare_hw(pedal_sampler_hw_t *out) {
     channels_mask |= BIT(spec->channel_id);
   }
 
-  /* Wait for ADC to settle */
-  k_sleep(K_MSEC(2000));
-
-  pedal_filter_init();
-  memset(last_sent_cc, 0xFF, sizeof(last_sent_cc));
-#if IS_ENABLED(CONFIG_MIDAL_PEDAL_LOG)
-  memset(last_log_time, 0, sizeof(last_log_time));
-#endif
-
   /* Sort channel map by channel ID to match SAADC result ordering */
   for (size_t i = 0; i < pedals_count; i++) {
     for (size_t j = i + 1; j < pedals_count; j++) {
@@ -194,6 +331,25 @@ int pedal_sampler_prepare_hw(pedal_sampler_hw_t *out) {
     out->result_offsets[map[i].pedal_idx] = (uint8_t)i;
   }
 
+  int err = sampler_wait_settled(out);
+  if (err != 0) {
+    return err;
+  }
+  boot_mark(BOOT_PHASE_ADC_SETTLED);
+
+  pedal_filter_init();
+  pedal_decim_reset();
+  memset(last_sent_cc, 0xFF, sizeof(last_sent_cc));
+  first_event_sent = false;
+#if IS_ENABLED(CONFIG_MIDAL_PEDAL_LOG)
+  memset(last_log_time, 0, sizeof(last_log_time));
+#endif
+
+  if (IS_ENABLED(CONFIG_MIDAL_DECIM)) {
+    LOG_INF("CIC decimator: R=%d K=%d, group delay %u us", PEDAL_DECIM_RATIO,
+            PEDAL_DECIM_ORDER, pedal_decim_group_delay_us());
+  }
+
   LOG_INF("Pedal sampler initialized with %d pedals:", (int)pedals_count);
   for (size_t i = 0U; i < pedals_count; i++) {
     LOG_INF("  %s: CC%d on channel %d (offset %u)", pedal_configs[i].name,
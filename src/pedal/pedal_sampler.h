@@ -3,7 +3,39 @@
 #include "midal_conf.h"
 
 #include <zephyr/device.h>
+#include <zephyr/devicetree.h>
 #include <zephyr/drivers/adc.h>
+#include <zephyr/sys/util.h>
+
+/*
+ * Upper bound of one pedal scan, from the devicetree channels of the pedal
+ * ADC: each channel acquires for its acquisition time (10 us by default)
+ * and converts in up to 2 us, once per oversampling step.
+ */
+#define PEDAL_ADC_NODE DT_IO_CHANNELS_CTLR_BY_IDX(DT_PATH(zephyr_user), 0)
+#define PEDAL_ADC_CONV_NS 2000U
+#define PEDAL_ADC_ACQ_NS(t)                                                    \
+  ((ADC_ACQ_TIME_UNIT(t) == ADC_ACQ_TIME_MICROSECONDS)                         \
+       ? ADC_ACQ_TIME_VALUE(t) * 1000U                                         \
+   : (ADC_ACQ_TIME_UNIT(t) == ADC_ACQ_TIME_NANOSECONDS)                        \
+       ? ADC_ACQ_TIME_VALUE(t)                                                 \
+       : 10000U)
+#define PEDAL_ADC_CHANNEL_NS(node)                                             \
+  ((PEDAL_ADC_ACQ_NS(DT_PROP_OR(node, zephyr_acquisition_time, 0)) +           \
+    PEDAL_ADC_CONV_NS)                                                         \
+   << DT_PROP_OR(node, zephyr_oversampling, 0))
+#define PEDAL_SCAN_NS                                                          \
+  (DT_FOREACH_CHILD_STATUS_OKAY_SEP(PEDAL_ADC_NODE, PEDAL_ADC_CHANNEL_NS, (+)))
+
+/*
+ * Fastest scan rate: scans inside a block are spaced by whole kernel ticks,
+ * so one scan must fit a whole number of them.
+ */
+#define PEDAL_SCAN_TICKS                                                       \
+  DIV_ROUND_UP((uint64_t)PEDAL_SCAN_NS * CONFIG_SYS_CLOCK_TICKS_PER_SEC,       \
+               NSEC_PER_SEC)
+#define PEDAL_SCAN_MAX_HZ                                                      \
+  ((uint32_t)(CONFIG_SYS_CLOCK_TICKS_PER_SEC / PEDAL_SCAN_TICKS))
 
 typedef struct {
   uint32_t timestamp_us;
@@ -19,3 +51,19 @@ typedef struct {
 
 int pedal_sampler_prepare_hw(pedal_sampler_hw_t *out);
 void pedal_sampler_process_sample(const pedal_raw_sample_t *sample);
+
+/*
+ * Process a block of consecutive scans (oldest first) acquired in one
+ * streaming ADC read. Equivalent to calling pedal_sampler_process_sample()
+ * for each scan, minus the per-scan bookkeeping.
+ *
+ * Returns the number of pedal value changes published for the block.
+ */
+size_t pedal_sampler_process_block(const pedal_raw_sample_t *samples,
+                                   size_t count);
+
+/*
+ * Milliseconds since a scan last changed any pedal output (since boot if
+ * none has). Safe from any thread.
+ */
+uint32_t pedal_sampler_idle_ms(void);
@@ -0,0 +1,215 @@
+#include "sample_clock.h"
+#include "diag/stats.h"
+
+#include <zephyr/devicetree.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#if IS_ENABLED(CONFIG_MIDAL_SAMPLE_CLOCK_COUNTER)
+#include <zephyr/drivers/counter.h>
+#endif
+
+LOG_MODULE_REGISTER(sample_clock, LOG_LEVEL_INF);
+
+#if IS_ENABLED(CONFIG_MIDAL_SAMPLE_CLOCK_COUNTER)
+#define SAMPLE_CLOCK_NODE DT_CHOSEN(midal_sample_clock)
+static const struct device *const clock_dev = DEVICE_DT_GET(SAMPLE_CLOCK_NODE);
+static uint32_t clock_hz;
+#else
+static struct k_timer clock_tmr;
+#endif
+
+static sample_clock_cb_t tick_cb;
+
+/* Set by the tick ISR, cleared once the reader has processed the tick */
+static atomic_t tick_busy;
+
+static atomic_t ticks;
+static atomic_t overruns;
+
+/* Nominal tick period and start-latency bookkeeping (reader thread only) */
+static uint32_t period_ns;
+static bool have_prev;
+static uint32_t prev_start_ns;
+
+static atomic_t jitter_min_ns;
+static atomic_t jitter_max_ns;
+static atomic_t latency_max_ns;
+static uint64_t jitter_abs_sum_ns;
+static atomic_t jitter_samples;
+static atomic_t jitter_mean_abs_ns;
+
+static void on_tick(void) {
+  atomic_inc(&ticks);
+
+  /* The previous tick is still being acquired or processed */
+  if (atomic_set(&tick_busy, 1) != 0) {
+    atomic_inc(&overruns);
+  }
+
+  if (tick_cb != NULL) {
+    tick_cb();
+  }
+}
+
+#if IS_ENABLED(CONFIG_MIDAL_SAMPLE_CLOCK_COUNTER)
+
+static void counter_top_cb(const struct device *dev, void *user_data) {
+  ARG_UNUSED(dev);
+  ARG_UNUSED(user_data);
+  on_tick();
+}
+
+/* Time since the latest tick, from the free-running counter itself */
+static uint32_t since_tick_ns(void) {
+  uint32_t value = 0U;
+
+  if (counter_get_value(clock_dev, &value) != 0) {
+    return 0U;
+  }
+  return (uint32_t)(((uint64_t)value * NSEC_PER_SEC) / clock_hz);
+}
+
+#else
+
+static void timer_cb(struct k_timer *tmr) {
+  ARG_UNUSED(tmr);
+  on_tick();
+}
+
+/* k_timer gives no phase reference; measure against the cycle counter */
+static uint32_t since_tick_ns(void) {
+  return (uint32_t)k_cyc_to_ns_floor64(k_cycle_get_32());
+}
+
+#endif
+
+int sample_clock_init(sample_clock_cb_t cb) {
+  tick_cb = cb;
+
+#if IS_ENABLED(CONFIG_MIDAL_SAMPLE_CLOCK_COUNTER)
+  if (!device_is_ready(clock_dev)) {
+    LOG_ERR("Sample clock counter %s not ready", clock_dev->name);
+    return -ENODEV;
+  }
+
+  int err = counter_start(clock_dev);
+  if (err != 0 && err != -EALREADY) {
+    LOG_ERR("Failed to start sample clock counter: %d", err);
+    return err;
+  }
+
+  clock_hz = counter_get_frequency(clock_dev);
+  LOG_INF("Sample clock: %s at %u Hz", clock_dev->name, clock_hz);
+#else
+  k_timer_init(&clock_tmr, timer_cb, NULL);
+  LOG_INF("Sample clock: kernel timer");
+#endif
+
+  atomic_clear(&ticks);
+  atomic_clear(&overruns);
+  atomic_set(&jitter_min_ns, INT32_MAX);
+  atomic_set(&jitter_max_ns, INT32_MIN);
+  return 0;
+}
+
+int sample_clock_start(uint32_t sample_hz, uint32_t samples_per_tick) {
+  if (sample_hz == 0U || samples_per_tick == 0U) {
+    return -EINVAL;
+  }
+
+  have_prev = false;
+  atomic_clear(&tick_busy);
+
+#if IS_ENABLED(CONFIG_MIDAL_SAMPLE_CLOCK_COUNTER)
+  /* Exact integer period in counter ticks; the top value reloads in HW */
+  const uint64_t top = ((uint64_t)clock_hz * samples_per_tick) / sample_hz;
+  struct counter_top_cfg top_cfg = {
+      .ticks = (uint32_t)top - 1U,
+      .callback = counter_top_cb,
+      .user_data = NULL,
+      .flags = 0,
+  };
+
+  if (top < 2U || top > counter_get_max_top_value(clock_dev)) {
+    LOG_ERR("Sample period out of counter range (%llu ticks)",
+            (unsigned long long)top);
+    return -ERANGE;
+  }
+
+  int err = counter_set_top_value(clock_dev, &top_cfg);
+  if (err != 0) {
+    LOG_ERR("Failed to set sample clock period: %d", err);
+    return err;
+  }
+  period_ns = (uint32_t)((top * NSEC_PER_SEC) / clock_hz);
+#else
+  /* Whole kernel ticks, rounded to nearest rather than up by K_USEC() */
+  const uint64_t nominal_ns =
+      ((uint64_t)samples_per_tick * NSEC_PER_SEC) / sample_hz;
+  const k_ticks_t period_ticks = MAX(1, k_ns_to_ticks_near64(nominal_ns));
+
+  period_ns = (uint32_t)k_ticks_to_ns_near64(period_ticks);
+  k_timer_start(&clock_tmr, K_TICKS(period_ticks), K_TICKS(period_ticks));
+#endif
+
+  return 0;
+}
+
+uint32_t sample_clock_period_ns(void) { return period_ns; }
+
+void sample_clock_mark_start(void) {
+  const uint32_t now_ns = since_tick_ns();
+
+  if (IS_ENABLED(CONFIG_MIDAL_SAMPLE_CLOCK_COUNTER)) {
+    /* Counter value is the start latency; its change is the period error */
+    if ((int32_t)now_ns > atomic_get(&latency_max_ns)) {
+      atomic_set(&latency_max_ns, (atomic_val_t)now_ns);
+    }
+  }
+
+  if (!have_prev) {
+    /* First tick after (re)start has no reference period */
+    have_prev = true;
+    prev_start_ns = now_ns;
+    return;
+  }
+
+  int32_t jitter = IS_ENABLED(CONFIG_MIDAL_SAMPLE_CLOCK_COUNTER)
+                       ? (int32_t)(now_ns - prev_start_ns)
+                       : (int32_t)(now_ns - prev_start_ns - period_ns);
+  prev_start_ns = now_ns;
+
+  if (jitter < atomic_get(&jitter_min_ns)) {
+    atomic_set(&jitter_min_ns, jitter);
+  }
+  if (jitter > atomic_get(&jitter_max_ns)) {
+    atomic_set(&jitter_max_ns, jitter);
+  }
+
+  jitter_abs_sum_ns += (uint32_t)((jitter < 0) ? -jitter : jitter);
+  atomic_val_t n = atomic_inc(&jitter_samples) + 1;
+  atomic_set(&jitter_mean_abs_ns, (atomic_val_t)(jitter_abs_sum_ns / n));
+}
+
+void sample_clock_mark_done(void) {
+  atomic_clear(&tick_busy);
+}
+
+void sample_clock_get_stats(struct sample_clock_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  const bool have_jitter = atomic_get(&jitter_samples) > 0;
+
+  stats->ticks = (uint32_t)atomic_get(&ticks);
+  stats->overruns = (uint32_t)atomic_get(&overruns);
+  stats->period_ns = period_ns;
+  stats->jitter_min_ns = have_jitter ? (int32_t)atomic_get(&jitter_min_ns) : 0;
+  stats->jitter_max_ns = have_jitter ? (int32_t)atomic_get(&jitter_max_ns) : 0;
+  stats->jitter_mean_abs_ns = (uint32_t)atomic_get(&jitter_mean_abs_ns);
+  stats->latency_max_ns = (uint32_t)atomic_get(&latency_max_ns);
+}
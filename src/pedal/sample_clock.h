@@ -0,0 +1,51 @@
+#pragma once
+
+#include <zephyr/kernel.h>
+
+struct sample_clock_stats;
+
+typedef void (*sample_clock_cb_t)(void);
+
+/*
+ * Sampling clock for the pedal reader.
+ *
+ * With CONFIG_MIDAL_SAMPLE_CLOCK_COUNTER the tick comes from the counter
+ * chosen as "midal,sample-clock" (a TIMER instance on nRF, the counter
+ * emulator on native_sim) in top-value mode, so periods are exact integer
+ * counts of the counter clock and never accumulate drift. Otherwise a
+ * k_timer is used.
+ *
+ * The callback runs in ISR context.
+ */
+int sample_clock_init(sample_clock_cb_t cb);
+
+/*
+ * (Re)start the clock with one tick per @p samples_per_tick samples at
+ * @p sample_hz. Call from the sampling thread.
+ */
+int sample_clock_start(uint32_t sample_hz, uint32_t samples_per_tick);
+
+/*
+ * Tick period in effect, in nanoseconds: the requested period rounded to
+ * whole counter counts or kernel ticks.
+ */
+uint32_t sample_clock_period_ns(void);
+
+/*
+ * Mark the start of the acquisition triggered by the latest tick. Feeds the
+ * period-jitter statistics.
+ */
+void sample_clock_mark_start(void);
+
+/*
+ * Mark the end of processing for the latest tick. A tick that fires before
+ * this is called counts as an overrun.
+ */
+void sample_clock_mark_done(void);
+
+/**
+ * @brief Get sampling clock statistics
+ *
+ * @param stats Pointer to structure to fill with statistics
+ */
+void sample_clock_get_stats(struct sample_clock_stats *stats);
@@ -0,0 +1,59 @@
+/*
+ * Runner side of the native_sim harness: plain host C library calls,
+ * linked into the native simulator (see CMakeLists.txt).
+ */
+
+#include "sim_host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+char *midal_sim_host_read(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return NULL;
+  }
+
+  char *buf = NULL;
+  long size = -1;
+
+  if (fseek(f, 0, SEEK_END) == 0) {
+    size = ftell(f);
+  }
+  if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+    buf = malloc((size_t)size + 1U);
+  }
+  if (buf != NULL) {
+    size_t n = fread(buf, 1, (size_t)size, f);
+    buf[n] = '\0';
+    if (len != NULL) {
+      *len = n;
+    }
+  }
+
+  fclose(f);
+  return buf;
+}
+
+void midal_sim_host_free(char *buf) { free(buf); }
+
+void *midal_sim_host_create(const char *path) { return fopen(path, "w"); }
+
+void midal_sim_host_puts(void *file, const char *line) {
+  if (file != NULL) {
+    fputs(line, file);
+    fputc('\n', file);
+    fflush(file);
+  }
+}
+
+void midal_sim_host_close(void *file) {
+  if (file != NULL) {
+    fclose(file);
+  }
+}
+
+void midal_sim_host_print(const char *line) {
+  puts(line);
+  fflush(stdout);
+}
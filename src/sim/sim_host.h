@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Host file access for the native_sim harness (CONFIG_MIDAL_SIM).
+ *
+ * sim_host.c is built in the native simulator runner against the host C
+ * library, so only plain C types cross this interface. Calls complete in
+ * zero simulated time.
+ */
+
+/*
+ * Read a whole host file as a NUL-terminated string. Returns NULL if it
+ * cannot be read; free with midal_sim_host_free().
+ */
+char *midal_sim_host_read(const char *path, size_t *len);
+void midal_sim_host_free(char *buf);
+
+/* Create (or truncate) a host file for writing; NULL on failure */
+void *midal_sim_host_create(const char *path);
+
+/* Append one line, newline added, and flush it */
+void midal_sim_host_puts(void *file, const char *line);
+
+void midal_sim_host_close(void *file);
+
+/* One line on the simulator's standard output, outside the kernel console */
+void midal_sim_host_print(const char *line);
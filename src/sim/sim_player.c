@@ -0,0 +1,571 @@
+#include "sim_player.h"
+#include "midal_conf.h"
+#include "sim_host.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+/* native_sim command line */
+#include "cmdline.h"
+#include "soc.h"
+
+#if IS_ENABLED(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+LOG_MODULE_REGISTER(sim_player, LOG_LEVEL_INF);
+
+#define PLAYER_THREAD_PRIORITY 7
+#define PLAYER_THREAD_STACK_SIZE 2048
+#define PLAYER_SCRIPT_MAX 256
+/* One script command: "ramp sostenuto 4095 65535" and some */
+#define PLAYER_LINE_MAX 48
+#define PLAYER_ARGS_MAX 4
+#define ADC_MAX_LSB 4095
+
+/*
+ * The overlay gives the emulator a 4096 mV reference at 12 bits, so the
+ * millivolts a value function returns are the raw reading in LSB.
+ */
+#define PEDAL_USER DT_PATH(zephyr_user)
+
+static const struct device *const s_adc =
+    DEVICE_DT_GET(DT_IO_CHANNELS_CTLR_BY_IDX(PEDAL_USER, 0));
+
+/* Emulator channel per pedal, in MIDAL_PEDAL_* order */
+static const uint8_t s_channels[MIDAL_NUM_PEDALS] = {
+    DT_IO_CHANNELS_INPUT_BY_NAME(PEDAL_USER, pedal_sustain),
+    DT_IO_CHANNELS_INPUT_BY_NAME(PEDAL_USER, pedal_sostenuto),
+    DT_IO_CHANNELS_INPUT_BY_NAME(PEDAL_USER, pedal_soft),
+};
+
+static const char *const s_names[MIDAL_NUM_PEDALS] = {"sustain", "sostenuto",
+                                                      "soft"};
+
+typedef struct {
+  int32_t from;     /* Level at start_us */
+  int32_t to;       /* Level from start_us + dur_us on */
+  int64_t start_us;
+  uint32_t dur_us;  /* 0 = step */
+  uint16_t noise;   /* Uniform noise amplitude */
+  bool unplugged;
+  uint32_t rng;     /* Noise generator state, emulator thread only */
+} sim_pedal_t;
+
+/* Written by the shell and player threads, read by the ADC emulator */
+static sim_pedal_t s_pedals[MIDAL_NUM_PEDALS];
+static struct k_spinlock s_lock;
+
+typedef enum {
+  CMD_STEP,
+  CMD_RAMP,
+  CMD_NOISE,
+  CMD_UNPLUG,
+  CMD_PLUG,
+  CMD_COUNT
+} player_cmd_t;
+
+/* Name and argument count, the command included */
+static const struct {
+  const char *name;
+  uint8_t argc;
+} s_cmds[CMD_COUNT] = {
+    [CMD_STEP] = {"step", 3},     [CMD_RAMP] = {"ramp", 4},
+    [CMD_NOISE] = {"noise", 3},   [CMD_UNPLUG] = {"unplug", 2},
+    [CMD_PLUG] = {"plug", 2},
+};
+
+typedef enum { JOB_NONE, JOB_SCRIPT, JOB_CSV } player_job_t;
+
+static atomic_t s_job; /* player_job_t running or queued */
+static char s_script[PLAYER_SCRIPT_MAX];
+static char *s_csv; /* Host buffer of the trace being played */
+static K_SEM_DEFINE(s_job_sem, 0, 1);
+static K_SEM_DEFINE(s_stop_sem, 0, 1);
+
+static struct k_thread player_thread_data;
+static K_THREAD_STACK_DEFINE(player_stack, PLAYER_THREAD_STACK_SIZE);
+
+/* Boot job from the command line */
+static char *s_arg_script;
+static char *s_arg_trajectory;
+
+static int64_t player_now_us(void) {
+  return (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static int32_t pedal_level(const sim_pedal_t *p, int64_t now) {
+  if (now >= p->start_us + (int64_t)p->dur_us) {
+    return p->to;
+  }
+  if (now <= p->start_us) {
+    return p->from;
+  }
+  return p->from + (int32_t)(((int64_t)(p->to - p->from) *
+                              (now - p->start_us)) /
+                             (int64_t)p->dur_us);
+}
+
+static int player_adc_value(const struct device *dev, unsigned int chan,
+                            void *data, uint32_t *result) {
+  ARG_UNUSED(dev);
+  ARG_UNUSED(chan);
+
+  sim_pedal_t *p = data;
+  const int64_t now = player_now_us();
+
+  k_spinlock_key_t key = k_spin_lock(&s_lock);
+  int32_t v = pedal_level(p, now);
+  const int32_t noise = p->noise;
+  const bool unplugged = p->unplugged;
+  k_spin_unlock(&s_lock, key);
+
+  if (unplugged) {
+    v = CONFIG_MIDAL_SIM_UNPLUG_LSB;
+  } else if (noise > 0) {
+    /* xorshift32: the same noise on every run */
+    p->rng ^= p->rng << 13;
+    p->rng ^= p->rng >> 17;
+    p->rng ^= p->rng << 5;
+    v += (int32_t)(p->rng % (uint32_t)(2 * noise + 1)) - noise;
+  }
+
+  *result = (uint32_t)CLAMP(v, 0, ADC_MAX_LSB);
+  return 0;
+}
+
+/* Caller holds s_lock */
+static void pedal_apply(sim_pedal_t *p, player_cmd_t cmd, uint32_t lsb,
+                        uint32_t ms, int64_t now) {
+  switch (cmd) {
+  case CMD_STEP:
+  case CMD_RAMP:
+    p->from = pedal_level(p, now);
+    p->to = (int32_t)lsb;
+    p->start_us = now;
+    p->dur_us = ms * 1000U;
+    break;
+  case CMD_NOISE:
+    p->noise = (uint16_t)lsb;
+    break;
+  case CMD_UNPLUG:
+    p->unplugged = true;
+    break;
+  case CMD_PLUG:
+    p->unplugged = false;
+    break;
+  default:
+    break;
+  }
+}
+
+static bool arg_u32(const char *arg, uint32_t max, uint32_t *out) {
+  char *end;
+  unsigned long v = strtoul(arg, &end, 10);
+
+  if (end == arg || *end != '\0' || v > max) {
+    return false;
+  }
+  *out = (uint32_t)v;
+  return true;
+}
+
+/* Pedal argument: a name, an index, or "all" (-1); -2 if none of them */
+static int arg_pedal(const char *arg) {
+  if (strcmp(arg, "all") == 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    if (strcmp(arg, s_names[i]) == 0) {
+      return (int)i;
+    }
+  }
+
+  uint32_t i;
+  return arg_u32(arg, MIDAL_NUM_PEDALS - 1U, &i) ? (int)i : -2;
+}
+
+int sim_player_command(size_t argc, char **argv) {
+  player_cmd_t cmd = CMD_COUNT;
+
+  for (size_t n = 0; argc > 0U && n < CMD_COUNT; n++) {
+    if (strcmp(argv[0], s_cmds[n].name) == 0) {
+      cmd = (player_cmd_t)n;
+    }
+  }
+  if (cmd == CMD_COUNT || argc != s_cmds[cmd].argc) {
+    return -EINVAL;
+  }
+
+  const int pedal = arg_pedal(argv[1]);
+  uint32_t lsb = 0U;
+  uint32_t ms = 0U;
+
+  if (pedal < -1) {
+    return -EINVAL;
+  }
+  if (argc > 2U && !arg_u32(argv[2], ADC_MAX_LSB, &lsb)) {
+    return -EINVAL;
+  }
+  if (argc > 3U && !arg_u32(argv[3], UINT16_MAX, &ms)) {
+    return -EINVAL;
+  }
+
+  const int64_t now = player_now_us();
+  k_spinlock_key_t key = k_spin_lock(&s_lock);
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    if (pedal < 0 || (size_t)pedal == i) {
+      pedal_apply(&s_pedals[i], cmd, lsb, ms, now);
+    }
+  }
+  k_spin_unlock(&s_lock, key);
+
+  return 0;
+}
+
+/* Sleep until t_us of uptime; false if the job was stopped meanwhile */
+static bool player_wait_until(int64_t t_us) {
+  return k_sem_take(&s_stop_sem, K_TIMEOUT_ABS_US(t_us)) != 0;
+}
+
+/* Split one command of len chars into line; returns the word count */
+static size_t player_split(const char *cmd, size_t len, char *line,
+                           char **argv) {
+  size_t argc = 0U;
+  char *p = line;
+
+  len = MIN(len, PLAYER_LINE_MAX - 1U);
+  memcpy(line, cmd, len);
+  line[len] = '\0';
+
+  while (*p != '\0') {
+    while (isspace((unsigned char)*p)) {
+      *p++ = '\0';
+    }
+    if (*p == '\0') {
+      break;
+    }
+    if (argc < PLAYER_ARGS_MAX) {
+      argv[argc] = p;
+    }
+    argc++;
+    while (*p != '\0' && !isspace((unsigned char)*p)) {
+      p++;
+    }
+  }
+
+  return argc;
+}
+
+static void player_script(void) {
+  const char *cmd = s_script;
+  int64_t t = player_now_us();
+  int64_t pass_start = t;
+
+  while (*cmd != '\0') {
+    char line[PLAYER_LINE_MAX];
+    char *argv[PLAYER_ARGS_MAX];
+    const char *end = strchr(cmd, ';');
+    const size_t len = (end != NULL) ? (size_t)(end - cmd) : strlen(cmd);
+    const size_t argc = player_split(cmd, len, line, argv);
+
+    cmd += len + ((end != NULL) ? 1U : 0U);
+    if (argc == 0U) {
+      continue;
+    }
+
+    if (strcmp(argv[0], "wait") == 0) {
+      uint32_t ms;
+      if (argc != 2U || !arg_u32(argv[1], UINT32_MAX / 1000U, &ms)) {
+        LOG_ERR("Script: wait <ms>");
+        return;
+      }
+      /* From the previous wait, so commands take no time of their own */
+      t += (int64_t)ms * 1000;
+      if (!player_wait_until(t)) {
+        return;
+      }
+      continue;
+    }
+
+    if (strcmp(argv[0], "loop") == 0) {
+      if (t == pass_start) {
+        LOG_ERR("Script: loop without a wait");
+        return;
+      }
+      pass_start = t;
+      cmd = s_script;
+      continue;
+    }
+
+    int err = (argc <= PLAYER_ARGS_MAX) ? sim_player_command(argc, argv)
+                                        : -EINVAL;
+    if (err != 0) {
+      LOG_ERR("Script stopped at \"%s\": %d", argv[0], err);
+      return;
+    }
+  }
+}
+
+static void player_csv(void) {
+  const char *p = s_csv;
+  const int64_t start = player_now_us();
+  uint32_t t0 = 0U;
+  size_t rows = 0U;
+
+  while (*p != '\0') {
+    const char *next = strchr(p, '\n');
+    next = (next != NULL) ? next + 1 : p + strlen(p);
+
+    /* Comments and the header row start with something else */
+    if (isdigit((unsigned char)*p)) {
+      int32_t v[MIDAL_NUM_PEDALS];
+      size_t n = 0U;
+      char *end;
+      const uint32_t t_us = strtoul(p, &end, 10);
+
+      while (n < MIDAL_NUM_PEDALS && *end == ',') {
+        v[n++] = strtol(end + 1, &end, 10);
+      }
+      if (rows == 0U) {
+        t0 = t_us;
+      }
+      if (!player_wait_until(start + (int64_t)(uint32_t)(t_us - t0))) {
+        break;
+      }
+
+      const int64_t now = player_now_us();
+      k_spinlock_key_t key = k_spin_lock(&s_lock);
+      for (size_t i = 0; i < n; i++) {
+        pedal_apply(&s_pedals[i], CMD_STEP,
+                    (uint32_t)CLAMP(v[i], 0, ADC_MAX_LSB), 0U, now);
+      }
+      k_spin_unlock(&s_lock, key);
+      rows++;
+    }
+
+    p = next;
+  }
+
+  LOG_INF("Trace replayed: %u rows", (unsigned)rows);
+}
+
+static void player_thread(void *p1, void *p2, void *p3) {
+  ARG_UNUSED(p1);
+  ARG_UNUSED(p2);
+  ARG_UNUSED(p3);
+
+  while (true) {
+    k_sem_take(&s_job_sem, K_FOREVER);
+
+    if (atomic_get(&s_job) == JOB_CSV) {
+      player_csv();
+      midal_sim_host_free(s_csv);
+      s_csv = NULL;
+    } else {
+      player_script();
+    }
+    atomic_set(&s_job, JOB_NONE);
+  }
+}
+
+int sim_player_run_script(const char *script) {
+  if (strlen(script) >= sizeof(s_script)) {
+    return -EINVAL;
+  }
+  if (!atomic_cas(&s_job, JOB_NONE, JOB_SCRIPT)) {
+    return -EBUSY;
+  }
+
+  strcpy(s_script, script);
+  k_sem_reset(&s_stop_sem);
+  k_sem_give(&s_job_sem);
+  return 0;
+}
+
+int sim_player_play_csv(const char *path) {
+  if (!atomic_cas(&s_job, JOB_NONE, JOB_CSV)) {
+    return -EBUSY;
+  }
+
+  s_csv = midal_sim_host_read(path, NULL);
+  if (s_csv == NULL) {
+    atomic_set(&s_job, JOB_NONE);
+    return -ENOENT;
+  }
+
+  k_sem_reset(&s_stop_sem);
+  k_sem_give(&s_job_sem);
+  return 0;
+}
+
+void sim_player_stop(void) {
+  if (atomic_get(&s_job) != JOB_NONE) {
+    k_sem_give(&s_stop_sem);
+  }
+}
+
+static void player_add_options(void) {
+  static struct args_struct_t options[] = {
+      {.option = "pedal-script",
+       .name = "script",
+       .type = 's',
+       .dest = (void *)&s_arg_script,
+       .descript = "Pedal player commands separated by ';' (see "
+                   "src/sim/sim_player.h)"},
+      {.option = "trajectory",
+       .name = "csv",
+       .type = 's',
+       .dest = (void *)&s_arg_trajectory,
+       .descript = "Replay a CSV trace of raw pedal readings"},
+      ARG_TABLE_ENDMARKER,
+  };
+
+  native_add_command_line_opts(options);
+}
+
+NATIVE_TASK(player_add_options, PRE_BOOT_1, 1);
+
+static int sim_player_init(void) {
+  if (!device_is_ready(s_adc)) {
+    LOG_ERR("ADC emulator not ready");
+    return -ENODEV;
+  }
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    s_pedals[i] = (sim_pedal_t){
+        .from = CONFIG_MIDAL_SIM_REST_LSB,
+        .to = CONFIG_MIDAL_SIM_REST_LSB,
+        .rng = 0x9E3779B9U + (uint32_t)i,
+    };
+
+    int err = adc_emul_value_func_set(s_adc, s_channels[i], player_adc_value,
+                                      &s_pedals[i]);
+    if (err != 0) {
+      LOG_ERR("Emulator channel %u: %d", s_channels[i], err);
+      return err;
+    }
+  }
+
+  k_thread_create(&player_thread_data, player_stack,
+                  K_THREAD_STACK_SIZEOF(player_stack), player_thread, NULL,
+                  NULL, NULL, PLAYER_THREAD_PRIORITY, 0, K_NO_WAIT);
+  k_thread_name_set(&player_thread_data, "sim-player");
+
+  int err = 0;
+  if (s_arg_trajectory != NULL) {
+    err = sim_player_play_csv(s_arg_trajectory);
+  } else if (s_arg_script != NULL) {
+    err = sim_player_run_script(s_arg_script);
+  } else if (strlen(CONFIG_MIDAL_SIM_SCRIPT) > 0U) {
+    err = sim_player_run_script(CONFIG_MIDAL_SIM_SCRIPT);
+  }
+  if (err != 0) {
+    LOG_ERR("Boot pedal job failed: %d", err);
+  }
+
+  return 0;
+}
+
+SYS_INIT(sim_player_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if IS_ENABLED(CONFIG_SHELL)
+
+static int cmd_sim_show(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  static const char *const jobs[] = {"idle", "script", "trace"};
+  sim_pedal_t p[MIDAL_NUM_PEDALS];
+  int32_t level[MIDAL_NUM_PEDALS];
+  const int64_t now = player_now_us();
+
+  k_spinlock_key_t key = k_spin_lock(&s_lock);
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    p[i] = s_pedals[i];
+    level[i] = pedal_level(&p[i], now);
+  }
+  k_spin_unlock(&s_lock, key);
+
+  shell_print(sh, "player %s", jobs[atomic_get(&s_job)]);
+  shell_print(sh, "%-10s %4s %6s %5s %s", "pedal", "chan", "level", "noise",
+              "input");
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    shell_print(sh, "%-10s %4u %6d %5u %s", s_names[i], s_channels[i],
+                level[i], p[i].noise,
+                p[i].unplugged ? "unplugged"
+                               : ((level[i] != p[i].to) ? "ramping" : "held"));
+  }
+  return 0;
+}
+
+static int cmd_sim_apply(const struct shell *sh, size_t argc, char **argv) {
+  int err = sim_player_command(argc, argv);
+  if (err != 0) {
+    shell_error(sh, "bad arguments: %d", err);
+  }
+  return err;
+}
+
+static int cmd_sim_run(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+
+  int err = sim_player_run_script(argv[1]);
+  if (err != 0) {
+    shell_error(sh, "not started: %d", err);
+  }
+  return err;
+}
+
+static int cmd_sim_play(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(argc);
+
+  int err = sim_player_play_csv(argv[1]);
+  if (err != 0) {
+    shell_error(sh, "not started: %d", err);
+  }
+  return err;
+}
+
+static int cmd_sim_stop(const struct shell *sh, size_t argc, char **argv) {
+  ARG_UNUSED(sh);
+  ARG_UNUSED(argc);
+  ARG_UNUSED(argv);
+
+  sim_player_stop();
+  return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    sim_cmds,
+    SHELL_CMD_ARG(step, NULL, "Jump to a level: step <pedal|all> <lsb>",
+                  cmd_sim_apply, 3, 0),
+    SHELL_CMD_ARG(ramp, NULL, "Move linearly: ramp <pedal|all> <lsb> <ms>",
+                  cmd_sim_apply, 4, 0),
+    SHELL_CMD_ARG(noise, NULL, "Uniform noise: noise <pedal|all> <lsb>",
+                  cmd_sim_apply, 3, 0),
+    SHELL_CMD_ARG(unplug, NULL, "Disconnect a sensor: unplug <pedal|all>",
+                  cmd_sim_apply, 2, 0),
+    SHELL_CMD_ARG(plug, NULL, "Reconnect a sensor: plug <pedal|all>",
+                  cmd_sim_apply, 2, 0),
+    SHELL_CMD_ARG(run, NULL, "Run a script: run \"<cmd>; wait <ms>; ...\"",
+                  cmd_sim_run, 2, 0),
+    SHELL_CMD_ARG(play, NULL, "Replay a CSV trace: play <host file>",
+                  cmd_sim_play, 2, 0),
+    SHELL_CMD(stop, NULL, "End the script or trace", cmd_sim_stop),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_SUBCMD_ADD((midal), sim, &sim_cmds, "Emulated pedal inputs",
+                 cmd_sim_show, 1, 0);
+
+#endif
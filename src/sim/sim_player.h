@@ -0,0 +1,39 @@
+#pragma once
+
+#include <zephyr/kernel.h>
+
+/**
+ * @file sim_player.h
+ * @brief Pedal trajectory player for the native_sim harness
+ *
+ * Drives the ADC emulator channels of the pedals (CONFIG_MIDAL_SIM). Every
+ * conversion reads the level of its pedal at that instant, in raw ADC LSB:
+ *
+ *   step <pedal|all> <lsb>        jump to a level
+ *   ramp <pedal|all> <lsb> <ms>   move linearly from the current level
+ *   noise <pedal|all> <lsb>       add uniform noise of +-lsb (0 = none)
+ *   unplug <pedal|all>            read CONFIG_MIDAL_SIM_UNPLUG_LSB
+ *   plug <pedal|all>              back to the level
+ *
+ * Pedals are sustain, sostenuto, soft or their index. A script is a list of
+ * commands separated by ';' where "wait <ms>" waits (a ramp does not) and a
+ * final "loop" starts it over. A CSV trace holds one row per scan,
+ * "t_us,raw0,raw1,..." (more columns are ignored, so a flight recorder dump
+ * replays as is), applied as steps at the recorded times.
+ *
+ * The boot job comes from --trajectory=<csv>, --pedal-script=<script> or
+ * CONFIG_MIDAL_SIM_SCRIPT; with CONFIG_SHELL, "midal sim" runs commands,
+ * scripts and traces at runtime.
+ */
+
+/* Apply one command at once ("wait" and "loop" are script only) */
+int sim_player_command(size_t argc, char **argv);
+
+/* Run a script on the player thread; -EBUSY while a job runs */
+int sim_player_run_script(const char *script);
+
+/* Replay a CSV trace from a host file on the player thread */
+int sim_player_play_csv(const char *path);
+
+/* End the running script or trace; levels hold where they are */
+void sim_player_stop(void);
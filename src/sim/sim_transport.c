@@ -0,0 +1,430 @@
+/*
+ * Recording USB and BLE MIDI transports for the native_sim harness
+ * (CONFIG_MIDAL_SIM), built instead of src/usbd and the real transports.
+ *
+ * Each link subscribes to the pedal frame channel, stages and encodes like
+ * the transport it stands in for, and records every sent CC. The host link
+ * never pushes back; what is modelled is when the data leaves: at the next
+ * USB frame, or at the next BLE connection event. The latency probes and
+ * transport counters are fed as on hardware, so the heartbeat, "midal
+ * latency" and the profiler read the same way.
+ *
+ * --midi-log=<file> writes the recorded CCs as CSV
+ * (link,capture_us,send_us,done_us,ch,cc,value); a summary is printed when
+ * the simulation exits (e.g. with --stop_at=<s>).
+ */
+
+#include "boot.h"
+#include "diag/latency.h"
+#include "diag/profiler.h"
+#include "diag/stats.h"
+#include "midi/midi_cc_stage.h"
+#include "midi/midi_codec.h"
+#include "midi/midi_types.h"
+#include "sim_host.h"
+#include "transports/transport_ble_midi.h"
+#include "transports/transport_usb_midi.h"
+#include "usbd/midi.h"
+#include "usbd/usbd.h"
+#include "zbus_channels.h"
+
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+/* native_sim command line and exit hook */
+#include "cmdline.h"
+#include "soc.h"
+
+LOG_MODULE_REGISTER(sim_transport, LOG_LEVEL_INF);
+
+/* Thread settings of the transports they stand in for */
+#define SIM_LINK_THREAD_PRIORITY 5
+#define SIM_LINK_THREAD_STACK_SIZE 1024
+
+/* Full-speed USB: the host polls the bulk IN endpoint once per frame */
+#define SIM_USB_FRAME_US 1000U
+/* The BLE link at the requested minimum connection interval */
+#define SIM_BLE_INTERVAL_US (CONFIG_MIDAL_BLE_CONN_INT_MIN * 1250U)
+/* ATT MTU and data length prj.conf asks for */
+#define SIM_BLE_MTU 247U
+#define SIM_BLE_TX_OCTETS 251U
+
+/* Largest System Exclusive body transport_usb_send_sysex() takes */
+#define SIM_SYSEX_MAX 64U
+
+ZBUS_MSG_SUBSCRIBER_DEFINE(sim_usb_sub);
+ZBUS_MSG_SUBSCRIBER_DEFINE(sim_ble_sub);
+
+typedef struct {
+  const char *name;
+  const struct zbus_observer *sub;
+  latency_probe_t lat_dequeue;
+  latency_probe_t lat_send;
+  latency_probe_t lat_last; /* usb.queued or ble.done */
+  prof_stage_t prof;
+  bool ump;           /* UMPs (USB), else MIDI 1.0 messages (BLE) */
+  uint32_t period_us; /* Data leaves at the next multiple of this */
+  atomic_t ready;
+  atomic_t sent;
+  atomic_t packets;      /* UMPs or MIDI messages */
+  atomic_t batches;      /* Flushes (USB) or connection events used (BLE) */
+  atomic_t stamp_lag_us; /* Largest capture-to-queue delay */
+  atomic_t turn_avg_us;  /* Queue-to-departure, running mean */
+  atomic_t turn_max_us;
+  uint32_t last_done_us; /* Departure of the previous event */
+  midi_cc_stage_t stage;
+  midi_codec_t codec;
+  struct k_thread thread;
+} sim_link_t;
+
+static sim_link_t s_usb = {
+    .name = "usb",
+    .sub = &sim_usb_sub,
+    .lat_dequeue = LATENCY_USB_DEQUEUE,
+    .lat_send = LATENCY_USB_SEND,
+    .lat_last = LATENCY_USB_QUEUED,
+    .prof = PROF_ENCODE_USB,
+    .ump = true,
+    .period_us = SIM_USB_FRAME_US,
+};
+
+static sim_link_t s_ble = {
+    .name = "ble",
+    .sub = &sim_ble_sub,
+    .lat_dequeue = LATENCY_BLE_DEQUEUE,
+    .lat_send = LATENCY_BLE_SEND,
+    .lat_last = LATENCY_BLE_DONE,
+    .prof = PROF_ENCODE_BLE,
+    .ump = false,
+    .period_us = SIM_BLE_INTERVAL_US,
+};
+
+static K_THREAD_STACK_ARRAY_DEFINE(sim_link_stacks, 2,
+                                   SIM_LINK_THREAD_STACK_SIZE);
+
+static char *s_arg_midi_log;
+static void *s_midi_log;
+
+/* Packets of one event as the real transport would queue them */
+static size_t sim_link_encode(sim_link_t *link, const midi_event_t *ev) {
+  uint32_t t0 = prof_cycles();
+  size_t n;
+
+  if (link->ump) {
+    uint32_t w[MIDI_CODEC_UMP_MAX];
+
+    n = midi_codec_ump_midi1(&link->codec, ev, 0, w, ARRAY_SIZE(w));
+    if (IS_ENABLED(CONFIG_MIDAL_USB_MIDI2_NATIVE) &&
+        midi_codec_ump_midi2(&link->codec, ev, 0, w, ARRAY_SIZE(w)) == 2U) {
+      n++;
+    }
+  } else {
+    uint8_t msg[MIDI_CODEC_MIDI1_MAX];
+
+    n = midi_codec_midi1(&link->codec, ev, msg, sizeof(msg)) / 3U;
+  }
+
+  prof_end(link->prof, t0);
+  return n;
+}
+
+static void sim_link_record(sim_link_t *link, const midi_event_t *ev,
+                            uint32_t now, uint32_t done) {
+  if (s_midi_log == NULL) {
+    return;
+  }
+
+  char line[64];
+
+  snprintk(line, sizeof(line), "%s,%u,%u,%u,%u,%u,%u", link->name,
+           ev->timestamp_us, now, done, ev->cc.ch, ev->cc.cc, ev->cc.value);
+  midal_sim_host_puts(s_midi_log, line);
+}
+
+static void sim_link_tx(sim_link_t *link, const midi_event_t *ev,
+                        uint32_t now) {
+  const size_t n = sim_link_encode(link, ev);
+  const uint32_t done = (now / link->period_us + 1U) * link->period_us;
+  const uint32_t turn = done - now;
+
+  latency_record_at(link->lat_send, ev->timestamp_us, now);
+  /* The USB transport only sees the class TX work run, right after a flush */
+  latency_record_at(link->lat_last, ev->timestamp_us, link->ump ? now : done);
+  sim_link_record(link, ev, now, done);
+
+  atomic_add(&link->packets, (atomic_val_t)n);
+  if (!link->ump && done != link->last_done_us) {
+    link->last_done_us = done;
+    atomic_inc(&link->batches);
+  }
+
+  /* Only this thread writes these */
+  uint32_t lag = now - ev->timestamp_us;
+  if (lag > (uint32_t)atomic_get(&link->stamp_lag_us)) {
+    atomic_set(&link->stamp_lag_us, (atomic_val_t)lag);
+  }
+  int32_t avg = (int32_t)atomic_get(&link->turn_avg_us);
+  avg = (avg == 0) ? (int32_t)turn : avg + ((int32_t)turn - avg) / 8;
+  atomic_set(&link->turn_avg_us, avg);
+  if (turn > (uint32_t)atomic_get(&link->turn_max_us)) {
+    atomic_set(&link->turn_max_us, (atomic_val_t)turn);
+  }
+}
+
+static void sim_link_flush(sim_link_t *link) {
+  const uint32_t now = k_ticks_to_us_floor32(k_uptime_ticks());
+  const midi_event_t *ev;
+  bool any = false;
+
+  while ((ev = midi_cc_stage_next(&link->stage, now)) != NULL) {
+    if (ev->type != MIDI_EV_CC) {
+      midi_cc_stage_drop(&link->stage);
+      continue;
+    }
+
+    sim_link_tx(link, ev, now);
+    midi_cc_stage_sent(&link->stage);
+    atomic_inc(&link->sent);
+    any = true;
+  }
+
+  /* The USB transport counts flushes, as its class driver hides transfers */
+  if (link->ump && any) {
+    atomic_inc(&link->batches);
+  }
+}
+
+static void sim_link_thread(void *p1, void *p2, void *p3) {
+  ARG_UNUSED(p2);
+  ARG_UNUSED(p3);
+
+  sim_link_t *link = p1;
+  const struct zbus_channel *chan;
+  pedal_frame_t frame;
+
+  while (true) {
+    k_timeout_t wait = midi_cc_stage_pending(&link->stage)
+                           ? K_USEC(link->period_us)
+                           : K_FOREVER;
+
+    /* Wait for a pedal frame from zbus, then fold in the backlog */
+    int ret = zbus_sub_wait_msg(link->sub, &chan, &frame, wait);
+    while (ret == 0) {
+      if (chan == &pedal_frame_chan) {
+        latency_record(link->lat_dequeue, frame.timestamp_us);
+        midi_cc_stage_put_frame(&link->stage, &frame);
+      }
+      ret = zbus_sub_wait_msg(link->sub, &chan, &frame, K_NO_WAIT);
+    }
+    if (ret != -ENOMSG) {
+      LOG_ERR("%s recorder zbus_sub_wait_msg failed: %d", link->name, ret);
+    }
+
+    sim_link_flush(link);
+  }
+}
+
+static int sim_link_start(sim_link_t *link, k_thread_stack_t *stack,
+                          uint8_t codec_flags, uint32_t max_age_ms) {
+  midi_cc_stage_init(&link->stage, max_age_ms * 1000U);
+  midi_codec_init(&link->codec, codec_flags);
+
+  int ret = zbus_chan_add_obs(&pedal_frame_chan, link->sub, K_MSEC(100));
+  if (ret != 0) {
+    LOG_ERR("Failed to subscribe %s recorder to pedal_frame_chan: %d",
+            link->name, ret);
+    return ret;
+  }
+
+  k_thread_create(&link->thread, stack,
+                  K_THREAD_STACK_SIZEOF(sim_link_stacks[0]),
+                  sim_link_thread, link, NULL, NULL, SIM_LINK_THREAD_PRIORITY,
+                  0, K_NO_WAIT);
+  k_thread_name_set(&link->thread, link->ump ? "usb-midi" : "ble-midi");
+
+  atomic_set(&link->ready, 1);
+  LOG_INF("%s MIDI replaced by a recorder (%u us link period)", link->name,
+          link->period_us);
+  return 0;
+}
+
+static void sim_link_stats(sim_link_t *link, struct transport_stats *stats) {
+  stats->sent = (uint32_t)atomic_get(&link->sent);
+  stats->coalesced = (uint32_t)atomic_get(&link->stage.coalesced);
+  stats->aged = (uint32_t)atomic_get(&link->stage.aged);
+  stats->dropped = (uint32_t)atomic_get(&link->stage.lost);
+  stats->packets = (uint32_t)atomic_get(&link->packets);
+  stats->batches = (uint32_t)atomic_get(&link->batches);
+  stats->stamp_lag_us =
+      link->ump ? 0U : (uint32_t)atomic_get(&link->stamp_lag_us);
+}
+
+/* src/usbd stand-ins: there is no device controller to enable */
+int usbd_enable_device(void) { return 0; }
+
+int usbd_midi_init(void) { return 0; }
+
+int transport_usb_midi_init(void) {
+  int ret = sim_link_start(
+      &s_usb, sim_link_stacks[0],
+      IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? MIDI_CODEC_14BIT : 0U,
+      CONFIG_MIDAL_USB_MAX_AGE_MS);
+  if (ret == 0) {
+    /* The host "enumerates" at once */
+    transport_usb_notify_ready(true);
+  }
+  return ret;
+}
+
+void transport_usb_notify_ready(bool ready) {
+  atomic_set(&s_usb.ready, ready ? 1 : 0);
+  if (ready) {
+    boot_mark(BOOT_PHASE_USB_READY);
+  }
+}
+
+bool transport_usb_ready(void) { return atomic_get(&s_usb.ready) != 0; }
+
+int transport_usb_send_sysex(const uint8_t *data, size_t len,
+                             k_timeout_t timeout) {
+  ARG_UNUSED(timeout);
+
+  uint32_t words[MIDI_CODEC_SYSEX7_WORDS(SIM_SYSEX_MAX)];
+
+  if (!transport_usb_ready()) {
+    return -ENOTCONN;
+  }
+
+  size_t n = midi_codec_ump_sysex7(0, data, len, words, ARRAY_SIZE(words));
+  if (n == 0U) {
+    return -EMSGSIZE;
+  }
+
+  /* One flush per UMP, as the USB transport sends them */
+  atomic_add(&s_usb.packets, (atomic_val_t)(n / 2U));
+  atomic_add(&s_usb.batches, (atomic_val_t)(n / 2U));
+  return 0;
+}
+
+void transport_usb_get_stats(struct transport_stats *stats) {
+  if (stats != NULL) {
+    sim_link_stats(&s_usb, stats);
+  }
+}
+
+int transport_ble_midi_init(void) {
+  return sim_link_start(&s_ble, sim_link_stacks[1],
+                        IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC)
+                            ? (MIDI_CODEC_14BIT | MIDI_CODEC_LSB)
+                            : 0U,
+                        CONFIG_MIDAL_BLE_MAX_AGE_MS);
+}
+
+bool transport_ble_midi_ready(void) { return atomic_get(&s_ble.ready) != 0; }
+
+void transport_ble_get_stats(struct transport_stats *stats) {
+  if (stats != NULL) {
+    sim_link_stats(&s_ble, stats);
+  }
+}
+
+void transport_ble_get_link_stats(struct ble_link_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  *stats = (struct ble_link_stats){
+      .connected = transport_ble_midi_ready(),
+      .interval_us = SIM_BLE_INTERVAL_US,
+      .tx_phy = BT_GAP_LE_PHY_2M,
+      .rx_phy = BT_GAP_LE_PHY_2M,
+      .mtu = SIM_BLE_MTU,
+      .tx_octets = SIM_BLE_TX_OCTETS,
+      .turnaround_avg_us = (uint32_t)atomic_get(&s_ble.turn_avg_us),
+      .turnaround_max_us = (uint32_t)atomic_get(&s_ble.turn_max_us),
+  };
+}
+
+static void sim_add_options(void) {
+  static struct args_struct_t options[] = {
+      {.option = "midi-log",
+       .name = "csv",
+       .type = 's',
+       .dest = (void *)&s_arg_midi_log,
+       .descript = "Record every CC the USB and BLE recorders send"},
+      ARG_TABLE_ENDMARKER,
+  };
+
+  native_add_command_line_opts(options);
+}
+
+NATIVE_TASK(sim_add_options, PRE_BOOT_1, 1);
+
+static void sim_open_log(void) {
+  if (s_arg_midi_log == NULL) {
+    return;
+  }
+
+  s_midi_log = midal_sim_host_create(s_arg_midi_log);
+  if (s_midi_log == NULL) {
+    midal_sim_host_print("[sim] cannot create the MIDI log");
+    return;
+  }
+  midal_sim_host_puts(s_midi_log, "link,capture_us,send_us,done_us,ch,cc,value");
+}
+
+NATIVE_TASK(sim_open_log, PRE_BOOT_2, 1);
+
+static void sim_summary_link(const sim_link_t *link, uint32_t up_ms) {
+  const uint32_t sent = (uint32_t)atomic_get(&link->sent);
+  const uint32_t per_s_x10 =
+      (up_ms > 0U) ? (uint32_t)(((uint64_t)sent * 10000U) / up_ms) : 0U;
+  char line[256];
+  int n = snprintk(line, sizeof(line),
+                   "[sim] %s sent=%u rate=%u.%u/s coalesced=%u aged=%u"
+                   " packets=%u batches=%u",
+                   link->name, sent, per_s_x10 / 10U, per_s_x10 % 10U,
+                   (uint32_t)atomic_get(&link->stage.coalesced),
+                   (uint32_t)atomic_get(&link->stage.aged),
+                   (uint32_t)atomic_get(&link->packets),
+                   (uint32_t)atomic_get(&link->batches));
+
+#if IS_ENABLED(CONFIG_MIDAL_LATENCY)
+  struct latency_stats st;
+
+  latency_get_stats(link->lat_last, &st);
+  n += snprintk(&line[n], sizeof(line) - (size_t)n,
+                " capture->%s p50=%u p99=%u max=%uus",
+                latency_probe_name(link->lat_last), st.p50_us, st.p99_us,
+                st.max_us);
+#endif
+  /* Modelled wait for the USB frame or connection event */
+  snprintk(&line[n], sizeof(line) - (size_t)n, " depart=+%u/%uus",
+           (uint32_t)atomic_get(&link->turn_avg_us),
+           (uint32_t)atomic_get(&link->turn_max_us));
+  midal_sim_host_print(line);
+}
+
+/*
+ * Figures of the whole run, for scripts comparing builds. Runs in the
+ * runner after the kernel stopped: atomics only, printed by the host.
+ */
+static void sim_summary(void) {
+  const uint32_t up_ms = k_uptime_get_32();
+  char line[32];
+
+  snprintk(line, sizeof(line), "[sim] uptime=%ums", up_ms);
+  midal_sim_host_print(line);
+  sim_summary_link(&s_usb, up_ms);
+  sim_summary_link(&s_ble, up_ms);
+
+  midal_sim_host_close(s_midi_log);
+  s_midi_log = NULL;
+}
+
+NATIVE_TASK(sim_summary, ON_EXIT_PRE, 1);
@@ -1,5 +1,9 @@
 #include "transport_ble_midi.h"
+#include "diag/latency.h"
+#include "diag/profiler.h"
 #include "diag/stats.h"
+#include "midi/midi_cc_stage.h"
+#include "midi/midi_codec.h"
 #include "midi/midi_types.h"
 #include "zbus_channels.h"
 
@@ -7,6 +11,7 @@
 
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/atomic.h>
@@ -14,21 +19,256 @@
 
 LOG_MODULE_REGISTER(transport_ble_midi, LOG_LEVEL_INF);
 
-/* Zbus message subscriber for MIDI events */
+/* Zbus message subscriber for pedal frames */
 ZBUS_MSG_SUBSCRIBER_DEFINE(ble_midi_sub);
 
 struct transport_ble_ctx {
   atomic_t ready;
   atomic_t sent;
-  atomic_t dropped;
+  atomic_t packets;      /* MIDI messages queued into BLE MIDI packets */
+  atomic_t batches;      /* BLE MIDI packets notified */
+  atomic_t stamp_lag_us; /* Largest capture-to-queue delay */
+  midi_cc_stage_t stage; /* Newest unsent value per controller */
+  midi_codec_t codec;
 };
 
 static struct transport_ble_ctx ble_ctx = {
     .ready = ATOMIC_INIT(0),
 };
 
+BUILD_ASSERT(CONFIG_MIDAL_BLE_CONN_INT_MIN <= CONFIG_MIDAL_BLE_CONN_INT_MAX,
+             "MIDAL_BLE_CONN_INT_MIN must not exceed MIDAL_BLE_CONN_INT_MAX");
+
+/* Give the central time to finish service discovery before asking */
+#define BLE_LINK_TUNE_DELAY_MS 500
+/*
+ * Spacing of the relaxed retries after a refused interval, and how long an
+ * unanswered request stays in flight before it counts as refused.
+ */
+#define BLE_LINK_RETRY_MS 2000
+/* Interval requests: as configured, then the maximum doubled per refusal */
+#define BLE_LINK_ATTEMPTS 3
+
+/*
+ * Connection manager state. Written from the Bluetooth RX thread and the
+ * system work queue (both cooperative), read from anywhere.
+ */
+struct ble_link {
+  struct bt_conn *conn;
+  uint8_t attempt;      /* Index of the latest interval request */
+  bool in_flight;       /* That request is still unanswered */
+  bool tuned;           /* PHY and data length requested */
+  atomic_t interval_us; /* 0 while not connected */
+  atomic_t latency;
+  atomic_t tx_phy; /* BT_GAP_LE_PHY_* */
+  atomic_t rx_phy;
+  atomic_t mtu;
+  atomic_t tx_octets;
+  atomic_t rejects;          /* Our interval requests refused or ignored */
+  atomic_t first_queued_us;  /* Oldest message of the packet in flight */
+  atomic_t first_capture_us; /* ...and the capture time of its scan */
+  atomic_t turn_avg_us;      /* Running mean (1/8 weight per packet) */
+  atomic_t turn_max_us;
+};
+
+static struct ble_link s_link;
+
+static void link_tune_work(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(s_link_tune_work, link_tune_work);
+
+static uint16_t link_attempt_max(uint8_t attempt) {
+  return (uint16_t)MIN(CONFIG_MIDAL_BLE_CONN_INT_MAX << attempt, 3200);
+}
+
+static uint16_t link_attempt_min(uint8_t attempt) {
+  return (attempt == 0U) ? CONFIG_MIDAL_BLE_CONN_INT_MIN
+                         : link_attempt_max((uint8_t)(attempt - 1U));
+}
+
+/* The central refused or ignored our request: relax the range and retry */
+static void link_request_refused(void) {
+  s_link.in_flight = false;
+  atomic_inc(&s_link.rejects);
+  if (s_link.attempt + 1U < BLE_LINK_ATTEMPTS) {
+    s_link.attempt++;
+    k_work_reschedule(&s_link_tune_work, K_MSEC(BLE_LINK_RETRY_MS));
+  }
+}
+
+static void link_tune_work(struct k_work *work) {
+  ARG_UNUSED(work);
+
+  struct bt_conn *conn = s_link.conn;
+  if (conn == NULL) {
+    return;
+  }
+
+  /* No update followed the previous request (an L2CAP reject has none) */
+  if (s_link.in_flight) {
+    link_request_refused();
+    return;
+  }
+
+  if (!s_link.tuned) {
+    s_link.tuned = true;
+#if IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE)
+    int perr = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (perr != 0) {
+      LOG_WRN("BLE 2M PHY request failed (%d)", perr);
+    }
+#endif
+#if IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    int derr = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (derr != 0) {
+      LOG_WRN("BLE data length request failed (%d)", derr);
+    }
+#endif
+  }
+
+  const uint16_t int_min = link_attempt_min(s_link.attempt);
+  const uint16_t int_max = link_attempt_max(s_link.attempt);
+  const struct bt_le_conn_param param = {
+      .interval_min = int_min,
+      .interval_max = int_max,
+      .latency = 0,
+      .timeout = CONFIG_MIDAL_BLE_CONN_TIMEOUT,
+  };
+
+  LOG_INF("BLE requesting interval %u-%u (x1.25 ms)", int_min, int_max);
+  int err = bt_conn_le_param_update(conn, &param);
+  if (err == 0) {
+    s_link.in_flight = true;
+    k_work_reschedule(&s_link_tune_work, K_MSEC(BLE_LINK_RETRY_MS));
+  } else if (err != -EALREADY) {
+    LOG_WRN("BLE interval request failed (%d)", err);
+    link_request_refused();
+  }
+}
+
+static void link_set_interval(uint16_t interval, uint16_t latency) {
+  /* Units of 1.25 ms */
+  atomic_set(&s_link.interval_us, (atomic_val_t)interval * 1250);
+  atomic_set(&s_link.latency, latency);
+}
+
+static void link_connected(struct bt_conn *conn, uint8_t err) {
+  struct bt_conn_info info;
+
+  if (err != 0U || s_link.conn != NULL) {
+    return;
+  }
+
+  s_link.conn = bt_conn_ref(conn);
+  s_link.attempt = 0U;
+  s_link.in_flight = false;
+  s_link.tuned = false;
+  atomic_set(&s_link.tx_phy, BT_GAP_LE_PHY_1M);
+  atomic_set(&s_link.rx_phy, BT_GAP_LE_PHY_1M);
+  atomic_set(&s_link.mtu, 23);       /* ATT default */
+  atomic_set(&s_link.tx_octets, 27); /* LL default */
+  atomic_clear(&s_link.first_queued_us);
+  atomic_clear(&s_link.first_capture_us);
+
+  if (bt_conn_get_info(conn, &info) == 0) {
+    link_set_interval(info.le.interval, info.le.latency);
+    LOG_INF("BLE connected, interval %u us",
+            (uint32_t)atomic_get(&s_link.interval_us));
+  }
+
+  k_work_reschedule(&s_link_tune_work, K_MSEC(BLE_LINK_TUNE_DELAY_MS));
+}
+
+static void link_disconnected(struct bt_conn *conn, uint8_t reason) {
+  ARG_UNUSED(reason);
+
+  if (conn != s_link.conn) {
+    return;
+  }
+
+  k_work_cancel_delayable(&s_link_tune_work);
+  bt_conn_unref(s_link.conn);
+  s_link.conn = NULL;
+  atomic_clear(&s_link.interval_us);
+  atomic_clear(&s_link.first_queued_us);
+  atomic_clear(&s_link.first_capture_us);
+}
+
+static void link_param_updated(struct bt_conn *conn, uint16_t interval,
+                               uint16_t latency, uint16_t timeout) {
+  ARG_UNUSED(timeout);
+
+  if (conn != s_link.conn) {
+    return;
+  }
+
+  link_set_interval(interval, latency);
+  LOG_INF("BLE interval now %u us, latency %u",
+          (uint32_t)atomic_get(&s_link.interval_us), latency);
+
+  /* Central-initiated updates are taken as they come */
+  if (!s_link.in_flight) {
+    return;
+  }
+
+  /* Our request was answered, but with a slower interval than asked for */
+  if (interval > link_attempt_max(s_link.attempt)) {
+    link_request_refused();
+  } else {
+    s_link.in_flight = false;
+    k_work_cancel_delayable(&s_link_tune_work);
+  }
+}
+
+#if IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE)
+static void link_phy_updated(struct bt_conn *conn,
+                             struct bt_conn_le_phy_info *param) {
+  if (conn != s_link.conn) {
+    return;
+  }
+  atomic_set(&s_link.tx_phy, param->tx_phy);
+  atomic_set(&s_link.rx_phy, param->rx_phy);
+}
+#endif
+
+#if IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE)
+static void link_data_len_updated(struct bt_conn *conn,
+                                  struct bt_conn_le_data_len_info *info) {
+  if (conn != s_link.conn) {
+    return;
+  }
+  atomic_set(&s_link.tx_octets, info->tx_max_len);
+}
+#endif
+
+BT_CONN_CB_DEFINE(ble_link_conn_cb) = {
+    .connected = link_connected,
+    .disconnected = link_disconnected,
+    .le_param_updated = link_param_updated,
+#if IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE)
+    .le_phy_updated = link_phy_updated,
+#endif
+#if IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE)
+    .le_data_len_updated = link_data_len_updated,
+#endif
+};
+
+static void link_mtu_updated(struct bt_conn *conn, uint16_t tx, uint16_t rx) {
+  if (conn != s_link.conn) {
+    return;
+  }
+  atomic_set(&s_link.mtu, MIN(tx, rx));
+}
+
+static struct bt_gatt_cb ble_link_gatt_cb = {
+    .att_mtu_updated = link_mtu_updated,
+};
+
 #define BLE_MIDI_THREAD_PRIORITY 5
 #define BLE_MIDI_THREAD_STACK_SIZE 1024
+/* Retry staged updates at about the shortest connection interval */
+#define BLE_MIDI_RETRY_MS 5
+/* ...and at this pace while no central is connected */
+#define BLE_MIDI_OFFLINE_RETRY_MS 100
 static struct k_thread ble_midi_thread_data;
 K_THREAD_STACK_DEFINE(ble_midi_stack, BLE_MIDI_THREAD_STACK_SIZE);
 static void ble_midi_thread(void *, void *, void *);
@@ -83,8 +323,30 @@ static void ble_ready_handler(ble_midi_ready_state_t state) {
   }
 }
 
+/*
+ * One BLE MIDI packet (one notification) went out. Turnaround runs from its
+ * oldest message being queued to here.
+ */
 static void ble_tx_done_handler(void) {
-  /* No-op for now, but hook retained for future telemetry. */
+  uint32_t t0 = (uint32_t)atomic_clear(&s_link.first_queued_us);
+  uint32_t cap = (uint32_t)atomic_clear(&s_link.first_capture_us);
+  uint32_t now = k_ticks_to_us_floor32(k_uptime_ticks());
+
+  atomic_inc(&ble_ctx.batches);
+  if (cap != 0U) {
+    latency_record_at(LATENCY_BLE_DONE, cap, now);
+  }
+  if (t0 == 0U) {
+    return;
+  }
+
+  uint32_t turn = now - t0;
+  int32_t avg = (int32_t)atomic_get(&s_link.turn_avg_us);
+  avg = (avg == 0) ? (int32_t)turn : avg + ((int32_t)turn - avg) / 8;
+  atomic_set(&s_link.turn_avg_us, avg);
+  if (turn > (uint32_t)atomic_get(&s_link.turn_max_us)) {
+    atomic_set(&s_link.turn_max_us, (atomic_val_t)turn);
+  }
 }
 
 static struct ble_midi_callbacks callbacks = {
@@ -107,44 +369,37 @@ static int ble_midi_tx(void *ctx_ptr, const midi_event_t *ev) {
     return -EAGAIN;
   }
 
-  uint16_t value = ev->cc.value;
-
-  uint8_t status = 0xB0 | (ev->cc.ch & 0x0F);
-  uint8_t controller = ev->cc.cc & 0x7F;
-
-  if (IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC)) {
-    if (value > 16383U) {
-      value = 16383U;
-    }
-  } else if (value > 127U) {
-    value = 127U;
-  }
-
-  uint8_t msb = 0U;
-  if (IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC)) {
-    uint16_t msb16 = (uint16_t)((value + 0x40U) >> 7);
-    if (msb16 > 127U) {
-      msb16 = 127U;
+  /* 0 means no message waiting, so one queued at t=0 reads as 1 us */
+  const uint32_t now = MAX(k_ticks_to_us_floor32(k_uptime_ticks()), 1U);
+
+  /* Whole messages, status included: the module builds the packet */
+  uint8_t msg[MIDI_CODEC_MIDI1_MAX];
+  uint32_t t0 = prof_cycles();
+  size_t len = midi_codec_midi1(&ble_ctx.codec, ev, msg, sizeof(msg));
+  prof_end(PROF_ENCODE_BLE, t0);
+
+  /*
+   * The module stamps each message as it is queued and sends the packet at
+   * the next connection event, so queueing right after capture gives the
+   * receiver the capture time to de-jitter against. A failed write means
+   * the packet is full until then: retry with the newest.
+   */
+  for (size_t off = 0; off < len; off += 3U) {
+    enum ble_midi_error_t rc = ble_midi_tx_msg(&msg[off]);
+    if (rc != BLE_MIDI_SUCCESS) {
+      return -EAGAIN;
     }
-    msb = (uint8_t)msb16;
-  } else {
-    msb = (uint8_t)value;
+    atomic_inc(&ble_ctx.packets);
+    (void)atomic_cas(&s_link.first_queued_us, 0, (atomic_val_t)now);
+    (void)atomic_cas(&s_link.first_capture_us, 0,
+                     (atomic_val_t)MAX(ev->timestamp_us, 1U));
   }
+  latency_record_at(LATENCY_BLE_SEND, ev->timestamp_us, now);
 
-  uint8_t msg[3] = {status, controller, msb & 0x7F};
-
-  enum ble_midi_error_t rc = ble_midi_tx_msg(msg);
-  if (rc != BLE_MIDI_SUCCESS) {
-    return -EIO;
-  }
-
-  if (IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) && controller < 32U) {
-    uint8_t lsb_msg[3] = {status, (uint8_t)(controller + 32U),
-                          (uint8_t)(value & 0x7F)};
-    rc = ble_midi_tx_msg(lsb_msg);
-    if (rc != BLE_MIDI_SUCCESS) {
-      return -EIO;
-    }
+  /* Only this thread writes the maximum */
+  uint32_t lag = now - ev->timestamp_us;
+  if (lag > (uint32_t)atomic_get(&ble_ctx.stamp_lag_us)) {
+    atomic_set(&ble_ctx.stamp_lag_us, (atomic_val_t)lag);
   }
 
   return 0;
@@ -157,6 +412,8 @@ int transport_ble_midi_init(void) {
     return err;
   }
 
+  bt_gatt_cb_register(&ble_link_gatt_cb);
+
   enum ble_midi_error_t rc = ble_midi_init(&callbacks);
   if (rc != BLE_MIDI_SUCCESS && rc != BLE_MIDI_ALREADY_INITIALIZED) {
     LOG_ERR("ble_midi_init failed (%d)", rc);
@@ -164,12 +421,18 @@ int transport_ble_midi_init(void) {
   }
 
   atomic_clear(&ble_ctx.sent);
-  atomic_clear(&ble_ctx.dropped);
-
-  /* Subscribe to MIDI event channel */
-  int ret = zbus_chan_add_obs(&midi_event_chan, &ble_midi_sub, K_MSEC(100));
+  atomic_clear(&ble_ctx.packets);
+  atomic_clear(&ble_ctx.batches);
+  atomic_clear(&ble_ctx.stamp_lag_us);
+  midi_cc_stage_init(&ble_ctx.stage, CONFIG_MIDAL_BLE_MAX_AGE_MS * 1000U);
+  midi_codec_init(&ble_ctx.codec, IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC)
+                                      ? (MIDI_CODEC_14BIT | MIDI_CODEC_LSB)
+                                      : 0U);
+
+  /* Subscribe to pedal frame channel */
+  int ret = zbus_chan_add_obs(&pedal_frame_chan, &ble_midi_sub, K_MSEC(100));
   if (ret != 0) {
-    LOG_ERR("Failed to subscribe BLE MIDI to midi_event_chan: %d", ret);
+    LOG_ERR("Failed to subscribe BLE MIDI to pedal_frame_chan: %d", ret);
     return ret;
   }
 
@@ -187,37 +450,59 @@ int transport_ble_midi_init(void) {
 
 bool transport_ble_midi_ready(void) { return atomic_get(&ble_ctx.ready) != 0; }
 
+/* Send staged updates until the link pushes back */
+static void ble_midi_flush(struct transport_ble_ctx *ctx) {
+  const uint32_t now = k_ticks_to_us_floor32(k_uptime_ticks());
+  const midi_event_t *ev;
+
+  while ((ev = midi_cc_stage_next(&ctx->stage, now)) != NULL) {
+    int ret = ble_midi_tx(ctx, ev);
+    if (ret == -EAGAIN) {
+      return; /* Retried later with whatever is newest by then */
+    }
+
+    if (ret == 0) {
+      midi_cc_stage_sent(&ctx->stage);
+      atomic_inc(&ctx->sent);
+    } else {
+      midi_cc_stage_drop(&ctx->stage);
+    }
+  }
+}
+
 static void ble_midi_thread(void *p1, void *p2, void *p3) {
   ARG_UNUSED(p1);
   ARG_UNUSED(p2);
   ARG_UNUSED(p3);
 
   const struct zbus_channel *chan;
-  midi_event_t ev;
+  pedal_frame_t frame;
 
   LOG_INF("BLE MIDI transport thread started, waiting for events...");
 
   while (true) {
-    /* Wait for MIDI event from zbus channel */
-    int ret = zbus_sub_wait_msg(&ble_midi_sub, &chan, &ev, K_FOREVER);
-    if (ret != 0) {
-      LOG_ERR("BLE MIDI zbus_sub_wait_msg failed: %d", ret);
-      continue;
+    k_timeout_t wait = K_FOREVER;
+    if (midi_cc_stage_pending(&ble_ctx.stage)) {
+      wait = transport_ble_midi_ready() ? K_MSEC(BLE_MIDI_RETRY_MS)
+                                        : K_MSEC(BLE_MIDI_OFFLINE_RETRY_MS);
     }
 
-    /* Verify correct channel */
-    if (chan != &midi_event_chan) {
-      LOG_WRN("BLE MIDI received event from unexpected channel: %p", chan);
-      continue;
+    /* Wait for a pedal frame from zbus, then fold in the backlog */
+    int ret = zbus_sub_wait_msg(&ble_midi_sub, &chan, &frame, wait);
+    while (ret == 0) {
+      if (chan == &pedal_frame_chan) {
+        latency_record(LATENCY_BLE_DEQUEUE, frame.timestamp_us);
+        midi_cc_stage_put_frame(&ble_ctx.stage, &frame);
+      } else {
+        LOG_WRN("BLE MIDI received frame from unexpected channel: %p", chan);
+      }
+      ret = zbus_sub_wait_msg(&ble_midi_sub, &chan, &frame, K_NO_WAIT);
     }
-
-    /* Process the event */
-    ret = ble_midi_tx(&ble_ctx, &ev);
-    if (ret == 0) {
-      atomic_inc(&ble_ctx.sent);
-    } else {
-      atomic_inc(&ble_ctx.dropped);
+    if (ret != -ENOMSG) {
+      LOG_ERR("BLE MIDI zbus_sub_wait_msg failed: %d", ret);
     }
+
+    ble_midi_flush(&ble_ctx);
   }
 }
 
@@ -227,5 +512,27 @@ void transport_ble_get_stats(struct transport_stats *stats) {
   }
 
   stats->sent = (uint32_t)atomic_get(&ble_ctx.sent);
-  stats->dropped = (uint32_t)atomic_get(&ble_ctx.dropped);
+  stats->coalesced = (uint32_t)atomic_get(&ble_ctx.stage.coalesced);
+  stats->aged = (uint32_t)atomic_get(&ble_ctx.stage.aged);
+  stats->dropped = (uint32_t)atomic_get(&ble_ctx.stage.lost);
+  stats->packets = (uint32_t)atomic_get(&ble_ctx.packets);
+  stats->batches = (uint32_t)atomic_get(&ble_ctx.batches);
+  stats->stamp_lag_us = (uint32_t)atomic_get(&ble_ctx.stamp_lag_us);
+}
+
+void transport_ble_get_link_stats(struct ble_link_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  stats->interval_us = (uint32_t)atomic_get(&s_link.interval_us);
+  stats->connected = stats->interval_us != 0U;
+  stats->latency = (uint16_t)atomic_get(&s_link.latency);
+  stats->tx_phy = (uint8_t)atomic_get(&s_link.tx_phy);
+  stats->rx_phy = (uint8_t)atomic_get(&s_link.rx_phy);
+  stats->mtu = (uint16_t)atomic_get(&s_link.mtu);
+  stats->tx_octets = (uint16_t)atomic_get(&s_link.tx_octets);
+  stats->rejects = (uint32_t)atomic_get(&s_link.rejects);
+  stats->turnaround_max_us = (uint32_t)atomic_get(&s_link.turn_max_us);
+  stats->turnaround_avg_us = (uint32_t)atomic_get(&s_link.turn_avg_us);
 }
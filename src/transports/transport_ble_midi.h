@@ -3,6 +3,7 @@
 #include <zephyr/kernel.h>
 
 struct transport_stats;
+struct ble_link_stats;
 
 int transport_ble_midi_init(void);
 bool transport_ble_midi_ready(void);
@@ -13,3 +14,10 @@ bool transport_ble_midi_ready(void);
  * @param stats Pointer to structure to fill with statistics
  */
 void transport_ble_get_stats(struct transport_stats *stats);
+
+/**
+ * @brief Get negotiated BLE link parameters and notification turnaround
+ *
+ * @param stats Pointer to structure to fill with statistics
+ */
+void transport_ble_get_link_stats(struct ble_link_stats *stats);
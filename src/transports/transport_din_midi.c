@@ -0,0 +1,300 @@
+#include "transport_din_midi.h"
+#include "diag/latency.h"
+#include "diag/profiler.h"
+#include "diag/stats.h"
+#include "midi/midi_cc_stage.h"
+#include "midi/midi_codec.h"
+#include "midi/midi_types.h"
+#include "zbus_channels.h"
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+LOG_MODULE_REGISTER(transport_din_midi, LOG_LEVEL_INF);
+
+#if !DT_HAS_CHOSEN(midal_din_uart)
+#error "CONFIG_MIDAL_DIN_MIDI needs a UART chosen as midal,din-uart"
+#endif
+
+#define DIN_MIDI_BAUD 31250U
+/* Start bit, 8 data bits, stop bit */
+#define DIN_MIDI_BYTE_US ((10U * USEC_PER_SEC) / DIN_MIDI_BAUD)
+/* Status byte repeated after this much silence, for late-plugged receivers */
+#define DIN_MIDI_STATUS_REFRESH_MS 1000
+/* Retry pace after the UART refused a transfer */
+#define DIN_MIDI_RETRY_MS 1
+/* A transfer takes ~1 ms on the wire; past this the UART is stuck */
+#define DIN_MIDI_TX_TIMEOUT_MS 20
+
+#define DIN_MIDI_THREAD_PRIORITY 6
+#define DIN_MIDI_THREAD_STACK_SIZE 1024
+
+/* Zbus message subscriber for pedal frames */
+ZBUS_MSG_SUBSCRIBER_DEFINE(din_midi_sub);
+
+struct din_midi_ctx {
+  const struct device *dev;
+  atomic_t busy;          /* DMA transfer in flight */
+  atomic_t tx_aborted;    /* The transfer in flight never completed */
+  atomic_t sent;
+  atomic_t packets;       /* MIDI messages written */
+  atomic_t batches;       /* DMA transfers */
+  atomic_t bytes;
+  atomic_t busy_us;       /* Wire time of the bytes written */
+  uint32_t status_ms;     /* When the status byte was last sent */
+  uint32_t capture_us;    /* Capture time of the update in flight */
+  midi_codec_t codec;     /* Running status across transfers */
+  midi_cc_stage_t stage;  /* Newest unsent value per controller */
+  /* DMA source, owned by the UART while busy */
+  uint8_t buf[MIDI_CODEC_MIDI1_MAX];
+};
+
+static struct din_midi_ctx s_din_ctx = {
+    .dev = DEVICE_DT_GET(DT_CHOSEN(midal_din_uart)),
+};
+
+static K_SEM_DEFINE(s_din_tx_done, 0, 1);
+
+static struct k_thread din_midi_thread_data;
+K_THREAD_STACK_DEFINE(din_midi_stack, DIN_MIDI_THREAD_STACK_SIZE);
+static void din_midi_thread(void *, void *, void *);
+
+static void din_uart_cb(const struct device *dev, struct uart_event *evt,
+                        void *user_data) {
+  ARG_UNUSED(dev);
+  ARG_UNUSED(user_data);
+
+  switch (evt->type) {
+  case UART_TX_DONE:
+  case UART_TX_ABORTED:
+    if (evt->type == UART_TX_DONE) {
+      latency_record(LATENCY_DIN_DONE, s_din_ctx.capture_us);
+    } else {
+      atomic_set(&s_din_ctx.tx_aborted, 1);
+    }
+    atomic_add(&s_din_ctx.bytes, (atomic_val_t)evt->data.tx.len);
+    atomic_add(&s_din_ctx.busy_us,
+               (atomic_val_t)(evt->data.tx.len * DIN_MIDI_BYTE_US));
+    atomic_clear(&s_din_ctx.busy);
+    k_sem_give(&s_din_tx_done);
+    break;
+  default:
+    break;
+  }
+}
+
+int transport_din_midi_init(void) {
+  if (!device_is_ready(s_din_ctx.dev)) {
+    LOG_ERR("DIN MIDI UART %s not ready", s_din_ctx.dev->name);
+    return -ENODEV;
+  }
+
+  int ret = uart_callback_set(s_din_ctx.dev, din_uart_cb, NULL);
+  if (ret != 0) {
+    LOG_ERR("DIN MIDI UART has no async API: %d", ret);
+    return ret;
+  }
+
+  atomic_clear(&s_din_ctx.busy);
+  atomic_clear(&s_din_ctx.tx_aborted);
+  atomic_clear(&s_din_ctx.sent);
+  atomic_clear(&s_din_ctx.packets);
+  atomic_clear(&s_din_ctx.batches);
+  atomic_clear(&s_din_ctx.bytes);
+  atomic_clear(&s_din_ctx.busy_us);
+  /* Staged values are already 7-bit */
+  midi_codec_init(&s_din_ctx.codec, MIDI_CODEC_RUNNING_STATUS);
+  /*
+   * No age budget: an update waits at most a few messages' wire time, and
+   * DIN is 7-bit only (the pedal controllers have no LSB pair; the byte
+   * budget goes to updates instead)
+   */
+  midi_cc_stage_init(&s_din_ctx.stage, 0U);
+  midi_cc_stage_order_by_delta(&s_din_ctx.stage,
+                               IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? 7U
+                                                                     : 0U);
+
+  /* Subscribe to pedal frame channel */
+  ret = zbus_chan_add_obs(&pedal_frame_chan, &din_midi_sub, K_MSEC(100));
+  if (ret != 0) {
+    LOG_ERR("Failed to subscribe DIN MIDI to pedal_frame_chan: %d", ret);
+    return ret;
+  }
+
+  /* Start transport thread */
+  k_thread_create(&din_midi_thread_data, din_midi_stack,
+                  K_THREAD_STACK_SIZEOF(din_midi_stack), din_midi_thread, NULL,
+                  NULL, NULL, DIN_MIDI_THREAD_PRIORITY, 0, K_NO_WAIT);
+  k_thread_name_set(&din_midi_thread_data, "din-midi");
+
+  LOG_INF("DIN MIDI transport initialized on %s", s_din_ctx.dev->name);
+  return 0;
+}
+
+/* Encode a 7-bit CC with running status; returns the number of bytes */
+static size_t din_midi_encode(struct din_midi_ctx *ctx, const midi_event_t *ev,
+                              uint8_t *out, size_t cap) {
+  const uint32_t now = k_uptime_get_32();
+
+  if ((now - ctx->status_ms) >= DIN_MIDI_STATUS_REFRESH_MS) {
+    midi_codec_reset_status(&ctx->codec);
+  }
+
+  size_t n = midi_codec_midi1(&ctx->codec, ev, out, cap);
+  if (n > 0U && (out[0] & 0x80) != 0U) {
+    ctx->status_ms = now;
+  }
+  return n;
+}
+
+/*
+ * Start the next update if the wire is free. One update per DMA transfer:
+ * whatever is staged when it completes is newer than anything that could
+ * have been queued behind it.
+ */
+static void din_midi_flush(struct din_midi_ctx *ctx) {
+  const uint32_t now = k_ticks_to_us_floor32(k_uptime_ticks());
+  const midi_event_t *ev;
+
+  if (atomic_get(&ctx->busy) != 0) {
+    return;
+  }
+
+  ev = midi_cc_stage_next(&ctx->stage, now);
+  if (ev == NULL) {
+    return;
+  }
+
+  uint32_t t0 = prof_cycles();
+  size_t len = din_midi_encode(ctx, ev, ctx->buf, sizeof(ctx->buf));
+  prof_end(PROF_ENCODE_DIN, t0);
+  if (len == 0U) {
+    midi_cc_stage_drop(&ctx->stage);
+    return;
+  }
+
+  ctx->capture_us = ev->timestamp_us;
+  atomic_set(&ctx->busy, 1);
+  int ret = uart_tx(ctx->dev, ctx->buf, len, SYS_FOREVER_US);
+  if (ret != 0) {
+    atomic_clear(&ctx->busy);
+    /* The status byte may not have gone out */
+    midi_codec_reset_status(&ctx->codec);
+    if (ret == -EBUSY) {
+      return; /* Stays staged, retried shortly */
+    }
+    LOG_WRN("DIN MIDI uart_tx failed: %d", ret);
+    midi_cc_stage_drop(&ctx->stage);
+    return;
+  }
+
+  latency_record(LATENCY_DIN_SEND, ctx->capture_us);
+  midi_cc_stage_sent(&ctx->stage);
+  atomic_inc(&ctx->sent);
+  atomic_inc(&ctx->packets);
+  atomic_inc(&ctx->batches);
+}
+
+/*
+ * The transfer in flight never completed: abort it so the thread keeps
+ * serving the stage. The receiver may have seen part of a message, so the
+ * next one carries its status byte.
+ */
+static void din_midi_tx_stuck(struct din_midi_ctx *ctx) {
+  LOG_WRN("DIN MIDI transfer stuck, aborting");
+  midi_codec_reset_status(&ctx->codec);
+
+  if (uart_tx_abort(ctx->dev) != 0) {
+    /* Nothing to abort, or no abort support: no callback will follow */
+    atomic_set(&ctx->tx_aborted, 1);
+    atomic_clear(&ctx->busy);
+  }
+}
+
+/*
+ * An aborted update was marked sent when its transfer started: stage it
+ * again, or a later frame with the same value would look delivered and
+ * never go out.
+ */
+static void din_midi_tx_check_aborted(struct din_midi_ctx *ctx) {
+  if (atomic_clear(&ctx->tx_aborted) != 0) {
+    midi_cc_stage_undeliver(&ctx->stage);
+  }
+}
+
+static void din_midi_thread(void *p1, void *p2, void *p3) {
+  ARG_UNUSED(p1);
+  ARG_UNUSED(p2);
+  ARG_UNUSED(p3);
+
+  const struct zbus_channel *chan;
+  pedal_frame_t frame;
+
+  LOG_INF("DIN MIDI transport thread started, waiting for events...");
+
+  while (true) {
+    int ret;
+
+    if (atomic_get(&s_din_ctx.busy) != 0) {
+      /* Wire busy: sleep until it frees up, then fold in what queued */
+      if (k_sem_take(&s_din_tx_done, K_MSEC(DIN_MIDI_TX_TIMEOUT_MS)) != 0) {
+        din_midi_tx_stuck(&s_din_ctx);
+      }
+      din_midi_tx_check_aborted(&s_din_ctx);
+      ret = -ENOMSG;
+    } else {
+      k_timeout_t wait = midi_cc_stage_pending(&s_din_ctx.stage)
+                             ? K_MSEC(DIN_MIDI_RETRY_MS)
+                             : K_FOREVER;
+      k_sem_reset(&s_din_tx_done);
+      ret = zbus_sub_wait_msg(&din_midi_sub, &chan, &frame, wait);
+    }
+
+    if (ret == -ENOMSG) {
+      ret = zbus_sub_wait_msg(&din_midi_sub, &chan, &frame, K_NO_WAIT);
+    }
+    while (ret == 0) {
+      if (chan == &pedal_frame_chan) {
+        latency_record(LATENCY_DIN_DEQUEUE, frame.timestamp_us);
+        midi_cc_stage_put_frame(&s_din_ctx.stage, &frame);
+      } else {
+        LOG_WRN("DIN MIDI received frame from unexpected channel: %p", chan);
+      }
+      ret = zbus_sub_wait_msg(&din_midi_sub, &chan, &frame, K_NO_WAIT);
+    }
+    if (ret != -ENOMSG) {
+      LOG_ERR("DIN MIDI zbus_sub_wait_msg failed: %d", ret);
+    }
+
+    din_midi_flush(&s_din_ctx);
+  }
+}
+
+void transport_din_get_stats(struct transport_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  stats->sent = (uint32_t)atomic_get(&s_din_ctx.sent);
+  stats->coalesced = (uint32_t)atomic_get(&s_din_ctx.stage.coalesced);
+  stats->aged = (uint32_t)atomic_get(&s_din_ctx.stage.aged);
+  stats->dropped = (uint32_t)atomic_get(&s_din_ctx.stage.lost);
+  stats->packets = (uint32_t)atomic_get(&s_din_ctx.packets);
+  stats->batches = (uint32_t)atomic_get(&s_din_ctx.batches);
+  stats->stamp_lag_us = 0U; /* DIN MIDI carries no timestamps */
+}
+
+void transport_din_get_link_stats(struct din_link_stats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+
+  stats->bytes = (uint32_t)atomic_get(&s_din_ctx.bytes);
+  stats->busy_us = (uint32_t)atomic_get(&s_din_ctx.busy_us);
+}
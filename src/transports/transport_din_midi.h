@@ -0,0 +1,28 @@
+#pragma once
+
+#include <zephyr/kernel.h>
+
+struct transport_stats;
+struct din_link_stats;
+
+/*
+ * DIN-5 MIDI output on the UART chosen as "midal,din-uart" (31250 baud,
+ * async API / DMA). The link carries about 3125 bytes/s, far less than the
+ * pedals can produce, so updates are sent one at a time as the wire frees
+ * up, largest change first, always converging to the newest values.
+ */
+int transport_din_midi_init(void);
+
+/**
+ * @brief Get DIN MIDI transport statistics
+ *
+ * @param stats Pointer to structure to fill with statistics
+ */
+void transport_din_get_stats(struct transport_stats *stats);
+
+/**
+ * @brief Get DIN MIDI wire usage
+ *
+ * @param stats Pointer to structure to fill with statistics
+ */
+void transport_din_get_link_stats(struct din_link_stats *stats);
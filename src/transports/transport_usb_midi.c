@@ -1,4 +1,9 @@
+#include "boot.h"
+#include "diag/latency.h"
+#include "diag/profiler.h"
 #include "diag/stats.h"
+#include "midi/midi_cc_stage.h"
+#include "midi/midi_codec.h"
 #include "midi/midi_types.h"
 #include "zbus_channels.h"
 
@@ -12,7 +17,7 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(transport_usb_midi, LOG_LEVEL_INF);
 
-/* Zbus message subscriber for MIDI events */
+/* Zbus message subscriber for pedal frames */
 ZBUS_MSG_SUBSCRIBER_DEFINE(usb_midi_sub);
 
 struct usb_midi_ctx {
@@ -20,7 +25,11 @@ struct usb_midi_ctx {
   atomic_t ready;
   atomic_t fail_streak;
   atomic_t sent;
-  atomic_t dropped;
+  atomic_t packets;       /* UMPs queued to the class driver */
+  atomic_t batches;       /* Flushes that queued at least one UMP */
+  uint32_t batch_packets; /* UMPs queued in the current flush */
+  midi_cc_stage_t stage;  /* Newest unsent value per controller */
+  midi_codec_t codec;
 };
 
 static struct usb_midi_ctx s_usb_ctx = {
@@ -29,6 +38,12 @@ static struct usb_midi_ctx s_usb_ctx = {
 
 #define USB_MIDI_THREAD_PRIORITY 5
 #define USB_MIDI_THREAD_STACK_SIZE 1024
+/* Retry staged updates every USB frame while the IN buffer is full */
+#define USB_MIDI_RETRY_MS 1
+/* ...and at this pace until the host configures the interface */
+#define USB_MIDI_OFFLINE_RETRY_MS 100
+/* Largest System Exclusive body transport_usb_send_sysex() takes */
+#define USB_MIDI_SYSEX_MAX 64U
 static struct k_thread usb_midi_thread_data;
 K_THREAD_STACK_DEFINE(usb_midi_stack, USB_MIDI_THREAD_STACK_SIZE);
 static void usb_midi_thread(void *, void *, void *);
@@ -44,12 +59,16 @@ int transport_usb_midi_init(void) {
   atomic_clear(&s_usb_ctx.fail_streak);
   atomic_clear(&s_usb_ctx.ready);
   atomic_clear(&s_usb_ctx.sent);
-  atomic_clear(&s_usb_ctx.dropped);
-
-  /* Subscribe to MIDI event channel */
-  int ret = zbus_chan_add_obs(&midi_event_chan, &usb_midi_sub, K_MSEC(100));
+  atomic_clear(&s_usb_ctx.packets);
+  atomic_clear(&s_usb_ctx.batches);
+  midi_cc_stage_init(&s_usb_ctx.stage, CONFIG_MIDAL_USB_MAX_AGE_MS * 1000U);
+  midi_codec_init(&s_usb_ctx.codec,
+                  IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC) ? MIDI_CODEC_14BIT : 0U);
+
+  /* Subscribe to pedal frame channel */
+  int ret = zbus_chan_add_obs(&pedal_frame_chan, &usb_midi_sub, K_MSEC(100));
   if (ret != 0) {
-    LOG_ERR("Failed to subscribe USB MIDI to midi_event_chan: %d", ret);
+    LOG_ERR("Failed to subscribe USB MIDI to pedal_frame_chan: %d", ret);
     return ret;
   }
 
@@ -63,60 +82,30 @@ int transport_usb_midi_init(void) {
   return 0;
 }
 
-static inline int safe_send(struct usb_midi_ctx *ctx, struct midi_ump m);
-
-static inline int send_cc7(struct usb_midi_ctx *ctx, uint8_t ch, uint8_t cc,
-                           uint8_t val7) {
-  /* MIDI 1.0 Channel Voice Control Change over UMP */
-  struct midi_ump m = UMP_MIDI1_CHANNEL_VOICE(
-      0, /* group 0 */
-      UMP_MIDI_CONTROL_CHANGE, (ch & 0x0F), (cc & 0x7F), (val7 & 0x7F));
-  return safe_send(ctx, m);
-}
-
-static inline uint16_t scale14_to16(uint16_t v14) {
-  /* Map 0..16383 -> 0..65535 with rounding */
-  return (uint16_t)(((uint32_t)v14 * 65535u + 8191u) / 16383u);
-}
-
-static struct midi_ump midi2_cc_packet(uint8_t group, uint8_t channel,
-                                       uint8_t controller, uint16_t value16) {
-  struct midi_ump m = {0};
-
-  uint32_t word0 = ((uint32_t)UMP_MT_MIDI2_CHANNEL_VOICE << 28) |
-                   (((uint32_t)group & 0x0F) << 24) |
-                   (((uint32_t)UMP_MIDI_CONTROL_CHANGE & 0x0F) << 20) |
-                   (((uint32_t)channel & 0x0F) << 16) |
-                   (((uint32_t)controller & 0x7F) << 8);
-
-  uint32_t word1 = ((uint32_t)value16) << 16; /* Data in the MSBs */
-
-  m.data[0] = word0;
-  m.data[1] = word1;
-  return m;
-}
-
 bool transport_usb_ready(void) { return atomic_get(&s_usb_ctx.ready) != 0; }
 
 void transport_usb_notify_ready(bool ready) {
   atomic_set(&s_usb_ctx.ready, ready ? 1 : 0);
+  if (ready) {
+    boot_mark(BOOT_PHASE_USB_READY);
+  }
   LOG_INF("USB-MIDI2.0 is %s", ready ? "enabled" : "disabled");
 }
 
 static inline int safe_send(struct usb_midi_ctx *ctx, struct midi_ump m) {
-  /* Real-time mode: No retries, drop if buffer full.
-   * Priority to fresh messages over old queued ones.
-   * NOTE: Drops counted by caller per-event, not per-message.
+  /* Real-time mode: no retries here. On a full buffer the update stays
+   * staged and the newest value for the controller is sent later.
    */
   int r = usbd_midi_send(ctx->dev, m);
 
   if (r == 0) {
     atomic_clear(&ctx->fail_streak);
+    ctx->batch_packets++;
     return 0;
   }
 
-  if (r == -EAGAIN || r == -ENOSPC) {
-    /* Buffer full - return error, caller will count per-event drop */
+  if (r == -EAGAIN || r == -ENOSPC || r == -ENOBUFS) {
+    /* Buffer full - caller keeps the update staged */
     return -EAGAIN;
   }
 
@@ -126,6 +115,53 @@ static inline int safe_send(struct usb_midi_ctx *ctx, struct midi_ump m) {
   return r;
 }
 
+int transport_usb_send_sysex(const uint8_t *data, size_t len,
+                             k_timeout_t timeout) {
+  uint32_t words[MIDI_CODEC_SYSEX7_WORDS(USB_MIDI_SYSEX_MAX)];
+
+  if (!transport_usb_ready()) {
+    return -ENOTCONN;
+  }
+
+  size_t n = midi_codec_ump_sysex7(0, data, len, words, ARRAY_SIZE(words));
+  if (n == 0U) {
+    return -EMSGSIZE;
+  }
+
+  const k_timepoint_t end = sys_timepoint_calc(timeout);
+
+  for (size_t i = 0; i < n;) {
+    struct midi_ump m = {.data = {words[i], words[i + 1U]}};
+
+    /* The class TX ring has no lock of its own: keep the transport out */
+    k_sched_lock();
+    int r = usbd_midi_send(s_usb_ctx.dev, m);
+    k_sched_unlock();
+
+    if (r == 0) {
+      /* Each locked send is a flush of its own */
+      atomic_inc(&s_usb_ctx.packets);
+      atomic_inc(&s_usb_ctx.batches);
+      i += 2U;
+      continue;
+    }
+    if (r != -EAGAIN && r != -ENOSPC && r != -ENOBUFS) {
+      return r;
+    }
+    if (sys_timepoint_expired(end)) {
+      return -EAGAIN;
+    }
+    k_sleep(K_MSEC(USB_MIDI_RETRY_MS));
+  }
+
+  return 0;
+}
+
+/* Combined result of several sends: backpressure wins, then the first error */
+static inline int usb_send_result(int prev, int r) {
+  return (r == -EAGAIN || prev == 0) ? r : prev;
+}
+
 static int usb_midi_tx(void *ctx_ptr, const midi_event_t *ev) {
   if (ctx_ptr == NULL || ev == NULL) {
     return -EINVAL;
@@ -134,52 +170,99 @@ static int usb_midi_tx(void *ctx_ptr, const midi_event_t *ev) {
   struct usb_midi_ctx *ctx = ctx_ptr;
 
   if (!transport_usb_ready()) {
-    return 0; /* Not enumerated yet */
+    return -EAGAIN; /* Not enumerated yet: keep it staged */
   }
 
   if (ev->type != MIDI_EV_CC) {
     return 0; /* only CC for now */
   }
 
-  const uint8_t ch = ev->cc.ch & 0x0F;
-  const uint8_t cc = ev->cc.cc & 0x7F;
-  const uint16_t v = ev->cc.value; /* 0..127 or 0..16383 */
+  /* MIDI 1.0 CC (7-bit, rounded), then the MIDI 2.0 one with full range.
+   * Backpressure on either resends both with the newest value.
+   */
+  uint32_t w1[MIDI_CODEC_UMP_MAX];
+  uint32_t w2[MIDI_CODEC_UMP_MAX];
+  size_t n2 = 0U;
+  int ret = 0;
+
+  uint32_t t0 = prof_cycles();
+  size_t n1 = midi_codec_ump_midi1(&ctx->codec, ev, 0, w1, ARRAY_SIZE(w1));
+  if (IS_ENABLED(CONFIG_MIDAL_USB_MIDI2_NATIVE)) {
+    n2 = midi_codec_ump_midi2(&ctx->codec, ev, 0, w2, ARRAY_SIZE(w2));
+  }
+  prof_end(PROF_ENCODE_USB, t0);
 
-  uint8_t v7_scaled = 0;
-  if (IS_ENABLED(CONFIG_MIDAL_USE_14BIT_CC)) {
-    uint16_t v_clamped = (v > 16383U) ? 16383U : v;
-    uint16_t v_rounded = (uint16_t)((v_clamped + 0x40U) >> 7);
-    if (v_rounded > 127U) {
-      v_rounded = 127U;
-    }
-    v7_scaled = (uint8_t)v_rounded;
-  } else {
-    v7_scaled = (uint8_t)((v > 127U) ? 127U : v);
+  for (size_t i = 0; i < n1; i++) {
+    struct midi_ump m = {.data = {w1[i]}};
+    ret = usb_send_result(ret, safe_send(ctx, m));
   }
 
-  /* Send MIDI 1.0 7-bit message */
-  LOG_DBG("USB CC7 ch=%u cc=%u val=%u (scaled)", ch, cc, v7_scaled);
-  int ret = send_cc7(ctx, ch, cc, v7_scaled);
+  if (n2 == 2U) {
+    struct midi_ump m = {.data = {w2[0], w2[1]}};
+    ret = usb_send_result(ret, safe_send(ctx, m));
+  }
 
-#if IS_ENABLED(CONFIG_MIDAL_USB_MIDI2_NATIVE)
-  /* Send MIDI 2.0 14-bit message */
-  uint16_t v16 = (v > 16383U) ? 65535U : scale14_to16(v);
-  LOG_DBG("USB MIDI2 CC ch=%u cc=%u val16=%u", ch, cc, v16);
-  struct midi_ump midi2 = midi2_cc_packet(0, ch, cc, v16);
-  int ret2 = safe_send(ctx, midi2);
+  LOG_DBG("USB CC ch=%u cc=%u val=%u", ev->cc.ch, ev->cc.cc, ev->cc.value);
+  return ret;
+}
 
-  /* Return error if either send failed */
-  if (ret != 0 || ret2 != 0) {
-    return -EAGAIN;
+/*
+ * Send staged updates until the link pushes back.
+ *
+ * usbd_midi_send() only copies the UMP into the class TX ring and submits
+ * the TX work, which runs on the system work queue and preempts this
+ * thread: every UMP would leave in a transfer of its own. With the
+ * scheduler locked the work runs once after the flush and moves everything
+ * queued here (all pedals of a scan, both UMPs per event in MIDI 2.0 mode)
+ * in a single bulk transfer, or leaves it in the ring behind the transfer
+ * in flight, which then carries several flushes. The class driver reports
+ * no transfer completions, so the batches counted here are flushes.
+ */
+static void usb_midi_flush(struct usb_midi_ctx *ctx) {
+  const uint32_t now = k_ticks_to_us_floor32(k_uptime_ticks());
+  const midi_event_t *ev;
+  uint32_t captured[MIDI_CC_STAGE_SLOTS];
+  size_t n_sent = 0U;
+
+  ctx->batch_packets = 0U;
+  k_sched_lock();
+
+  while ((ev = midi_cc_stage_next(&ctx->stage, now)) != NULL) {
+    int ret = usb_midi_tx(ctx, ev);
+    if (ret == -EAGAIN) {
+      break; /* Retried later with whatever is newest by then */
+    }
+
+    if (ret == 0) {
+      latency_record(LATENCY_USB_SEND, ev->timestamp_us);
+      if (n_sent < ARRAY_SIZE(captured)) {
+        captured[n_sent++] = ev->timestamp_us;
+      }
+      midi_cc_stage_sent(&ctx->stage);
+      atomic_inc(&ctx->sent);
+    } else {
+      midi_cc_stage_drop(&ctx->stage);
+    }
   }
-#else
-  /* Return error if send failed */
-  if (ret != 0) {
-    return ret;
+
+  k_sched_unlock();
+
+  /*
+   * The TX work has run by now. It submitted a bulk transfer, or left the
+   * UMPs in the class ring if one was in flight; the class driver reports
+   * no completion, so this is as far as the USB path can be followed.
+   */
+  if (n_sent > 0U) {
+    const uint32_t queued = k_ticks_to_us_floor32(k_uptime_ticks());
+    for (size_t i = 0; i < n_sent; i++) {
+      latency_record_at(LATENCY_USB_QUEUED, captured[i], queued);
+    }
   }
-#endif
 
-  return 0;
+  if (ctx->batch_packets > 0U) {
+    atomic_add(&ctx->packets, (atomic_val_t)ctx->batch_packets);
+    atomic_inc(&ctx->batches);
+  }
 }
 
 static void usb_midi_thread(void *p1, void *p2, void *p3) {
@@ -188,31 +271,33 @@ static void usb_midi_thread(void *p1, void *p2, void *p3) {
   ARG_UNUSED(p3);
 
   const struct zbus_channel *chan;
-  midi_event_t ev;
+  pedal_frame_t frame;
 
   LOG_INF("USB MIDI transport thread started, waiting for events...");
 
   while (true) {
-    /* Wait for MIDI event from zbus channel */
-    int ret = zbus_sub_wait_msg(&usb_midi_sub, &chan, &ev, K_FOREVER);
-    if (ret != 0) {
-      LOG_ERR("USB MIDI zbus_sub_wait_msg failed: %d", ret);
-      continue;
+    k_timeout_t wait = K_FOREVER;
+    if (midi_cc_stage_pending(&s_usb_ctx.stage)) {
+      wait = transport_usb_ready() ? K_MSEC(USB_MIDI_RETRY_MS)
+                                   : K_MSEC(USB_MIDI_OFFLINE_RETRY_MS);
     }
 
-    /* Verify correct channel */
-    if (chan != &midi_event_chan) {
-      LOG_WRN("USB MIDI received event from unexpected channel: %p", chan);
-      continue;
+    /* Wait for a pedal frame from zbus, then fold in the backlog */
+    int ret = zbus_sub_wait_msg(&usb_midi_sub, &chan, &frame, wait);
+    while (ret == 0) {
+      if (chan == &pedal_frame_chan) {
+        latency_record(LATENCY_USB_DEQUEUE, frame.timestamp_us);
+        midi_cc_stage_put_frame(&s_usb_ctx.stage, &frame);
+      } else {
+        LOG_WRN("USB MIDI received frame from unexpected channel: %p", chan);
+      }
+      ret = zbus_sub_wait_msg(&usb_midi_sub, &chan, &frame, K_NO_WAIT);
     }
-
-    /* Process the event */
-    ret = usb_midi_tx(&s_usb_ctx, &ev);
-    if (ret == 0) {
-      atomic_inc(&s_usb_ctx.sent);
-    } else {
-      atomic_inc(&s_usb_ctx.dropped);
+    if (ret != -ENOMSG) {
+      LOG_ERR("USB MIDI zbus_sub_wait_msg failed: %d", ret);
     }
+
+    usb_midi_flush(&s_usb_ctx);
   }
 }
 
@@ -222,5 +307,10 @@ void transport_usb_get_stats(struct transport_stats *stats) {
   }
 
   stats->sent = (uint32_t)atomic_get(&s_usb_ctx.sent);
-  stats->dropped = (uint32_t)atomic_get(&s_usb_ctx.dropped);
+  stats->coalesced = (uint32_t)atomic_get(&s_usb_ctx.stage.coalesced);
+  stats->aged = (uint32_t)atomic_get(&s_usb_ctx.stage.aged);
+  stats->dropped = (uint32_t)atomic_get(&s_usb_ctx.stage.lost);
+  stats->packets = (uint32_t)atomic_get(&s_usb_ctx.packets);
+  stats->batches = (uint32_t)atomic_get(&s_usb_ctx.batches);
+  stats->stamp_lag_us = 0U; /* USB MIDI carries no timestamps */
 }
@@ -9,6 +9,14 @@ int transport_usb_midi_init(void);
 void transport_usb_notify_ready(bool ready);
 bool transport_usb_ready(void);
 
+/*
+ * Send one System Exclusive message (the 7-bit body between F0 and F7, up
+ * to 64 bytes) as SysEx7 UMPs, waiting up to timeout for room in the class
+ * TX buffer. For bulk diagnostics; not for use from the pedal path.
+ */
+int transport_usb_send_sysex(const uint8_t *data, size_t len,
+                             k_timeout_t timeout);
+
 /**
  * @brief Get USB MIDI transport statistics
  *
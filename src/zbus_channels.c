@@ -9,25 +9,21 @@
 LOG_MODULE_REGISTER(zbus_channels, LOG_LEVEL_INF);
 
 /**
- * @brief MIDI Event Channel Definition
+ * @brief Pedal Frame Channel Definition
  *
- * This channel carries MIDI events (CC messages, notes, etc.) from the
- * pedal sampler to the MIDI router for distribution to all outputs.
+ * This channel carries one filtered pedal scan (values, change mask,
+ * timestamp) from the pedal sampler to the MIDI transports.
  *
- * Initial value: Zero-initialized MIDI CC event
+ * Initial value: Zero-initialized frame with no pedal changed
  */
-ZBUS_CHAN_DEFINE(midi_event_chan,           /* Channel name */
-		 midi_event_t,              /* Message type */
+ZBUS_CHAN_DEFINE(pedal_frame_chan,          /* Channel name */
+		 pedal_frame_t,             /* Message type */
 		 NULL,                      /* No validator */
 		 NULL,                      /* No user data */
 		 ZBUS_OBSERVERS_EMPTY,      /* Observers added at runtime */
 		 ZBUS_MSG_INIT(             /* Initial value */
-			 .type = MIDI_EV_CC,
-			 .cc = {
-				 .ch = 0,
-				 .cc = 0,
-				 .value = 0
-			 },
-			 .timestamp_us = 0
+			 .timestamp_us = 0,
+			 .values = {0},
+			 .changed = 0
 		 )
 );
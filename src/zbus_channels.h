@@ -9,21 +9,24 @@
  */
 
 #include <zephyr/zbus/zbus.h>
-#include "midi/midi_types.h"
+#include "pedal/pedal_frame.h"
 
 /**
- * @brief MIDI Event Channel
+ * @brief Pedal Frame Channel
  *
- * This channel carries MIDI events from sources (pedal sampler, etc.) to
- * all MIDI transport outputs (USB MIDI, BLE MIDI, DIN MIDI).
+ * This channel carries one message per pedal scan in which at least one
+ * pedal changed: all pedal values, a change mask and the capture timestamp.
+ * Consumers turn the changed entries into MIDI events themselves (see
+ * pedal_frame_event()), so a scan costs one publish however many pedals
+ * moved.
  *
- * The channel carries 14-bit native format MIDI data. Each transport
- * subscriber is responsible for converting to its required format:
+ * The values are in 14-bit native format. Each transport subscriber is
+ * responsible for converting to its required format:
  * - USB MIDI2: Uses 14-bit native (scaled to 16-bit UMP)
  * - BLE/DIN MIDI1: Converts 14-bit to 7-bit (>> 7 with rounding)
  *
- * Message Type: midi_event_t (always 14-bit: cc.value = 0..16383)
+ * Message Type: pedal_frame_t
  * Publishers: Pedal Sampler
- * Subscribers: USB MIDI Transport, BLE MIDI Transport, DIN MIDI Transport
+ * Subscribers: USB MIDI Transport, BLE MIDI Transport, Stats Listener
  */
-ZBUS_CHAN_DECLARE(midi_event_chan);
+ZBUS_CHAN_DECLARE(pedal_frame_chan);
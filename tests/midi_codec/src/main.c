@@ -0,0 +1,204 @@
+// tests/midi_codec/src/main.c
+#include "midi/midi_codec.h"
+
+#include <zephyr/ztest.h>
+
+static midi_event_t cc_event(uint8_t ch, uint8_t cc, uint16_t value) {
+  return (midi_event_t){
+      .type = MIDI_EV_CC,
+      .cc = {.ch = ch, .cc = cc, .value = value},
+  };
+}
+
+ZTEST(midi_codec, test_value_reduction) {
+  midi_codec_t c7;
+  midi_codec_t c14;
+
+  midi_codec_init(&c7, 0U);
+  midi_codec_init(&c14, MIDI_CODEC_14BIT);
+
+  /* 14-bit to 7-bit rounds to nearest and saturates */
+  zassert_equal(midi_codec_value7(&c14, 63U), 0U);
+  zassert_equal(midi_codec_value7(&c14, 64U), 1U);
+  zassert_equal(midi_codec_value7(&c14, 8191U), 64U);
+  zassert_equal(midi_codec_value7(&c14, 16383U), 127U);
+  zassert_equal(midi_codec_value7(&c14, 0xFFFFU), 127U);
+  zassert_equal(midi_codec_value7(&c7, 200U), 127U);
+
+  /* A 7-bit value widens by shifting, a 14-bit one passes through */
+  zassert_equal(midi_codec_value14(&c7, 127U), 127U << 7);
+  zassert_equal(midi_codec_value14(&c14, 9029U), 9029U);
+
+  /* MIDI 2.0 spans the full range with rounding */
+  zassert_equal(midi_codec_value16(&c7, 0U), 0U);
+  zassert_equal(midi_codec_value16(&c7, 64U), 0x8102U);
+  zassert_equal(midi_codec_value16(&c7, 127U), 0xFFFFU);
+  zassert_equal(midi_codec_value16(&c14, 1U), 0x0004U);
+  zassert_equal(midi_codec_value16(&c14, 8192U), 0x8002U);
+  zassert_equal(midi_codec_value16(&c14, 16383U), 0xFFFFU);
+}
+
+ZTEST(midi_codec, test_midi1_running_status) {
+  static const uint8_t golden[] = {
+      0xB0, 0x40, 0x7F, /* Status, damper on */
+      0x42, 0x00,       /* Same status: omitted */
+      0xB1, 0x40, 0x40, /* Channel change: status again */
+      0xB1, 0x43, 0x05, /* After a reset: status again */
+  };
+  const midi_event_t evs[] = {
+      cc_event(0U, 64U, 127U),
+      cc_event(0U, 66U, 0U),
+      cc_event(1U, 64U, 64U),
+      cc_event(1U, 67U, 5U),
+  };
+  uint8_t out[sizeof(golden)];
+  midi_codec_t c;
+  size_t n = 0U;
+
+  midi_codec_init(&c, MIDI_CODEC_RUNNING_STATUS);
+  for (size_t i = 0; i < ARRAY_SIZE(evs); i++) {
+    if (i == 3U) {
+      midi_codec_reset_status(&c);
+    }
+    n += midi_codec_midi1(&c, &evs[i], &out[n], sizeof(out) - n);
+  }
+
+  zassert_equal(n, sizeof(golden));
+  zassert_mem_equal(out, golden, sizeof(golden));
+}
+
+ZTEST(midi_codec, test_midi1_msb_lsb_pair) {
+  static const uint8_t golden_rs[] = {
+      0xB0, 0x01, 0x46, 0x21, 0x45, /* 9029 = 70 << 7 | 69 */
+      0x01, 0x7F, 0x21, 0x7F,       /* 16383, status running */
+  };
+  static const uint8_t golden_full[] = {0xB0, 0x01, 0x46, 0xB0, 0x21, 0x45};
+  const midi_event_t mod = cc_event(0U, 1U, 9029U);
+  const midi_event_t mod_max = cc_event(0U, 1U, 16383U);
+  uint8_t out[MIDI_CODEC_MIDI1_MAX * 2];
+  midi_codec_t c;
+  size_t n;
+
+  midi_codec_init(&c, MIDI_CODEC_14BIT | MIDI_CODEC_LSB |
+                          MIDI_CODEC_RUNNING_STATUS);
+  n = midi_codec_midi1(&c, &mod, out, sizeof(out));
+  n += midi_codec_midi1(&c, &mod_max, &out[n], sizeof(out) - n);
+  zassert_equal(n, sizeof(golden_rs));
+  zassert_mem_equal(out, golden_rs, sizeof(golden_rs));
+
+  midi_codec_init(&c, MIDI_CODEC_14BIT | MIDI_CODEC_LSB);
+  n = midi_codec_midi1(&c, &mod, out, sizeof(out));
+  zassert_equal(n, sizeof(golden_full));
+  zassert_mem_equal(out, golden_full, sizeof(golden_full));
+
+  /* Controllers 32 and up have no LSB: rounded to 7 bits */
+  const midi_event_t damper = cc_event(0U, 64U, 8191U);
+  static const uint8_t golden_damper[] = {0xB0, 0x40, 0x40};
+  n = midi_codec_midi1(&c, &damper, out, sizeof(out));
+  zassert_equal(n, sizeof(golden_damper));
+  zassert_mem_equal(out, golden_damper, sizeof(golden_damper));
+}
+
+ZTEST(midi_codec, test_midi1_whole_or_nothing) {
+  const midi_event_t mod = cc_event(0U, 1U, 9029U);
+  midi_event_t note = cc_event(0U, 60U, 100U);
+  uint8_t out[MIDI_CODEC_MIDI1_MAX];
+  midi_codec_t c;
+
+  midi_codec_init(&c, MIDI_CODEC_14BIT | MIDI_CODEC_LSB |
+                          MIDI_CODEC_RUNNING_STATUS);
+  zassert_equal(midi_codec_midi1(&c, &mod, out, 4U), 0U);
+  /* A refused event leaves the running status alone */
+  zassert_equal(midi_codec_midi1(&c, &mod, out, sizeof(out)), 5U);
+  zassert_equal(out[0], 0xB0);
+
+  note.type = MIDI_EV_NOTE;
+  zassert_equal(midi_codec_midi1(&c, &note, out, sizeof(out)), 0U);
+}
+
+ZTEST(midi_codec, test_ump_midi1) {
+  const midi_event_t damper = cc_event(2U, 64U, 127U);
+  const midi_event_t mod = cc_event(0U, 1U, 9029U);
+  uint32_t out[MIDI_CODEC_UMP_MAX];
+  midi_codec_t c;
+
+  midi_codec_init(&c, 0U);
+  zassert_equal(midi_codec_ump_midi1(&c, &damper, 0U, out, ARRAY_SIZE(out)),
+                1U);
+  zassert_equal(out[0], 0x20B2407FU);
+
+  midi_codec_init(&c, MIDI_CODEC_14BIT | MIDI_CODEC_LSB);
+  zassert_equal(midi_codec_ump_midi1(&c, &mod, 1U, out, ARRAY_SIZE(out)), 2U);
+  zassert_equal(out[0], 0x21B00146U);
+  zassert_equal(out[1], 0x21B02145U);
+
+  /* The pair goes out whole or not at all */
+  zassert_equal(midi_codec_ump_midi1(&c, &mod, 1U, out, 1U), 0U);
+}
+
+ZTEST(midi_codec, test_ump_midi2) {
+  const midi_event_t damper = cc_event(3U, 64U, 127U);
+  const midi_event_t half = cc_event(15U, 67U, 8192U);
+  uint32_t out[MIDI_CODEC_UMP_MAX];
+  midi_codec_t c;
+
+  midi_codec_init(&c, 0U);
+  zassert_equal(midi_codec_ump_midi2(&c, &damper, 0U, out, ARRAY_SIZE(out)),
+                2U);
+  zassert_equal(out[0], 0x40B34000U);
+  zassert_equal(out[1], 0xFFFF0000U);
+
+  /* Never split into an LSB controller, whatever the flags */
+  midi_codec_init(&c, MIDI_CODEC_14BIT | MIDI_CODEC_LSB);
+  zassert_equal(midi_codec_ump_midi2(&c, &half, 2U, out, ARRAY_SIZE(out)),
+                2U);
+  zassert_equal(out[0], 0x42BF4300U);
+  zassert_equal(out[1], 0x80020000U);
+
+  zassert_equal(midi_codec_ump_midi2(&c, &half, 2U, out, 1U), 0U);
+}
+
+ZTEST(midi_codec, test_ump_sysex7_segments) {
+  static const uint8_t body[13] = {0x01, 0x02, 0x03, 0x04, 0x05,
+                                   0x06, 0x07, 0x08, 0x09, 0x0A,
+                                   0x0B, 0x0C, 0x8D /* masked to 7 bits */};
+  uint32_t out[MIDI_CODEC_SYSEX7_WORDS(sizeof(body))];
+
+  /* Empty body: one complete packet */
+  zassert_equal(midi_codec_ump_sysex7(0U, body, 0U, out, ARRAY_SIZE(out)),
+                2U);
+  zassert_equal(out[0], 0x30000000U);
+  zassert_equal(out[1], 0x00000000U);
+
+  /* Six bytes still fit one complete packet */
+  zassert_equal(midi_codec_ump_sysex7(0U, body, 6U, out, ARRAY_SIZE(out)),
+                2U);
+  zassert_equal(out[0], 0x30060102U);
+  zassert_equal(out[1], 0x03040506U);
+
+  /* Seven: start, then an end carrying one byte */
+  zassert_equal(midi_codec_ump_sysex7(0U, body, 7U, out, ARRAY_SIZE(out)),
+                4U);
+  zassert_equal(out[0], 0x30160102U);
+  zassert_equal(out[1], 0x03040506U);
+  zassert_equal(out[2], 0x30310700U);
+  zassert_equal(out[3], 0x00000000U);
+
+  /* Thirteen on group 5: start, continue, end */
+  static const uint32_t golden[] = {
+      0x35160102U, 0x03040506U, 0x35260708U,
+      0x090A0B0CU, 0x35310D00U, 0x00000000U,
+  };
+  zassert_equal(ARRAY_SIZE(out), ARRAY_SIZE(golden));
+  zassert_equal(
+      midi_codec_ump_sysex7(5U, body, sizeof(body), out, ARRAY_SIZE(out)),
+      ARRAY_SIZE(golden));
+  zassert_mem_equal(out, golden, sizeof(golden));
+
+  /* All or nothing */
+  zassert_equal(midi_codec_ump_sysex7(5U, body, sizeof(body), out,
+                                      ARRAY_SIZE(out) - 1U),
+                0U);
+}
+
+ZTEST_SUITE(midi_codec, NULL, NULL, NULL, NULL, NULL);
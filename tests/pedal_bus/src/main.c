@@ -0,0 +1,229 @@
+// tests/pedal_bus/src/main.c
+#include "midi/midi_cc_stage.h"
+#include "zbus_channels.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/zbus/zbus.h>
+
+/* Stands in for a transport: drains pedal_frame_chan only when told to */
+ZBUS_MSG_SUBSCRIBER_DEFINE(test_frame_sub);
+
+static midi_cc_stage_t s_stage;
+
+/* The sampler's pedal configuration, without its ADC channels */
+static const struct {
+  uint8_t ch;
+  uint8_t cc;
+  uint8_t prio;
+} test_pedals[MIDAL_NUM_PEDALS] = {
+    {MIDAL_CH_PEDAL_SUSTAIN, MIDAL_CC_SUSTAIN, MIDAL_PRIO_PEDAL_SUSTAIN},
+    {MIDAL_CH_PEDAL_SOSTENUTO, MIDAL_CC_SOSTENUTO, MIDAL_PRIO_PEDAL_SOSTENUTO},
+    {MIDAL_CH_PEDAL_SOFT, MIDAL_CC_SOFT, MIDAL_PRIO_PEDAL_SOFT},
+};
+
+void pedal_frame_event(const pedal_frame_t *frame, size_t i, midi_event_t *ev) {
+  *ev = (midi_event_t){
+      .type = MIDI_EV_CC,
+      .timestamp_us = frame->timestamp_us,
+      .cc = {.ch = test_pedals[i].ch,
+             .cc = test_pedals[i].cc,
+             .value = frame->values[i]},
+  };
+}
+
+uint8_t pedal_frame_priority(size_t i) { return test_pedals[i].prio; }
+
+static void stage(uint32_t t_us, uint8_t changed, uint16_t v0, uint16_t v1,
+                  uint16_t v2) {
+  const pedal_frame_t frame = {
+      .timestamp_us = t_us, .values = {v0, v1, v2}, .changed = changed};
+
+  midi_cc_stage_put_frame(&s_stage, &frame);
+}
+
+/* Send the next staged update at now_us; its controller, or -1 if none */
+static int send_next(uint32_t now_us, uint16_t *value) {
+  const midi_event_t *ev = midi_cc_stage_next(&s_stage, now_us);
+
+  if (ev == NULL) {
+    return -1;
+  }
+  *value = ev->cc.value;
+  int cc = ev->cc.cc;
+  midi_cc_stage_sent(&s_stage);
+  return cc;
+}
+
+ZTEST(pedal_bus, test_burst_keeps_latest_value) {
+  const struct zbus_channel *chan;
+  pedal_frame_t frame;
+  int frames = 0;
+  uint16_t v;
+
+  /*
+   * Ten scans queue up while the transport is busy: the damper moves in
+   * every one, the soft pedal once. The sostenuto value is never flagged.
+   */
+  for (uint16_t n = 0; n < 10U; n++) {
+    frame = (pedal_frame_t){
+        .timestamp_us = 1000U * n,
+        .values = {(uint16_t)(1000U + 100U * n), 1234U, 500U},
+        .changed = BIT(0) | ((n == 3U) ? BIT(2) : 0U),
+    };
+    zassert_ok(zbus_chan_pub(&pedal_frame_chan, &frame, K_NO_WAIT));
+  }
+
+  /* Folded in like the transports do: one slot per controller */
+  while (zbus_sub_wait_msg(&test_frame_sub, &chan, &frame, K_NO_WAIT) == 0) {
+    zassert_equal_ptr(chan, &pedal_frame_chan);
+    midi_cc_stage_put_frame(&s_stage, &frame);
+    frames++;
+  }
+  zassert_equal(frames, 10);
+  zassert_equal(atomic_get(&s_stage.coalesced), 9);
+
+  /* One update per moved pedal, the damper first, newest value only */
+  const midi_event_t *ev = midi_cc_stage_next(&s_stage, 10000U);
+  zassert_not_null(ev);
+  zassert_equal(ev->cc.cc, MIDAL_CC_SUSTAIN);
+  zassert_equal(ev->cc.value, 1900U);
+  zassert_equal(ev->timestamp_us, 9000U);
+  midi_cc_stage_sent(&s_stage);
+
+  zassert_equal(send_next(10000U, &v), MIDAL_CC_SOFT);
+  zassert_equal(v, 500U);
+  zassert_equal(send_next(10000U, &v), -1);
+  zassert_false(midi_cc_stage_pending(&s_stage));
+  zassert_equal(atomic_get(&s_stage.lost), 0);
+}
+
+ZTEST(pedal_bus, test_backpressure_replaces_in_place) {
+  uint16_t v;
+
+  stage(0U, BIT(0) | BIT(1) | BIT(2), 100U, 200U, 300U);
+
+  /* The link refuses: the damper stays at the head and is offered again */
+  const midi_event_t *ev = midi_cc_stage_next(&s_stage, 0U);
+  zassert_not_null(ev);
+  zassert_equal(ev->cc.cc, MIDAL_CC_SUSTAIN);
+  zassert_equal_ptr(midi_cc_stage_next(&s_stage, 0U), ev);
+
+  /* A newer scan replaces it, nothing queues behind it */
+  stage(1000U, BIT(0), 150U, 200U, 300U);
+  zassert_equal(atomic_get(&s_stage.coalesced), 1);
+  zassert_equal(send_next(1000U, &v), MIDAL_CC_SUSTAIN);
+  zassert_equal(v, 150U);
+
+  /* Then the two equal-priority pedals, each once */
+  int a = send_next(1000U, &v);
+  int b = send_next(1000U, &v);
+  zassert_true((a == MIDAL_CC_SOSTENUTO && b == MIDAL_CC_SOFT) ||
+               (a == MIDAL_CC_SOFT && b == MIDAL_CC_SOSTENUTO));
+  zassert_equal(send_next(1000U, &v), -1);
+}
+
+ZTEST(pedal_bus, test_stale_updates) {
+  uint16_t v;
+
+  midi_cc_stage_init(&s_stage, 5000U);
+
+  /* Delivered, then moved and back before the link recovered */
+  stage(0U, BIT(0), 8000U, 0U, 0U);
+  zassert_equal(send_next(100U, &v), MIDAL_CC_SUSTAIN);
+  stage(1000U, BIT(0), 9000U, 0U, 0U);
+  stage(2000U, BIT(0), 8000U, 0U, 0U);
+
+  /* Past the age budget and already at the receiver: shed */
+  zassert_equal(send_next(10000U, &v), -1);
+  zassert_equal(atomic_get(&s_stage.aged), 1);
+  zassert_false(midi_cc_stage_pending(&s_stage));
+
+  /* A stale value the receiver lacks goes out after the fresh ones */
+  stage(3000U, BIT(2), 0U, 0U, 3000U);
+  stage(9000U, BIT(1), 0U, 100U, 3000U);
+  zassert_equal(send_next(10000U, &v), MIDAL_CC_SOSTENUTO);
+  zassert_equal(send_next(10000U, &v), MIDAL_CC_SOFT);
+  zassert_equal(v, 3000U);
+  zassert_equal(atomic_get(&s_stage.aged), 1);
+}
+
+ZTEST(pedal_bus, test_by_delta_drops_returned_value) {
+  uint16_t v;
+
+  /* 7-bit link: values are rounded as they are staged */
+  midi_cc_stage_order_by_delta(&s_stage, 7U);
+
+  stage(0U, BIT(0), 8191U, 0U, 0U);
+  zassert_equal(send_next(0U, &v), MIDAL_CC_SUSTAIN);
+  zassert_equal(v, 64U);
+
+  /* A move that rounds back to the delivered value is not sent again */
+  stage(1000U, BIT(0), 8250U, 0U, 0U);
+  zassert_equal(send_next(1000U, &v), -1);
+  zassert_equal(atomic_get(&s_stage.coalesced), 1);
+
+  /* The largest change goes first within a priority */
+  stage(2000U, BIT(1) | BIT(2), 0U, 1000U, 16383U);
+  zassert_equal(send_next(2000U, &v), MIDAL_CC_SOSTENUTO);
+  zassert_equal(send_next(2000U, &v), MIDAL_CC_SOFT);
+  stage(3000U, BIT(1) | BIT(2), 0U, 16383U, 12000U);
+  zassert_equal(send_next(3000U, &v), MIDAL_CC_SOSTENUTO);
+  zassert_equal(v, 127U);
+  zassert_equal(send_next(3000U, &v), MIDAL_CC_SOFT);
+}
+
+ZTEST(pedal_bus, test_undelivered_value_resent) {
+  uint16_t v;
+
+  midi_cc_stage_order_by_delta(&s_stage, 7U);
+
+  /* Marked sent when the transfer started, then the transfer aborted */
+  stage(0U, BIT(0), 8191U, 0U, 0U);
+  zassert_equal(send_next(0U, &v), MIDAL_CC_SUSTAIN);
+  midi_cc_stage_undeliver(&s_stage);
+  zassert_true(midi_cc_stage_pending(&s_stage));
+
+  /* The same value again still goes out, once */
+  stage(1000U, BIT(0), 8191U, 0U, 0U);
+  zassert_equal(send_next(1000U, &v), MIDAL_CC_SUSTAIN);
+  zassert_equal(v, 64U);
+  zassert_equal(send_next(1000U, &v), -1);
+
+  /* With nothing newer staged, the aborted value itself is resent */
+  stage(2000U, BIT(0), 16383U, 0U, 0U);
+  zassert_equal(send_next(2000U, &v), MIDAL_CC_SUSTAIN);
+  midi_cc_stage_undeliver(&s_stage);
+  zassert_equal(send_next(3000U, &v), MIDAL_CC_SUSTAIN);
+  zassert_equal(v, 127U);
+  zassert_equal(atomic_get(&s_stage.lost), 0);
+}
+
+ZTEST(pedal_bus, test_lost_updates_counted) {
+  const midi_event_t other = {
+      .type = MIDI_EV_CC, .cc = {.ch = 0U, .cc = 1U, .value = 1U}};
+
+  /* Every slot is taken by a pedal: a fourth controller has no room */
+  stage(0U, BIT(0) | BIT(1) | BIT(2), 1U, 2U, 3U);
+  midi_cc_stage_put(&s_stage, &other);
+  zassert_equal(atomic_get(&s_stage.lost), 1);
+
+  /* A send that failed for good */
+  zassert_not_null(midi_cc_stage_next(&s_stage, 0U));
+  midi_cc_stage_drop(&s_stage);
+  zassert_equal(atomic_get(&s_stage.lost), 2);
+  zassert_true(midi_cc_stage_pending(&s_stage));
+}
+
+static void *bus_setup(void) {
+  zassert_ok(
+      zbus_chan_add_obs(&pedal_frame_chan, &test_frame_sub, K_MSEC(100)));
+  return NULL;
+}
+
+static void bus_before(void *fixture) {
+  ARG_UNUSED(fixture);
+  midi_cc_stage_init(&s_stage, 0U);
+}
+
+ZTEST_SUITE(pedal_bus, NULL, bus_setup, bus_before, NULL, NULL);
@@ -0,0 +1,164 @@
+// tests/pedal_filter/src/main.c
+#include "pedal/pedal_filter.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#define OUT_MAX 16383U
+/* Raw travel: the default calibration floor up to the first (resting) read */
+#define RAW_DOWN 500U
+#define RAW_UP 4000U
+#define RAW_SPAN (RAW_UP - RAW_DOWN)
+/* EMA time constant in samples: 5 ms at 1 kHz */
+#define TAU_SAMPLES 5.0
+
+static void scan(uint16_t raw, uint16_t out[MIDAL_NUM_PEDALS]) {
+  uint16_t in[MIDAL_NUM_PEDALS];
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    in[i] = raw;
+  }
+  pedal_filter_apply_all(in, out);
+}
+
+/* Output n samples into a step, from 'from' to 'to' in 0..1 */
+static uint16_t step_expected(double from, double to, int n) {
+  double y = to + (from - to) * exp(-(double)n / TAU_SAMPLES);
+  return (uint16_t)lround(y * OUT_MAX);
+}
+
+ZTEST(pedal_filter, test_first_scan_starts_settled) {
+  uint16_t out[MIDAL_NUM_PEDALS];
+
+  /* The first reading sets the top of the range: full output at once */
+  scan(RAW_UP, out);
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    zassert_equal(out[i], OUT_MAX);
+  }
+
+  pedal_calibration_t cal;
+  pedal_filter_get_calibration(0U, &cal);
+  zassert_true(cal.initialized);
+  zassert_equal(cal.max_adc, RAW_UP);
+}
+
+ZTEST(pedal_filter, test_step_down_follows_tau) {
+  uint16_t out[MIDAL_NUM_PEDALS];
+  uint16_t prev = OUT_MAX;
+
+  scan(RAW_UP, out);
+  for (int n = 1; n <= 60; n++) {
+    scan(RAW_DOWN, out);
+    zassert_within(out[0], step_expected(1.0, 0.0, n), 1,
+                   "sample %d: %u", n, out[0]);
+    zassert_true(out[0] <= prev, "sample %d rose", n);
+    zassert_equal(out[1], out[0]);
+    zassert_equal(out[2], out[0]);
+    prev = out[0];
+  }
+
+  /* e^-1 after one time constant, nothing left after twelve */
+  zassert_equal(step_expected(1.0, 0.0, 5), 6027U);
+  zassert_equal(out[0], 0U);
+}
+
+ZTEST(pedal_filter, test_step_up_follows_tau) {
+  uint16_t out[MIDAL_NUM_PEDALS];
+  uint16_t prev;
+
+  scan(RAW_UP, out);
+  for (int n = 0; n < 60; n++) {
+    scan(RAW_DOWN, out);
+  }
+  zassert_equal(out[0], 0U);
+
+  prev = 0U;
+  for (int n = 1; n <= 60; n++) {
+    scan(RAW_UP, out);
+    zassert_within(out[0], step_expected(0.0, 1.0, n), 1,
+                   "sample %d: %u", n, out[0]);
+    zassert_true(out[0] >= prev, "sample %d fell", n);
+    prev = out[0];
+  }
+  zassert_equal(out[0], OUT_MAX);
+}
+
+ZTEST(pedal_filter, test_dead_band_holds_small_moves) {
+  pedal_filter_params_t p;
+  uint16_t out[MIDAL_NUM_PEDALS];
+
+  /* No smoothing and a 2-step dead band: 256 LSB at 14 bits */
+  pedal_filter_default_params(&p);
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    p.pedal[i].tau_ms = 0U;
+    p.pedal[i].alpha_millipct = 100000U;
+    p.pedal[i].hyst_cc = 2U;
+  }
+  zassert_ok(pedal_filter_configure(&p));
+
+  scan(RAW_UP, out);
+  scan(2000U, out);
+  const uint16_t mid = out[0];
+  zassert_within(mid, (1500U * OUT_MAX + RAW_SPAN / 2U) / RAW_SPAN, 1);
+
+  /* 40 raw counts = 187 LSB: held, either way */
+  scan(2040U, out);
+  zassert_equal(out[0], mid);
+  scan(1960U, out);
+  zassert_equal(out[0], mid);
+
+  /* 60 raw counts = 281 LSB: passes */
+  scan(2060U, out);
+  zassert_true(out[0] > mid + 256U);
+}
+
+ZTEST(pedal_filter, test_fixed_matches_float) {
+  uint16_t raw[MIDAL_NUM_PEDALS];
+  uint16_t out_f[MIDAL_NUM_PEDALS];
+  uint16_t out_q[MIDAL_NUM_PEDALS];
+  uint32_t rng = 1U;
+  int worst = 0;
+
+  /* Rest, full strokes, a slow ramp and rest noise on every pedal */
+  for (int n = 0; n < 2000; n++) {
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      uint16_t base;
+
+      if (n < 100) {
+        base = RAW_UP;
+      } else if (n < 400) {
+        base = ((n / 50) % 2) ? RAW_DOWN : RAW_UP;
+      } else if (n < 1400) {
+        base = (uint16_t)(RAW_DOWN + ((n - 400) * RAW_SPAN) / 1000);
+      } else {
+        base = 2200U;
+      }
+      rng = rng * 1664525U + 1013904223U;
+      raw[i] = (uint16_t)(base + (i * 7U) + ((rng >> 16) % 7U) - 3U);
+    }
+
+    const bool reset = (n == 0);
+    (void)pedal_filter_bench_kernel(PEDAL_FILTER_KERNEL_FLOAT,
+                                    PEDAL_FILTER_MODE_EMA, reset,
+                                    PEDAL_FILTER_HYST_OFF, raw, out_f);
+    (void)pedal_filter_bench_kernel(PEDAL_FILTER_KERNEL_FIXED,
+                                    PEDAL_FILTER_MODE_EMA, reset,
+                                    PEDAL_FILTER_HYST_OFF, raw, out_q);
+
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      worst = MAX(worst, abs((int)out_f[i] - (int)out_q[i]));
+    }
+  }
+
+  zassert_true(worst <= 1, "kernels differ by %d LSB", worst);
+}
+
+static void filter_before(void *fixture) {
+  ARG_UNUSED(fixture);
+  pedal_filter_init();
+}
+
+ZTEST_SUITE(pedal_filter, NULL, NULL, filter_before, NULL, NULL);
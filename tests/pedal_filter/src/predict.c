@@ -0,0 +1,157 @@
+// tests/pedal_filter/src/predict.c
+#include "pedal/pedal_filter.h"
+
+#include <math.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#define OUT_MAX 16383
+#define RAW_DOWN 500U
+#define RAW_UP 4000U
+#define REST_SAMPLES 100
+#define HOLD_SAMPLES 100
+
+typedef struct {
+  uint16_t ema;
+  uint16_t pred;
+} stroke_out_t;
+
+/*
+ * One raised-cosine stroke of len samples from 'from' to 'to' after a rest,
+ * then a hold, through the EMA and the EMA + predictor of one kernel. out
+ * gets one entry per sample of the stroke and hold.
+ */
+static void run_stroke(pedal_filter_kernel_t kernel, uint16_t from,
+                       uint16_t to, int len, stroke_out_t *out) {
+  uint16_t raw[MIDAL_NUM_PEDALS];
+  uint16_t ema[MIDAL_NUM_PEDALS];
+  uint16_t pred[MIDAL_NUM_PEDALS];
+
+  for (int n = 0; n < REST_SAMPLES + len + HOLD_SAMPLES; n++) {
+    double x = from;
+
+    if (n == 0) {
+      /* The first reading sets the top of the range */
+      x = RAW_UP;
+    } else if (n >= REST_SAMPLES + len) {
+      x = to;
+    } else if (n >= REST_SAMPLES) {
+      double t = (double)(n - REST_SAMPLES) / len;
+      x = from + ((double)to - from) * (1.0 - cos(M_PI * t)) / 2.0;
+    }
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      raw[i] = (uint16_t)lround(x);
+    }
+
+    (void)pedal_filter_bench_kernel(kernel, PEDAL_FILTER_MODE_EMA, n == 0,
+                                    PEDAL_FILTER_HYST_OFF, raw, ema);
+    (void)pedal_filter_bench_kernel(kernel, PEDAL_FILTER_MODE_EMA_PREDICT,
+                                    n == 0, PEDAL_FILTER_HYST_OFF, raw, pred);
+
+    if (n >= REST_SAMPLES) {
+      out[n - REST_SAMPLES] = (stroke_out_t){.ema = ema[0], .pred = pred[0]};
+    }
+  }
+}
+
+/* First sample at which the output has crossed half way to 'to' */
+static int half_crossing(const stroke_out_t *s, int count, bool pred,
+                         int from, int to) {
+  const int half = (from + to) / 2;
+
+  for (int n = 0; n < count; n++) {
+    int v = pred ? s[n].pred : s[n].ema;
+    if ((to < from) ? (v <= half) : (v >= half)) {
+      return n;
+    }
+  }
+  return count;
+}
+
+static int out_of(uint16_t raw) {
+  return (int)lround((double)(raw - RAW_DOWN) * OUT_MAX / (RAW_UP - RAW_DOWN));
+}
+
+static void check_stroke(pedal_filter_kernel_t kernel, uint16_t from,
+                         uint16_t to, int len) {
+  static stroke_out_t s[64 + HOLD_SAMPLES];
+  const int count = len + HOLD_SAMPLES;
+  const int y0 = out_of(from);
+  const int y1 = out_of(to);
+  const int dir = (to < from) ? -1 : 1;
+
+  zassert_true(count <= (int)ARRAY_SIZE(s));
+  run_stroke(kernel, from, to, len, s);
+
+  for (int n = 0; n < count; n++) {
+    /* Never past the stop, never stepping back */
+    zassert_true(dir * (s[n].pred - y1) <= 1, "sample %d: %u past %d", n,
+                 s[n].pred, y1);
+    if (n > 0) {
+      zassert_true(dir * (s[n].pred - s[n - 1].pred) >= 0,
+                   "sample %d stepped back (%u -> %u)", n, s[n - 1].pred,
+                   s[n].pred);
+    }
+    /* Ahead of (or level with) the plain EMA */
+    zassert_true(dir * (s[n].pred - s[n].ema) >= -1, "sample %d behind", n);
+  }
+
+  /* Both settle on the stop */
+  zassert_within(s[count - 1].pred, y1, 1);
+  zassert_within(s[count - 1].ema, y1, 1);
+
+  /* The lead shows as an earlier half-way crossing */
+  const int t_ema = half_crossing(s, count, false, y0, y1);
+  const int t_pred = half_crossing(s, count, true, y0, y1);
+  zassert_true(t_pred < t_ema, "half way at %d, EMA at %d", t_pred, t_ema);
+}
+
+ZTEST(pedal_predict, test_full_press_float) {
+  check_stroke(PEDAL_FILTER_KERNEL_FLOAT, RAW_UP, RAW_DOWN, 20);
+}
+
+ZTEST(pedal_predict, test_full_press_fixed) {
+  check_stroke(PEDAL_FILTER_KERNEL_FIXED, RAW_UP, RAW_DOWN, 20);
+}
+
+ZTEST(pedal_predict, test_stop_mid_travel) {
+  check_stroke(PEDAL_FILTER_KERNEL_FLOAT, RAW_UP, 2250U, 15);
+  check_stroke(PEDAL_FILTER_KERNEL_FIXED, RAW_UP, 2250U, 15);
+}
+
+ZTEST(pedal_predict, test_release) {
+  check_stroke(PEDAL_FILTER_KERNEL_FLOAT, RAW_DOWN, RAW_UP, 30);
+  check_stroke(PEDAL_FILTER_KERNEL_FIXED, RAW_DOWN, RAW_UP, 30);
+}
+
+ZTEST(pedal_predict, test_rest_passes_through) {
+  uint16_t raw[MIDAL_NUM_PEDALS];
+  uint16_t ema[MIDAL_NUM_PEDALS];
+  uint16_t pred[MIDAL_NUM_PEDALS];
+  uint32_t rng = 7U;
+
+  /* Rest noise stays under the speed gate: no lead is added */
+  for (int n = 0; n < 500; n++) {
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      rng = rng * 1664525U + 1013904223U;
+      raw[i] = (n == 0) ? RAW_UP : (uint16_t)(2200U + ((rng >> 16) % 7U) - 3U);
+    }
+    (void)pedal_filter_bench_kernel(PEDAL_FILTER_KERNEL_FLOAT,
+                                    PEDAL_FILTER_MODE_EMA, n == 0,
+                                    PEDAL_FILTER_HYST_OFF, raw, ema);
+    (void)pedal_filter_bench_kernel(PEDAL_FILTER_KERNEL_FLOAT,
+                                    PEDAL_FILTER_MODE_EMA_PREDICT, n == 0,
+                                    PEDAL_FILTER_HYST_OFF, raw, pred);
+    if (n >= REST_SAMPLES) {
+      zassert_equal(pred[0], ema[0], "sample %d", n);
+    }
+  }
+}
+
+static void predict_before(void *fixture) {
+  ARG_UNUSED(fixture);
+  pedal_filter_init();
+}
+
+ZTEST_SUITE(pedal_predict, NULL, NULL, predict_before, NULL, NULL);
@@ -0,0 +1,212 @@
+// tests/pedal_timing/src/main.c
+#include "diag/stats.h"
+#include "pedal/pedal_decim.h"
+#include "pedal/pedal_filter.h"
+#include "pedal/pedal_sampler.h"
+#include "pedal/sample_clock.h"
+
+#include <math.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/ztest.h>
+
+BUILD_ASSERT(PEDAL_DECIM_RATIO == 8 && PEDAL_DECIM_ORDER == 2,
+             "The golden values below assume R = 8, K = 2");
+
+/* CIC gain R^K = 64 scaled to PEDAL_RAW_FRAC_BITS: input x reads x << 4 */
+#define RAW(x) ((uint16_t)((x) << PEDAL_RAW_FRAC_BITS))
+
+static atomic_t s_ticks;
+static bool s_ack = true;
+
+static void on_tick(void) {
+  atomic_inc(&s_ticks);
+  if (s_ack) {
+    sample_clock_mark_done();
+  }
+}
+
+static void push_all(uint16_t v, uint16_t out[MIDAL_NUM_PEDALS], bool *ready) {
+  uint16_t in[MIDAL_NUM_PEDALS];
+
+  for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+    in[i] = v;
+  }
+  *ready = pedal_decim_push(in, out);
+}
+
+ZTEST(pedal_timing, test_scan_fits_oversampled_period) {
+  /* Three channels at the default 10 us acquisition plus 2 us conversion */
+  zassert_equal(PEDAL_SCAN_NS, 36000U);
+  /* 3.6 ticks of 10 us round up to 4 */
+  zassert_equal(PEDAL_SCAN_TICKS, 4U);
+  zassert_equal(PEDAL_SCAN_MAX_HZ, 25000U);
+  /* Eight scans per output: 3125 Hz, below the 4 kHz parameter limit */
+  zassert_equal(PEDAL_FILTER_POLL_HZ_MAX, 3125U);
+  zassert_true(CONFIG_MIDAL_POLL_HZ <= PEDAL_FILTER_POLL_HZ_MAX);
+}
+
+ZTEST(pedal_timing, test_clock_period_whole_ticks) {
+  /* 1 kHz blocks of 8 scans: exactly 100 ticks */
+  zassert_ok(sample_clock_start(8000U, 8U));
+  zassert_equal(sample_clock_period_ns(), 1000000U);
+
+  /* 3 kHz: 33.3 ticks rounds to nearest, not up */
+  zassert_ok(sample_clock_start(3000U, 1U));
+  zassert_equal(sample_clock_period_ns(), 330000U);
+
+  /* 32 kHz: 3.125 ticks */
+  zassert_ok(sample_clock_start(32000U, 1U));
+  zassert_equal(sample_clock_period_ns(), 30000U);
+
+  /* Never below one tick */
+  zassert_ok(sample_clock_start(400000U, 1U));
+  zassert_equal(sample_clock_period_ns(), 10000U);
+
+  zassert_equal(sample_clock_start(0U, 1U), -EINVAL);
+  zassert_equal(sample_clock_start(1000U, 0U), -EINVAL);
+
+  /* Leave the clock at the firmware's default rate */
+  zassert_ok(sample_clock_start(1000U, 1U));
+}
+
+ZTEST(pedal_timing, test_clock_tick_rate) {
+  struct sample_clock_stats st;
+
+  s_ack = true;
+  zassert_ok(sample_clock_start(1000U, 1U));
+  atomic_clear(&s_ticks);
+  k_msleep(200);
+
+  zassert_within(atomic_get(&s_ticks), 200, 1);
+  sample_clock_get_stats(&st);
+  zassert_equal(st.period_ns, 1000000U);
+  zassert_equal(st.overruns, 0U);
+}
+
+ZTEST(pedal_timing, test_clock_counts_overruns) {
+  struct sample_clock_stats before;
+  struct sample_clock_stats after;
+
+  sample_clock_get_stats(&before);
+  s_ack = false;
+  zassert_ok(sample_clock_start(1000U, 1U));
+  k_msleep(20);
+  s_ack = true;
+  sample_clock_mark_done();
+  sample_clock_get_stats(&after);
+
+  /* Every tick after the first found the previous one unprocessed */
+  zassert_within(after.overruns - before.overruns, 19U, 1U);
+}
+
+ZTEST(pedal_timing, test_decim_dc_gain) {
+  uint16_t out[MIDAL_NUM_PEDALS];
+  bool ready = false;
+  int first = -1;
+
+  /* The first K outputs are held back while the comb chain fills */
+  for (int n = 1; n <= 4 * PEDAL_DECIM_RATIO; n++) {
+    push_all(1000U, out, &ready);
+    if (ready && first < 0) {
+      first = n;
+      for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+        zassert_equal(out[i], RAW(1000U));
+      }
+    }
+  }
+  zassert_equal(first, (PEDAL_DECIM_ORDER + 1) * PEDAL_DECIM_RATIO);
+
+  /* Full scale stays inside the raw range */
+  for (int n = 0; n < 3 * PEDAL_DECIM_RATIO; n++) {
+    push_all(4095U, out, &ready);
+  }
+  zassert_true(ready);
+  zassert_equal(out[0], RAW(4095U));
+  zassert_true(out[0] <= PEDAL_RAW_MAX);
+}
+
+ZTEST(pedal_timing, test_decim_step_delay) {
+  uint16_t out[MIDAL_NUM_PEDALS];
+  bool ready = false;
+
+  zassert_equal(pedal_decim_group_delay_us(),
+                PEDAL_DECIM_ORDER * (PEDAL_DECIM_RATIO - 1) *
+                    (1000000U / (CONFIG_MIDAL_POLL_HZ * PEDAL_DECIM_RATIO)) /
+                    2U);
+
+  /* Settle at 0, then step at the start of a decimation frame */
+  for (int n = 0; n < 4 * PEDAL_DECIM_RATIO; n++) {
+    push_all(0U, out, &ready);
+  }
+  zassert_true(ready);
+  zassert_equal(out[0], 0U);
+
+  /*
+   * The K = 2 response is a 15-tap triangle of weight 64. The output 8
+   * scans after the step holds the newest 8 taps (1 + ... + 8 = 36): past
+   * the midpoint after the K*(R-1)/2 = 7 scan group delay. The next output
+   * has settled.
+   */
+  for (int n = 0; n < PEDAL_DECIM_RATIO; n++) {
+    push_all(4095U, out, &ready);
+  }
+  zassert_true(ready);
+  zassert_equal(out[0], (uint16_t)((4095U * 36U + 2U) >> 2));
+  zassert_true(out[0] > RAW(4095U) / 2U);
+
+  for (int n = 0; n < PEDAL_DECIM_RATIO; n++) {
+    push_all(4095U, out, &ready);
+  }
+  zassert_true(ready);
+  zassert_equal(out[0], RAW(4095U));
+}
+
+ZTEST(pedal_timing, test_decim_noise_reduction) {
+  uint32_t rng = 12345U;
+  double in_sum = 0.0, in_sq = 0.0, out_sum = 0.0, out_sq = 0.0;
+  int in_n = 0, out_n = 0;
+  uint16_t out[MIDAL_NUM_PEDALS];
+
+  /* Uniform +-4 LSB around mid scale, like the rest noise of a pedal */
+  for (int n = 0; n < 512 * PEDAL_DECIM_RATIO; n++) {
+    uint16_t in[MIDAL_NUM_PEDALS];
+
+    for (size_t i = 0; i < MIDAL_NUM_PEDALS; i++) {
+      rng = rng * 1664525U + 1013904223U;
+      in[i] = (uint16_t)(2000U + ((rng >> 16) % 9U) - 4U);
+    }
+    in_sum += in[0];
+    in_sq += (double)in[0] * in[0];
+    in_n++;
+
+    if (pedal_decim_push(in, out)) {
+      double v = (double)out[0] / (1U << PEDAL_RAW_FRAC_BITS);
+      out_sum += v;
+      out_sq += v * v;
+      out_n++;
+    }
+  }
+
+  const double in_mean = in_sum / in_n;
+  const double out_mean = out_sum / out_n;
+  const double in_sd = sqrt(in_sq / in_n - in_mean * in_mean);
+  const double out_sd = sqrt(out_sq / out_n - out_mean * out_mean);
+
+  /* No bias, and the triangle's noise gain is sqrt(344) / 64 = 0.29 */
+  zassert_within(out_mean * 100.0, in_mean * 100.0, 10.0);
+  zassert_true(out_sd < 0.4 * in_sd, "sd in %.3f out %.3f", in_sd, out_sd);
+}
+
+static void *timing_setup(void) {
+  zassert_ok(sample_clock_init(on_tick));
+  return NULL;
+}
+
+static void timing_before(void *fixture) {
+  ARG_UNUSED(fixture);
+  pedal_decim_reset();
+}
+
+ZTEST_SUITE(pedal_timing, NULL, timing_setup, timing_before, NULL, NULL);
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Decode a MIDAL flight recorder SysEx dump (CONFIG_MIDAL_FLIGHT_RECORDER).
+
+Reads a .syx capture of "midal rec sysex" (F0 ... F7 messages, as saved by
+most SysEx librarians) and writes the trace as CSV, the same columns as
+"midal rec dump". Layouts mirror src/diag/flight_recorder.c and .h.
+
+    tools/midal_flightrec.py capture.syx -o trace.csv
+"""
+
+import argparse
+import struct
+import sys
+
+VERSION = 1
+SYSEX_ID = b"\x7dMR"
+MSG_HEADER = 1
+MSG_ENTRY = 2
+MSG_END = 3
+
+# flight_rec_trigger_t order (src/diag/flight_recorder.h)
+REASONS = ["none", "shell", "jump", "adc-timeout"]
+
+
+def sysex_messages(data):
+    """Yield the bodies between F0 and F7."""
+    start = None
+    for i, b in enumerate(data):
+        if b == 0xF0:
+            start = i + 1
+        elif b == 0xF7 and start is not None:
+            yield data[start:i]
+            start = None
+
+
+def unpack7(data):
+    """Undo the 8-to-7 packing: an MSB byte, then up to 7 low-bit bytes."""
+    out = bytearray()
+    for off in range(0, len(data), 8):
+        msbs = data[off]
+        for i, b in enumerate(data[off + 1:off + 8]):
+            out.append(b | (((msbs >> i) & 1) << 7))
+    return bytes(out)
+
+
+def u14(lo, hi):
+    return lo | (hi << 7)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("capture", help=".syx file, or - for stdin")
+    ap.add_argument("-o", "--output", help="CSV file (default stdout)")
+    args = ap.parse_args()
+
+    src = sys.stdin.buffer if args.capture == "-" else open(args.capture, "rb")
+    out = open(args.output, "w") if args.output else sys.stdout
+
+    pedals = None
+    count = 0
+    rows = {}
+    done = False
+
+    for msg in sysex_messages(src.read()):
+        if len(msg) < 4 or msg[:3] != SYSEX_ID:
+            continue
+        mtype, body = msg[3], msg[4:]
+
+        if mtype == MSG_HEADER:
+            if body[0] != VERSION:
+                sys.exit("dump version %d, decoder knows %d" % (body[0], VERSION))
+            pedals = body[1]
+            reason = REASONS[body[2]] if body[2] < len(REASONS) else body[2]
+            count = u14(body[3], body[4])
+            trig = u14(body[5], body[6])
+            rows = {}
+            done = False
+            print("# midal flight recorder: %u scans, trigger %s at row %u" %
+                  (count, reason, trig), file=out)
+        elif mtype == MSG_ENTRY and pedals is not None:
+            entry = struct.Struct("<I%dh%dH" % (pedals, pedals))
+            raw = unpack7(body[2:])
+            if len(raw) < entry.size:
+                print("# short entry message", file=sys.stderr)
+                continue
+            rows[u14(body[0], body[1])] = entry.unpack_from(raw)
+        elif mtype == MSG_END and pedals is not None:
+            done = True
+
+    if pedals is None:
+        sys.exit("no flight recorder header in the capture")
+
+    print(",".join(["t_us"] + ["raw%d" % i for i in range(pedals)] +
+                   ["out%d" % i for i in range(pedals)]), file=out)
+    for i in sorted(rows):
+        print(",".join(map(str, rows[i])), file=out)
+
+    missing = count - len(rows)
+    if missing or not done:
+        print("# %d of %d scans missing%s" %
+              (missing, count, "" if done else ", no end message"),
+              file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
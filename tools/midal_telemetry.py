@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Decode the MIDAL binary telemetry stream (CONFIG_MIDAL_TELEMETRY).
+
+Reads the telemetry CDC-ACM port (or a capture file, or stdin) and prints
+one line per record. Layouts mirror src/diag/telemetry.h; keep both in sync.
+
+    tools/midal_telemetry.py /dev/ttyACM1
+    tools/midal_telemetry.py capture.bin --csv pedals.csv
+
+Serial ports need pyserial (pip install pyserial).
+"""
+
+import argparse
+import struct
+import sys
+
+VERSION = 1
+REC_PEDALS = 1
+REC_STATS = 2
+REC_LATENCY = 3
+
+HDR = struct.Struct("<BBHI")  # type, version, seq, t_ms
+STATS = struct.Struct("<II4I4I4IIIiiIIIII")
+PROBE = struct.Struct("<III")  # p50, p99, max (us)
+
+# latency_probe_t order (src/diag/latency.h)
+PROBES = [
+    "filter", "publish",
+    "usb.dequeue", "usb.send", "usb.queued",
+    "ble.dequeue", "ble.send", "ble.done",
+    "din.dequeue", "din.send", "din.done",
+]
+
+
+def crc16_ccitt(data, seed=0xFFFF):
+    """Zephyr's crc16_ccitt(): reflected 0x1021, no final XOR."""
+    crc = seed
+    for b in data:
+        e = (crc ^ b) & 0xFF
+        f = (e ^ (e << 4)) & 0xFF
+        crc = ((crc >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def frames(stream, live=False):
+    """Yield the raw bytes between 0x00 delimiters.
+
+    A file or pipe ends at the first empty read. A live port (live=True)
+    returns empty reads on its timeout while the device stalls or reboots,
+    so it is read until interrupted.
+    """
+    buf = bytearray()
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            if live:
+                continue
+            return
+        buf += chunk
+        while True:
+            end = buf.find(0)
+            if end < 0:
+                break
+            if end > 0:
+                yield bytes(buf[:end])
+            del buf[:end + 1]
+
+
+def decode(frame):
+    """Return (header tuple, payload) or raise ValueError."""
+    data = cobs_decode(frame)
+    if data is None or len(data) < HDR.size + 2:
+        raise ValueError("bad COBS frame")
+    rec, crc = data[:-2], struct.unpack("<H", data[-2:])[0]
+    if crc16_ccitt(rec) != crc:
+        raise ValueError("CRC mismatch")
+    hdr = HDR.unpack_from(rec)
+    if hdr[1] != VERSION:
+        raise ValueError("record version %d, decoder knows %d" % (hdr[1], VERSION))
+    return hdr, rec[HDR.size:]
+
+
+def fmt_pedals(body):
+    count, changed, ts_us = struct.unpack_from("<BBI", body)
+    values = struct.unpack_from("<%dH" % count, body, 6)
+    return "pedals ts=%uus changed=0x%02x values=%s" % (
+        ts_us, changed, "/".join(str(v) for v in values)), values
+
+
+def fmt_stats(body):
+    f = STATS.unpack_from(body)
+    flags, events = f[0], f[1]
+    usb, ble, din = f[2:6], f[6:10], f[10:14]
+    (ticks, overruns, jmin, jmax, fav, fmax, load, misses,
+     dropped) = f[14:]
+    return ("stats usb=%d ble=%d %s events=%u usb_tx=%s ble_tx=%s din_tx=%s"
+            " clk=%u overrun=%u jitter=%d/%dns filt=%u/%ucyc load=%u.%u%%"
+            " miss=%u tlm_drop=%u" % (
+                flags & 1, (flags >> 1) & 1,
+                "idle" if flags & 4 else "active", events,
+                "/".join(map(str, usb)), "/".join(map(str, ble)),
+                "/".join(map(str, din)), ticks, overruns, jmin, jmax, fav,
+                fmax, load // 10, load % 10, misses, dropped))
+
+
+def fmt_latency(body):
+    count = body[0]
+    parts = []
+    for p in range(count):
+        p50, p99, mx = PROBE.unpack_from(body, 4 + p * PROBE.size)
+        if mx == 0:
+            continue
+        name = PROBES[p] if p < len(PROBES) else "probe%d" % p
+        parts.append("%s=%u/%u/%u" % (name, p50, p99, mx))
+    return "latency p50/p99/max us " + " ".join(parts)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("source", nargs="?", default="-",
+                    help="serial port, capture file, or - for stdin")
+    ap.add_argument("--csv", help="also write pedal records to this CSV file")
+    args = ap.parse_args()
+
+    live = False
+    if args.source == "-":
+        stream = sys.stdin.buffer
+    elif args.source.startswith("/dev/") or args.source.upper().startswith("COM"):
+        import serial
+        stream = serial.Serial(args.source, timeout=1)
+        # The device only streams while DTR is set
+        stream.dtr = True
+        live = True
+    else:
+        stream = open(args.source, "rb")
+
+    csv = open(args.csv, "w") if args.csv else None
+    last_seq = None
+    bad = 0
+
+    for frame in frames(stream, live):
+        try:
+            (rtype, _, seq, t_ms), body = decode(frame)
+        except ValueError as e:
+            bad += 1
+            print("# skipped frame: %s (%d so far)" % (e, bad), file=sys.stderr)
+            continue
+
+        if last_seq is not None and seq != (last_seq + 1) & 0xFFFF:
+            print("# %d records lost" % ((seq - last_seq - 1) & 0xFFFF),
+                  file=sys.stderr)
+        last_seq = seq
+
+        if rtype == REC_PEDALS:
+            line, values = fmt_pedals(body)
+            if csv:
+                csv.write("%u,%s\n" % (t_ms, ",".join(map(str, values))))
+        elif rtype == REC_STATS:
+            line = fmt_stats(body)
+        elif rtype == REC_LATENCY:
+            line = fmt_latency(body)
+        else:
+            line = "type %d (%d bytes)" % (rtype, len(body))
+        print("%10u %s" % (t_ms, line))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        # The way to stop reading a live port
+        pass